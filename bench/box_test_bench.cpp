@@ -0,0 +1,100 @@
+/**
+ * @file box_test_bench.cpp
+ * @brief Micro-benchmark of ray/box slab tests
+ *
+ * Compares the original AABB test, which recomputed the reciprocal
+ * direction and swapped the slab distances on every call, against the
+ * ordered slab tests that read the reciprocal and sign bits cached in
+ * core::Ray. Every variant runs over the same rays and boxes and must
+ * report the same number of hits.
+ *
+ * Usage: box_test_bench [boxes] [rays]
+ */
+
+#include "acceleration/aabb.h"
+#include "acceleration/linear_bvh.h"
+#include "core/ray.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace raytracer;
+
+namespace {
+    // The test as it was before rays cached their reciprocal direction
+    bool legacy_box_hit(const acceleration::AABB& box, const core::Ray& ray, float t_min, float t_max) {
+        for (int a = 0; a < 3; a++) {
+            auto invD = 1.0f / ray.direction()[a];
+            auto t0 = (box.min()[a] - ray.origin()[a]) * invD;
+            auto t1 = (box.max()[a] - ray.origin()[a]) * invD;
+            if (invD < 0.0f)
+                std::swap(t0, t1);
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+            if (t_max <= t_min)
+                return false;
+        }
+        return true;
+    }
+
+    template <typename BoxTest>
+    void run(const char* name, size_t box_count, const std::vector<core::Ray>& rays, BoxTest&& test) {
+        auto start_time = std::chrono::steady_clock::now();
+        size_t hits = 0;
+        for (const auto& ray : rays) {
+            for (size_t b = 0; b < box_count; b++) {
+                hits += test(b, ray) ? 1 : 0;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        double tests = static_cast<double>(box_count) * static_cast<double>(rays.size());
+        std::cout << name << ": " << tests / elapsed.count() / 1e6 << " M box tests/s (" << hits << " hits)"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t box_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096;
+    size_t ray_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8192;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+    // Boxes small enough to fit in cache, so the test itself dominates
+    std::vector<acceleration::AABB> boxes(box_count);
+    std::vector<acceleration::LinearBVHNode> nodes(box_count);
+    for (size_t b = 0; b < box_count; b++) {
+        Point3 corner(position(rng), position(rng), position(rng));
+        boxes[b] = acceleration::AABB(corner, corner + Vec3(size(rng), size(rng), size(rng)));
+        nodes[b] = acceleration::LinearBVHNode{};
+        nodes[b].set_bounds(boxes[b]);
+    }
+
+    std::vector<core::Ray> rays;
+    rays.reserve(ray_count);
+    for (size_t r = 0; r < ray_count; r++) {
+        Vec3 direction(position(rng), position(rng), position(rng));
+        rays.emplace_back(Point3(position(rng), position(rng), position(rng)), direction);
+    }
+
+    const float t_min = 0.001f;
+    const float t_max = 100.0f;
+    std::cout << box_count << " boxes x " << ray_count << " rays" << std::endl;
+
+    run("AABB, reciprocal per test (before)", box_count, rays, [&](size_t b, const core::Ray& ray) {
+        return legacy_box_hit(boxes[b], ray, t_min, t_max);
+    });
+    run("AABB, cached ordered slab (after)", box_count, rays, [&](size_t b, const core::Ray& ray) {
+        return boxes[b].hit(ray, t_min, t_max);
+    });
+    run("BVH node, cached ordered slab", box_count, rays, [&](size_t b, const core::Ray& ray) {
+        return acceleration::hit_node_bounds(nodes[b], ray, t_min, t_max);
+    });
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file bvh_layout_bench.cpp
+ * @brief Memory-vs-speed comparison of the BVH node layouts
+ *
+ * Builds every layout over the bundled scenes (or the scene files given
+ * on the command line) and over a synthetic triangle soup large enough
+ * for node memory to matter, then traces the same random camera rays
+ * through each. Reports the memory of the traversed node array, the
+ * total acceleration memory, the ray rate and the nodes visited per ray.
+ *
+ * Usage: bvh_layout_bench [--triangles N] [--rays N] [scene.json ...]
+ */
+
+#include "acceleration/bvh_accel.h"
+#include "acceleration/bvh_stats.h"
+#include "core/camera.h"
+#include "core/scene.h"
+#include "core/scene_loader.h"
+#include "geometry/triangle.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace raytracer;
+
+namespace {
+    struct LayoutInfo {
+        acceleration::BVHLayout layout;
+        const char* name;
+    };
+
+    const LayoutInfo kLayouts[] = {
+        {acceleration::BVHLayout::Binary, "binary"},
+        {acceleration::BVHLayout::Wide4, "wide4"},
+        {acceleration::BVHLayout::Quantized4, "quantized4"},
+        {acceleration::BVHLayout::Wide8, "wide8"},
+        {acceleration::BVHLayout::Quantized8, "quantized8"},
+    };
+
+    std::vector<core::Ray> camera_rays(const core::Camera& camera, size_t count) {
+        std::mt19937 generator(12345);
+        std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<core::Ray> rays;
+        rays.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            float u = distribution(generator);
+            float v = distribution(generator);
+            rays.push_back(camera.get_ray(u, v));
+        }
+        return rays;
+    }
+
+    void run(const std::string& name, const acceleration::BVHAccel::PrimitiveList& primitives,
+             const acceleration::BVHBuildSettings& base_settings, const std::vector<core::Ray>& rays) {
+        std::cout << "\n" << name << " (" << primitives.size() << " primitives, " << rays.size() << " rays)"
+                  << std::endl;
+        std::cout << std::left << std::setw(12) << "layout" << std::right << std::setw(14) << "nodes KiB"
+                  << std::setw(14) << "total KiB" << std::setw(12) << "Mrays/s" << std::setw(14) << "nodes/ray"
+                  << std::setw(10) << "hits" << std::endl;
+
+        for (const auto& info : kLayouts) {
+            acceleration::BVHBuildSettings settings = base_settings;
+            settings.layout = info.layout;
+            settings.cache_directory.clear();
+            acceleration::BVHAccel bvh(primitives, settings);
+
+            // The first sweep warms the caches; the second is timed
+            size_t hits = 0;
+            for (const auto& ray : rays) {
+                geometry::HitRecord rec;
+                hits += bvh.hit(ray, 0.001f, std::numeric_limits<float>::infinity(), rec) ? 1 : 0;
+            }
+            auto start_time = std::chrono::steady_clock::now();
+            for (const auto& ray : rays) {
+                geometry::HitRecord rec;
+                bvh.hit(ray, 0.001f, std::numeric_limits<float>::infinity(), rec);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+            acceleration::BVHStats stats = acceleration::compute_bvh_stats(bvh);
+            acceleration::TraversalStats traversal = acceleration::sample_traversal(bvh, rays);
+            size_t traversed_bytes = info.layout == acceleration::BVHLayout::Binary ? stats.node_bytes
+                                                                                    : stats.wide_node_bytes;
+            size_t total_bytes = stats.node_bytes + stats.wide_node_bytes + stats.index_bytes;
+
+            std::cout << std::left << std::setw(12) << info.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(14) << traversed_bytes / 1024.0 << std::setw(14)
+                      << total_bytes / 1024.0 << std::setprecision(2) << std::setw(12)
+                      << rays.size() / elapsed.count() / 1e6 << std::setprecision(1) << std::setw(14)
+                      << traversal.mean_nodes_visited << std::setw(10) << hits << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t triangle_count = 500000;
+    size_t ray_count = 200000;
+    std::vector<std::string> scene_files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--triangles" && i + 1 < argc) {
+            triangle_count = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--rays" && i + 1 < argc) {
+            ray_count = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            scene_files.push_back(arg);
+        }
+    }
+    if (scene_files.empty()) {
+        scene_files = {"scenes/cornell_box.json", "scenes/textured_spheres.json", "scenes/glass_showcase.json",
+                       "scenes/material_test.json", "scenes/normal_map_demo.json"};
+    }
+
+    for (const auto& filename : scene_files) {
+        core::Scene scene = core::SceneLoader::load_scene(filename);
+        std::ifstream file(filename);
+        nlohmann::json scene_json = nlohmann::json::parse(file);
+        core::Camera camera = core::SceneLoader::load_camera(scene_json["camera"]);
+
+        // The scene's BVH holds exactly its bounded objects
+        const acceleration::BVHAccel* accel = scene.acceleration();
+        if (!accel) {
+            continue;
+        }
+        acceleration::BVHAccel::PrimitiveList primitives = accel->primitives();
+        run(filename, primitives, scene.bvh_settings(), camera_rays(camera, ray_count));
+    }
+
+    if (triangle_count > 0) {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+        acceleration::BVHAccel::PrimitiveList primitives;
+        primitives.reserve(triangle_count);
+        for (size_t i = 0; i < triangle_count; i++) {
+            Point3 center(position(generator), position(generator), position(generator));
+            primitives.push_back(std::make_shared<geometry::Triangle>(
+                center, center + Vec3(offset(generator), offset(generator), offset(generator)),
+                center + Vec3(offset(generator), offset(generator), offset(generator)), 0));
+        }
+        core::Camera camera(Point3(0, 0, 30), Point3(0, 0, 0), Vec3(0, 1, 0), 40, 1.333f);
+        run("synthetic triangle soup", primitives, acceleration::BVHBuildSettings(), camera_rays(camera, ray_count));
+    }
+
+    return 0;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file triangle_test_bench.cpp
+ * @brief Micro-benchmark and leak check of the ray/triangle tests
+ *
+ * First runs the bare tests over a cache-resident triangle array: the
+ * original Möller-Trumbore that rebuilt both edges from the vertices on
+ * every call, the same test on precomputed edge records, the watertight
+ * test, and SoA groups of four and eight triangles tested at once (SSE,
+ * and AVX when compiled with it). Then traces a closed icosphere mesh with each
+ * TriangleTest mode, once with random rays and once with rays from the
+ * centre aimed exactly at shared vertices and edge midpoints. Every one
+ * of those rays must hit; the misses are rays leaking through the mesh.
+ *
+ * Usage: triangle_test_bench [triangles] [rays] [subdivisions]
+ */
+
+#include "geometry/mesh.h"
+#include "geometry/triangle_group.h"
+#include "geometry/triangle_intersection.h"
+#include "core/ray.h"
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace raytracer;
+
+namespace {
+    // The test as it was before triangles stored their edges
+    bool legacy_triangle_hit(const Point3& v0, const Point3& v1, const Point3& v2, const core::Ray& ray, float t_min,
+                             float t_max, float& t, float& u, float& v) {
+        Vec3 edge1 = v1 - v0;
+        Vec3 edge2 = v2 - v0;
+        Vec3 h = glm::cross(ray.direction(), edge2);
+        float a = glm::dot(edge1, h);
+        if (a > -1e-8f && a < 1e-8f) {
+            return false;
+        }
+        float f = 1.0f / a;
+        Vec3 s = ray.origin() - v0;
+        u = f * glm::dot(s, h);
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+        Vec3 q = glm::cross(s, edge1);
+        v = f * glm::dot(ray.direction(), q);
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+        t = f * glm::dot(edge2, q);
+        return t >= t_min && t <= t_max;
+    }
+
+    // test(i, ray) returns the number of triangles of item i that are hit
+    template <typename TriangleHit>
+    void run_kernel(const char* name, size_t item_count, size_t triangles_per_item,
+                    const std::vector<core::Ray>& rays, TriangleHit&& test) {
+        auto start_time = std::chrono::steady_clock::now();
+        size_t hits = 0;
+        for (const auto& ray : rays) {
+            for (size_t i = 0; i < item_count; i++) {
+                hits += test(i, ray);
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        double tests = static_cast<double>(item_count * triangles_per_item) * static_cast<double>(rays.size());
+        std::cout << name << ": " << tests / elapsed.count() / 1e6 << " M triangle tests/s (" << hits << " hits)"
+                  << std::endl;
+    }
+
+    // Icosahedron with every face split into four, vertices pushed onto the unit sphere
+    void icosphere(int subdivisions, std::vector<Point3>& vertices, std::vector<std::array<int, 3>>& faces) {
+        const float g = 1.61803399f;
+        vertices = {{-1, g, 0}, {1, g, 0}, {-1, -g, 0}, {1, -g, 0}, {0, -1, g}, {0, 1, g},
+                    {0, -1, -g}, {0, 1, -g}, {g, 0, -1}, {g, 0, 1}, {-g, 0, -1}, {-g, 0, 1}};
+        faces = {{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11}, {1, 5, 9}, {5, 11, 4},
+                 {11, 10, 2}, {10, 7, 6}, {7, 1, 8}, {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8},
+                 {3, 8, 9}, {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+        for (auto& vertex : vertices) {
+            vertex = glm::normalize(vertex);
+        }
+
+        for (int level = 0; level < subdivisions; level++) {
+            std::map<std::pair<int, int>, int> midpoints;
+            auto midpoint = [&](int a, int b) {
+                auto key = std::make_pair(std::min(a, b), std::max(a, b));
+                auto found = midpoints.find(key);
+                if (found != midpoints.end()) {
+                    return found->second;
+                }
+                vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+                int index = static_cast<int>(vertices.size()) - 1;
+                midpoints.emplace(key, index);
+                return index;
+            };
+
+            std::vector<std::array<int, 3>> split;
+            split.reserve(faces.size() * 4);
+            for (const auto& face : faces) {
+                int ab = midpoint(face[0], face[1]);
+                int bc = midpoint(face[1], face[2]);
+                int ca = midpoint(face[2], face[0]);
+                split.push_back({face[0], ab, ca});
+                split.push_back({face[1], bc, ab});
+                split.push_back({face[2], ca, bc});
+                split.push_back({ab, bc, ca});
+            }
+            faces = std::move(split);
+        }
+    }
+
+    void run_mesh(const char* name, const geometry::Mesh& mesh, const std::vector<core::Ray>& random_rays,
+                  const std::vector<core::Ray>& edge_rays) {
+        const float t_max = 100.0f;
+        auto start_time = std::chrono::steady_clock::now();
+        size_t hits = 0;
+        geometry::HitRecord rec;
+        for (const auto& ray : random_rays) {
+            hits += mesh.hit(ray, 0.001f, t_max, rec) ? 1 : 0;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+        size_t leaks = 0;
+        size_t occlusion_leaks = 0;
+        for (const auto& ray : edge_rays) {
+            leaks += mesh.hit(ray, 0.0f, t_max, rec) ? 0 : 1;
+            occlusion_leaks += mesh.occluded(ray, 0.0f, t_max) ? 0 : 1;
+        }
+        std::cout << name << ": " << random_rays.size() / elapsed.count() / 1e6 << " M rays/s (" << hits
+                  << " hits), " << leaks << " closest-hit and " << occlusion_leaks << " occlusion leaks of "
+                  << edge_rays.size() << " edge rays, " << mesh.memory_bytes() / (1024.0 * 1024.0) << " MB"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t triangle_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1024;
+    size_t ray_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8192;
+    int subdivisions = argc > 3 ? std::atoi(argv[3]) : 7;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+
+    // Bare tests over triangles small enough to stay in cache
+    std::vector<Point3> corners(triangle_count * 3);
+    std::vector<geometry::TriangleRecord> records(triangle_count);
+    for (size_t i = 0; i < triangle_count; i++) {
+        Point3 centre(position(rng), position(rng), position(rng));
+        for (int k = 0; k < 3; k++) {
+            corners[3 * i + k] = centre + Vec3(offset(rng), offset(rng), offset(rng));
+        }
+        records[i] = geometry::TriangleRecord(corners[3 * i], corners[3 * i + 1], corners[3 * i + 2]);
+    }
+
+    std::vector<core::Ray> rays;
+    rays.reserve(ray_count);
+    for (size_t r = 0; r < ray_count; r++) {
+        Vec3 direction(position(rng), position(rng), position(rng));
+        rays.emplace_back(Point3(position(rng), position(rng), position(rng)), direction);
+    }
+
+    const float t_min = 0.001f;
+    const float t_max = 100.0f;
+    std::cout << triangle_count << " triangles x " << ray_count << " rays" << std::endl;
+
+    run_kernel("Moller-Trumbore, edges per test (before)", triangle_count, 1, rays, [&](size_t i, const core::Ray& ray) -> size_t {
+        float t, u, v;
+        return legacy_triangle_hit(corners[3 * i], corners[3 * i + 1], corners[3 * i + 2], ray, t_min, t_max, t, u, v);
+    });
+    run_kernel("Moller-Trumbore, precomputed edges", triangle_count, 1, rays, [&](size_t i, const core::Ray& ray) -> size_t {
+        float t, u, v;
+        return geometry::intersect_triangle(records[i], ray, t_min, t_max, t, u, v);
+    });
+    // Per-ray setup belongs outside the triangle loop, as in Mesh traversal
+    const core::Ray* setup_ray = nullptr;
+    geometry::WatertightRay watertight_ray(rays.front());
+    run_kernel("Watertight", triangle_count, 1, rays, [&](size_t i, const core::Ray& ray) -> size_t {
+        if (setup_ray != &ray) {
+            watertight_ray = geometry::WatertightRay(ray);
+            setup_ray = &ray;
+        }
+        float t, u, v;
+        return geometry::intersect_triangle_watertight(watertight_ray, corners[3 * i], corners[3 * i + 1],
+                                                       corners[3 * i + 2], t_min, t_max, t, u, v);
+    });
+
+    std::vector<geometry::TriangleGroup<4>> groups4((triangle_count + 3) / 4);
+    std::vector<geometry::TriangleGroup<8>> groups8((triangle_count + 7) / 8);
+    for (size_t i = 0; i < triangle_count; i++) {
+        groups4[i / 4].set(static_cast<int>(i % 4), records[i]);
+        groups8[i / 8].set(static_cast<int>(i % 8), records[i]);
+    }
+    // Lane masks rather than the nearest lane, so the hit count matches the scalar tests
+    alignas(32) float lane_t[8], lane_u[8], lane_v[8];
+    run_kernel("Groups of 4", groups4.size(), 4, rays, [&](size_t g, const core::Ray& ray) -> size_t {
+        return std::bitset<8>(
+            geometry::detail::intersect_lanes(groups4[g], ray, t_min, t_max, lane_t, lane_u, lane_v)).count();
+    });
+#ifdef RAYTRACER_TRIANGLE_GROUP_AVX
+    const char* group8_name = "Groups of 8 (AVX)";
+#else
+    const char* group8_name = "Groups of 8 (portable, build with AVX for the vector kernel)";
+#endif
+    run_kernel(group8_name, groups8.size(), 8, rays, [&](size_t g, const core::Ray& ray) -> size_t {
+        return std::bitset<8>(
+            geometry::detail::intersect_lanes(groups8[g], ray, t_min, t_max, lane_t, lane_u, lane_v)).count();
+    });
+
+    // Closed mesh: rays from the centre through shared vertices and edges
+    std::vector<Point3> vertices;
+    std::vector<std::array<int, 3>> faces;
+    icosphere(subdivisions, vertices, faces);
+
+    std::vector<core::Ray> edge_rays;
+    const Point3 centre(0.0f);
+    for (const auto& vertex : vertices) {
+        edge_rays.emplace_back(centre, vertex);
+    }
+    for (const auto& face : faces) {
+        for (int k = 0; k < 3; k++) {
+            edge_rays.emplace_back(centre, 0.5f * (vertices[face[k]] + vertices[face[(k + 1) % 3]]));
+        }
+    }
+
+    std::vector<core::Ray> mesh_rays;
+    mesh_rays.reserve(ray_count * 16);
+    std::uniform_real_distribution<float> target(-1.0f, 1.0f);
+    for (size_t r = 0; r < ray_count * 16; r++) {
+        Point3 origin(position(rng), position(rng), position(rng));
+        origin = 3.0f * glm::normalize(origin);
+        mesh_rays.emplace_back(origin, Point3(target(rng), target(rng), target(rng)) - origin);
+    }
+
+    geometry::Mesh mesh(vertices, faces, 0);
+    std::cout << "Icosphere: " << mesh.face_count() << " faces, " << mesh_rays.size() << " random rays" << std::endl;
+    run_mesh("Mesh, indexed Moller-Trumbore", mesh, mesh_rays, edge_rays);
+    mesh.set_triangle_test(geometry::TriangleTest::Precomputed);
+    run_mesh("Mesh, precomputed records", mesh, mesh_rays, edge_rays);
+    mesh.set_triangle_test(geometry::TriangleTest::Watertight);
+    run_mesh("Mesh, watertight", mesh, mesh_rays, edge_rays);
+    mesh.set_triangle_test(geometry::TriangleTest::Grouped);
+    run_mesh("Mesh, groups of 4", mesh, mesh_rays, edge_rays);
+
+    return 0;
+}
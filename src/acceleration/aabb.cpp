@@ -1,23 +1,40 @@
 #include "aabb.h"
 #include "../common.h"
-#include <algorithm>
 
 namespace raytracer {
 namespace acceleration {
 
-bool AABB::hit(const core::Ray& ray, float t_min, float t_max) const {
+void AABB::expand(const AABB& box) {
+    bounds_[0] = glm::min(bounds_[0], box.bounds_[0]);
+    bounds_[1] = glm::max(bounds_[1], box.bounds_[1]);
+}
+
+void AABB::expand(const Point3& point) {
+    bounds_[0] = glm::min(bounds_[0], point);
+    bounds_[1] = glm::max(bounds_[1], point);
+}
+
+void AABB::pad_to_minimum(float delta) {
     for (int a = 0; a < 3; a++) {
-        auto invD = 1.0f / ray.direction()[a];
-        auto t0 = (min()[a] - ray.origin()[a]) * invD;
-        auto t1 = (max()[a] - ray.origin()[a]) * invD;
-        if (invD < 0.0f)
-            std::swap(t0, t1);
-        t_min = t0 > t_min ? t0 : t_min;
-        t_max = t1 < t_max ? t1 : t_max;
-        if (t_max <= t_min)
-            return false;
+        if (bounds_[1][a] - bounds_[0][a] < delta) {
+            bounds_[0][a] -= 0.5f * delta;
+            bounds_[1][a] += 0.5f * delta;
+        }
     }
-    return true;
+}
+
+float AABB::surface_area() const {
+    if (is_empty())
+        return 0.0f;
+    Vec3 d = extent();
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+int AABB::longest_axis() const {
+    Vec3 d = extent();
+    if (d.x > d.y && d.x > d.z)
+        return 0;
+    return d.y > d.z ? 1 : 2;
 }
 
 AABB surrounding_box(const AABB& box0, const AABB& box1) {
@@ -2,23 +2,91 @@
 
 #include "../common.h"
 #include "../core/ray.h"
+#include <algorithm>
+#include <limits>
 
 namespace raytracer {
 namespace acceleration {
 
+/**
+ * @brief Factor on far-plane slab distances that keeps boundary hits
+ *
+ * A distance takes three roundings (reciprocal, subtraction, product), so
+ * its error is within gamma(3); widening the exit by 1 + 2 * gamma(3)
+ * keeps hits that lie exactly on a box face, e.g. at mesh vertices on a
+ * split plane (Ize 2013).
+ */
+constexpr float kFarPlaneScale =
+    1.0f + 2.0f * (3.0f * (std::numeric_limits<float>::epsilon() * 0.5f) /
+                   (1.0f - 3.0f * (std::numeric_limits<float>::epsilon() * 0.5f)));
+
 class AABB {
 public:
     AABB() = default;
-    AABB(const Point3& a, const Point3& b) : minimum_(a), maximum_(b) {}
+    AABB(const Point3& a, const Point3& b) : bounds_{a, b} {}
+
+    const Point3& min() const { return bounds_[0]; }
+    const Point3& max() const { return bounds_[1]; }
+
+    /**
+     * @brief Ordered slab test using the ray's cached reciprocal and signs
+     *
+     * The near and far planes are picked by the direction sign, so no
+     * per-axis swap or early exit is needed.
+     */
+    bool hit(const core::Ray& ray, float t_min, float t_max) const {
+        for (int a = 0; a < 3; a++) {
+            const int sign = ray.sign(a);
+            float near_plane = bounds_[sign][a];
+            float far_plane = bounds_[1 - sign][a];
+            t_min = std::max(t_min, (near_plane - ray.origin()[a]) * ray.inv_direction()[a]);
+            t_max = std::min(t_max, (far_plane - ray.origin()[a]) * ray.inv_direction()[a] * kFarPlaneScale);
+        }
+        return t_min < t_max;
+    }
+
+    /**
+     * @brief Grows the box to enclose another box or point
+     */
+    void expand(const AABB& box);
+    void expand(const Point3& point);
+
+    /**
+     * @brief Widens any axis thinner than delta so flat boxes stay hittable
+     *
+     * @param delta Minimum extent per axis
+     */
+    void pad_to_minimum(float delta = 1e-4f);
+
+    /**
+     * @brief Overlap of two boxes; empty if they are disjoint
+     */
+    AABB intersection(const AABB& box) const {
+        return AABB(glm::max(bounds_[0], box.bounds_[0]), glm::min(bounds_[1], box.bounds_[1]));
+    }
+
+    bool is_empty() const {
+        return bounds_[0].x > bounds_[1].x || bounds_[0].y > bounds_[1].y || bounds_[0].z > bounds_[1].z;
+    }
+
+    Point3 centroid() const { return 0.5f * (bounds_[0] + bounds_[1]); }
+    Vec3 extent() const { return bounds_[1] - bounds_[0]; }
 
-    Point3 min() const { return minimum_; }
-    Point3 max() const { return maximum_; }
+    /**
+     * @brief Surface area used by the SAH cost model (0 for an empty box)
+     */
+    float surface_area() const;
 
-    bool hit(const core::Ray& ray, float t_min, float t_max) const;
+    /**
+     * @brief Index of the axis with the largest extent (0 = x, 1 = y, 2 = z)
+     */
+    int longest_axis() const;
 
 private:
-    Point3 minimum_;
-    Point3 maximum_;
+    // Minimum and maximum corner, indexable by a ray's direction sign.
+    // Default-constructed boxes are empty so that expand() works from scratch.
+    Point3 bounds_[2] = {Point3(std::numeric_limits<float>::infinity()),
+                         Point3(-std::numeric_limits<float>::infinity())};
 };
 
 AABB surrounding_box(const AABB& box0, const AABB& box1);
@@ -1,67 +1,232 @@
 #include "bvh.h"
 #include "../common.h"
-#include "../core/utils.h"
 #include <algorithm>
+#include <stdexcept>
 
 namespace raytracer {
 namespace acceleration {
 
-BVHNode::BVHNode(const std::vector<std::shared_ptr<geometry::Primitive>>& src_objects, 
-                 size_t start, size_t end) {
-    auto objects = src_objects; // Create a modifiable array of the source scene objects
+namespace {
+    // Number of centroid bins evaluated per axis when searching for a split
+    constexpr int kSAHBinCount = 12;
 
-    int axis = core::random_int(0, 2);
-    auto comparator = (axis == 0) ? box_x_compare
-                    : (axis == 1) ? box_y_compare
-                                  : box_z_compare;
+    struct SAHBin {
+        AABB bounds;
+        size_t count = 0;
+    };
 
-    size_t object_span = end - start;
+    int bin_index(const Point3& centroid, const AABB& centroid_bounds, int axis) {
+        float extent = centroid_bounds.max()[axis] - centroid_bounds.min()[axis];
+        int b = static_cast<int>(kSAHBinCount * ((centroid[axis] - centroid_bounds.min()[axis]) / extent));
+        return std::clamp(b, 0, kSAHBinCount - 1);
+    }
+}
 
+BVHNode::BVHNode(const PrimitiveList& src_objects) {
+    std::vector<BVHPrimitiveInfo> infos(src_objects.size());
+    for (size_t i = 0; i < src_objects.size(); ++i) {
+        AABB box;
+        if (!src_objects[i]->bounding_box(box)) {
+            throw std::runtime_error("BVHNode: cannot build over an unbounded primitive");
+        }
+        infos[i] = {i, box, box.centroid()};
+    }
+
+    // Leaves index the primitive list in build order, which is only known
+    // once the recursion is done, so the shared list is filled afterwards
+    auto ordered = std::make_shared<PrimitiveList>();
+    primitives_ = ordered;
+    if (!infos.empty()) {
+        build(infos, 0, infos.size(), 0);
+    }
+
+    ordered->reserve(infos.size());
+    for (const auto& info : infos) {
+        ordered->push_back(src_objects[info.index]);
+    }
+}
+
+BVHNode::BVHNode(std::vector<BVHPrimitiveInfo>& infos, size_t start, size_t end,
+                 std::shared_ptr<const PrimitiveList> primitives, size_t max_leaf_size, size_t leaf_group_width)
+    : max_leaf_size_(std::max<size_t>(max_leaf_size, 1)), leaf_group_width_(std::max<size_t>(leaf_group_width, 1)),
+      primitives_(std::move(primitives)) {
+    if (start < end) {
+        build(infos, start, end, 0);
+    }
+}
+
+void BVHNode::build(std::vector<BVHPrimitiveInfo>& infos, size_t start, size_t end, int depth) {
+    AABB centroid_bounds;
+    for (size_t i = start; i < end; ++i) {
+        box_.expand(infos[i].bounds);
+        centroid_bounds.expand(infos[i].centroid);
+    }
+
+    size_t object_span = end - start;
+    first_ = start;
+    count_ = object_span;
     if (object_span == 1) {
-        left_ = right_ = objects[start];
-    } else if (object_span == 2) {
-        if (comparator(objects[start], objects[start+1])) {
-            left_ = objects[start];
-            right_ = objects[start+1];
-        } else {
-            left_ = objects[start+1];
-            right_ = objects[start];
+        return;
+    }
+
+    if (depth >= kMedianSplitDepth) {
+        if (object_span <= max_leaf_size_) {
+            return;
         }
-    } else {
-        std::sort(objects.begin() + start, objects.begin() + end, comparator);
+        axis_ = centroid_bounds.longest_axis();
+        size_t mid = start + object_span / 2;
+        std::nth_element(infos.begin() + start, infos.begin() + mid, infos.begin() + end,
+            [&](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                return a.centroid[axis_] < b.centroid[axis_];
+            });
+        split(infos, start, mid, end, depth);
+        return;
+    }
 
-        auto mid = start + object_span/2;
-        left_ = std::make_shared<BVHNode>(objects, start, mid);
-        right_ = std::make_shared<BVHNode>(objects, mid, end);
+    // Evaluate the binned SAH on every axis and keep the cheapest split
+    float best_cost = std::numeric_limits<float>::infinity();
+    int best_axis = -1;
+    int best_bin = 0;
+    float parent_area = box_.surface_area();
+    if (parent_area <= 0.0f) {
+        parent_area = 1.0f;
     }
 
-    // TODO: Implement bounding box calculation
-    // box_ = surrounding_box(left_->bounding_box(), right_->bounding_box());
+    for (int axis = 0; axis < 3; ++axis) {
+        if (centroid_bounds.max()[axis] <= centroid_bounds.min()[axis]) {
+            continue;
+        }
+
+        SAHBin bins[kSAHBinCount];
+        for (size_t i = start; i < end; ++i) {
+            int b = bin_index(infos[i].centroid, centroid_bounds, axis);
+            bins[b].count++;
+            bins[b].bounds.expand(infos[i].bounds);
+        }
+
+        // Sweep from the right to get the area/count of every right-hand side
+        float right_area[kSAHBinCount];
+        size_t right_count[kSAHBinCount];
+        AABB accumulated;
+        size_t count = 0;
+        for (int b = kSAHBinCount - 1; b > 0; --b) {
+            accumulated.expand(bins[b].bounds);
+            count += bins[b].count;
+            right_area[b] = accumulated.surface_area();
+            right_count[b] = count;
+        }
+
+        // Sweep from the left, splitting after bin b
+        accumulated = AABB();
+        count = 0;
+        for (int b = 0; b < kSAHBinCount - 1; ++b) {
+            accumulated.expand(bins[b].bounds);
+            count += bins[b].count;
+            if (count == 0 || right_count[b + 1] == 0) {
+                continue;
+            }
+            float cost = kTraversalCost + (group_cost(count) * accumulated.surface_area() +
+                                           group_cost(right_count[b + 1]) * right_area[b + 1]) / parent_area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    // Keep small ranges as leaves when splitting would not pay off
+    float leaf_cost = group_cost(object_span);
+    if (object_span <= max_leaf_size_ && (best_axis < 0 || leaf_cost <= best_cost)) {
+        return;
+    }
+
+    size_t mid;
+    if (best_axis >= 0) {
+        axis_ = best_axis;
+        auto partition_point = std::partition(infos.begin() + start, infos.begin() + end,
+            [&](const BVHPrimitiveInfo& info) {
+                return bin_index(info.centroid, centroid_bounds, best_axis) <= best_bin;
+            });
+        mid = static_cast<size_t>(partition_point - infos.begin());
+    } else {
+        // All centroids coincide, so no plane separates them; split by count
+        axis_ = box_.longest_axis();
+        mid = start + object_span / 2;
+    }
+
+    split(infos, start, mid, end, depth);
+}
+
+void BVHNode::split(std::vector<BVHPrimitiveInfo>& infos, size_t start, size_t mid, size_t end, int depth) {
+    left_ = std::make_shared<BVHNode>();
+    right_ = std::make_shared<BVHNode>();
+    left_->primitives_ = primitives_;
+    right_->primitives_ = primitives_;
+    left_->max_leaf_size_ = max_leaf_size_;
+    right_->max_leaf_size_ = max_leaf_size_;
+    left_->leaf_group_width_ = leaf_group_width_;
+    right_->leaf_group_width_ = leaf_group_width_;
+    left_->build(infos, start, mid, depth + 1);
+    right_->build(infos, mid, end, depth + 1);
+    count_ = 0;
 }
 
 bool BVHNode::hit(const core::Ray& ray, float t_min, float t_max, geometry::HitRecord& rec) const {
-    // TODO: Implement BVH traversal
-    return false;
+    if (!box_.hit(ray, t_min, t_max)) {
+        return false;
+    }
+
+    if (is_leaf()) {
+        if (!primitives_) {
+            return false;
+        }
+
+        bool hit_anything = false;
+        auto closest_so_far = t_max;
+        for (size_t i = first_; i < first_ + count_; ++i) {
+            if ((*primitives_)[i]->hit(ray, t_min, closest_so_far, rec)) {
+                hit_anything = true;
+                closest_so_far = rec.t;
+            }
+        }
+        return hit_anything;
+    }
+
+    bool hit_left = left_->hit(ray, t_min, t_max, rec);
+    bool hit_right = right_->hit(ray, t_min, hit_left ? rec.t : t_max, rec);
+    return hit_left || hit_right;
+}
+
+bool BVHNode::bounding_box(AABB& output_box) const {
+    output_box = box_;
+    return !box_.is_empty();
 }
 
 // Helper functions for sorting
-bool box_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_compare(const std::shared_ptr<geometry::Primitive> a,
                  const std::shared_ptr<geometry::Primitive> b, int axis) {
-    // TODO: Implement box comparison
-    return false;
+    AABB box_a;
+    AABB box_b;
+
+    if (!a->bounding_box(box_a) || !b->bounding_box(box_b)) {
+        throw std::runtime_error("box_compare: primitive has no bounding box");
+    }
+
+    return box_a.min()[axis] < box_b.min()[axis];
 }
 
-bool box_x_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_x_compare(const std::shared_ptr<geometry::Primitive> a,
                    const std::shared_ptr<geometry::Primitive> b) {
     return box_compare(a, b, 0);
 }
 
-bool box_y_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_y_compare(const std::shared_ptr<geometry::Primitive> a,
                    const std::shared_ptr<geometry::Primitive> b) {
     return box_compare(a, b, 1);
 }
 
-bool box_z_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_z_compare(const std::shared_ptr<geometry::Primitive> a,
                    const std::shared_ptr<geometry::Primitive> b) {
     return box_compare(a, b, 2);
 }
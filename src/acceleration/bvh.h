@@ -8,28 +8,113 @@
 namespace raytracer {
 namespace acceleration {
 
+/**
+ * @brief Per-primitive data the builder works on instead of the primitives themselves
+ *
+ * The builder partitions one array of these in place, so no level of the
+ * recursion copies the primitive list. After construction the array order
+ * is the leaf order of the tree.
+ */
+struct BVHPrimitiveInfo {
+    size_t index;       // Index into the caller's primitive list
+    AABB bounds;
+    Point3 centroid;
+};
+
 class BVHNode : public geometry::Primitive {
 public:
+    using PrimitiveList = std::vector<std::shared_ptr<geometry::Primitive>>;
+
+    // Maximum number of primitives the builder places in a single leaf
+    static constexpr size_t kMaxLeafSize = 4;
+
+    // Depth past which the builder switches to balanced median splits, which
+    // keeps trees shallow enough for fixed-size traversal stacks
+    static constexpr int kMedianSplitDepth = 32;
+
+    // Cost of visiting a node relative to intersecting one primitive
+    static constexpr float kTraversalCost = 1.0f;
+
     BVHNode() = default;
-    BVHNode(const std::vector<std::shared_ptr<geometry::Primitive>>& src_objects, 
-            size_t start, size_t end);
+
+    /**
+     * @brief Builds a BVH over a list of bounded primitives
+     *
+     * @param src_objects Primitives to enclose (all must have a bounding box)
+     * @throws std::runtime_error if a primitive is unbounded
+     */
+    explicit BVHNode(const PrimitiveList& src_objects);
+
+    /**
+     * @brief Builds the subtree for infos[start, end) using binned SAH splits
+     *
+     * Reorders infos in place. Leaves reference ranges of the reordered
+     * array, so the same builder serves callers that are not Primitives.
+     *
+     * @param infos Primitive bounds and centroids
+     * @param start First info of the range
+     * @param end One past the last info of the range
+     * @param primitives Primitives in final leaf order, or null for index-only trees
+     * @param max_leaf_size Largest leaf the builder may create
+     * @param leaf_group_width Primitives the caller tests at once with SIMD;
+     *                         the SAH charges one test per started group
+     */
+    BVHNode(std::vector<BVHPrimitiveInfo>& infos, size_t start, size_t end,
+            std::shared_ptr<const PrimitiveList> primitives = nullptr,
+            size_t max_leaf_size = kMaxLeafSize, size_t leaf_group_width = 1);
 
     bool hit(const core::Ray& ray, float t_min, float t_max, geometry::HitRecord& rec) const override;
+    bool bounding_box(AABB& output_box) const override;
+
+    bool is_leaf() const { return !left_; }
+    const BVHNode* left() const { return left_.get(); }
+    const BVHNode* right() const { return right_.get(); }
+    const AABB& box() const { return box_; }
+    size_t first_primitive() const { return first_; }
+    size_t primitive_count() const { return count_; }
+    int split_axis() const { return axis_; }
 
 private:
-    std::shared_ptr<geometry::Primitive> left_;
-    std::shared_ptr<geometry::Primitive> right_;
+    std::shared_ptr<BVHNode> left_;
+    std::shared_ptr<BVHNode> right_;
     AABB box_;
+
+    // Leaf range into the reordered primitive array
+    size_t first_ = 0;
+    size_t count_ = 0;
+    int axis_ = 0;
+    size_t max_leaf_size_ = kMaxLeafSize;
+    size_t leaf_group_width_ = 1;
+
+    // Primitives in leaf order, shared by every node of the tree
+    std::shared_ptr<const PrimitiveList> primitives_;
+
+    /**
+     * @brief Initializes this node from infos[start, end) and recurses into children
+     */
+    void build(std::vector<BVHPrimitiveInfo>& infos, size_t start, size_t end, int depth);
+
+    /**
+     * @brief Turns this node into an interior node over [start, mid) and [mid, end)
+     */
+    void split(std::vector<BVHPrimitiveInfo>& infos, size_t start, size_t mid, size_t end, int depth);
+
+    /**
+     * @brief SAH intersection cost of count primitives: one per started group
+     */
+    float group_cost(size_t count) const {
+        return static_cast<float>((count + leaf_group_width_ - 1) / leaf_group_width_);
+    }
 };
 
 // Helper functions for sorting
-bool box_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_compare(const std::shared_ptr<geometry::Primitive> a,
                  const std::shared_ptr<geometry::Primitive> b, int axis);
-bool box_x_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_x_compare(const std::shared_ptr<geometry::Primitive> a,
                    const std::shared_ptr<geometry::Primitive> b);
-bool box_y_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_y_compare(const std::shared_ptr<geometry::Primitive> a,
                    const std::shared_ptr<geometry::Primitive> b);
-bool box_z_compare(const std::shared_ptr<geometry::Primitive> a, 
+bool box_z_compare(const std::shared_ptr<geometry::Primitive> a,
                    const std::shared_ptr<geometry::Primitive> b);
 
 } // namespace acceleration
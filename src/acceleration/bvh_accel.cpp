@@ -0,0 +1,405 @@
+/**
+ * @file bvh_accel.cpp
+ * @brief Implementation of the BVH-backed primitive aggregate
+ */
+
+#include "bvh_accel.h"
+#include "bvh_cache.h"
+#include "lbvh_builder.h"
+#include "sbvh_builder.h"
+#include "treelet_optimizer.h"
+#include "../core/hash.h"
+#include "../geometry/triangle.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+
+namespace raytracer {
+namespace acceleration {
+
+BVHAccel::BVHAccel(const PrimitiveList& primitives, const BVHBuildSettings& settings)
+    : settings_(settings) {
+    auto start_time = std::chrono::steady_clock::now();
+    
+    const bool use_cache = !settings_.cache_directory.empty() && primitives.size() >= kMinCachedPrimitives;
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(primitives.size());
+    std::vector<AABB> bounds(primitives.size());
+    std::vector<uint64_t> geometry_hashes(use_cache ? primitives.size() : 0);
+    bool unbounded = false;
+    
+    #pragma omp parallel for reduction(||:unbounded)
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        if (!primitives[i]->bounding_box(bounds[i])) {
+            unbounded = true;
+        } else if (use_cache) {
+            geometry_hashes[i] = primitives[i]->geometry_hash();
+        }
+    }
+    if (unbounded) {
+        throw std::runtime_error("BVHAccel: cannot build over an unbounded primitive");
+    }
+
+    uint64_t key = 0;
+    std::string cache_path;
+    if (use_cache) {
+        key = cache_key(geometry_hashes);
+        cache_path = bvh_cache_path(settings_.cache_directory, key);
+        loaded_from_cache_ = load_cached_bvh(cache_path, key, primitives.size(), bvh_, wide4_, wide8_,
+                                             quantized4_, quantized8_, build_sah_cost_) &&
+                             has_layout_nodes();
+    }
+    if (!loaded_from_cache_) {
+        build(primitives, bounds);
+    }
+
+    primitives_.reserve(primitives.size());
+    for (uint32_t index : bvh_.primitive_indices()) {
+        primitives_.push_back(primitives[index]);
+    }
+    build_typed_leaves();
+    
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+    build_time_ms_ = elapsed.count();
+
+    // Written after timing so the build time reflects what the next run saves
+    if (use_cache && !loaded_from_cache_) {
+        try {
+            save_cached_bvh(cache_path, key, bvh_, wide4_, wide8_, quantized4_, quantized8_, build_sah_cost_);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Warning: " << e.what() << std::endl;
+        }
+    }
+}
+
+void BVHAccel::build(const PrimitiveList& primitives, const std::vector<AABB>& bounds) {
+    if (settings_.mode == BVHBuildMode::Fast) {
+        bvh_ = build_lbvh(bounds, settings_.refine_upper_levels);
+    } else if (settings_.spatial_splits) {
+        auto clip = [&primitives](uint32_t primitive, const AABB& clip_box) {
+            return primitives[primitive]->clipped_bounding_box(clip_box);
+        };
+        bvh_ = build_sbvh(bounds, clip, settings_.spatial_split_budget);
+    } else {
+        bvh_ = LinearBVH(bounds);
+    }
+    if (settings_.mode == BVHBuildMode::HighQuality) {
+        unoptimized_sah_cost_ = bvh_.sah_cost();
+        bvh_ = optimize_treelets(bvh_, settings_.treelet_size, kTreeletPasses);
+    }
+    build_wide_layout();
+    build_sah_cost_ = bvh_.sah_cost();
+}
+
+uint64_t BVHAccel::cache_key(const std::vector<uint64_t>& geometry_hashes) const {
+    // Every setting that changes the built tree, then the geometry in
+    // primitive order; the layout decides which node arrays are stored
+    uint64_t key = core::hash_combine(core::kHashSeed, static_cast<uint32_t>(settings_.mode));
+    key = core::hash_combine(key, settings_.refine_upper_levels);
+    key = core::hash_combine(key, settings_.spatial_splits);
+    key = core::hash_combine(key, settings_.spatial_split_budget);
+    key = core::hash_combine(key, settings_.treelet_size);
+    key = core::hash_combine(key, static_cast<uint32_t>(settings_.layout));
+    key = core::hash_combine(key, static_cast<uint64_t>(geometry_hashes.size()));
+    return core::hash_bytes(geometry_hashes.data(), geometry_hashes.size() * sizeof(uint64_t), key);
+}
+
+void BVHAccel::refit() {
+    auto start_time = std::chrono::steady_clock::now();
+    
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(primitives_.size());
+    std::vector<AABB> bounds(primitives_.size());
+    bool unbounded = false;
+    
+    #pragma omp parallel for reduction(||:unbounded)
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        if (!primitives_[i]->bounding_box(bounds[i])) {
+            unbounded = true;
+        }
+    }
+    if (unbounded) {
+        throw std::runtime_error("BVHAccel: cannot refit over an unbounded primitive");
+    }
+    
+    bvh_.refit(bounds);
+    build_wide_layout();
+    
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+    refit_time_ms_ = elapsed.count();
+}
+
+bool BVHAccel::needs_rebuild() const {
+    return build_sah_cost_ > 0.0f && bvh_.sah_cost() > build_sah_cost_ * settings_.rebuild_cost_ratio;
+}
+
+void BVHAccel::build_wide_layout() {
+    // The wide nodes copy their bounds from the binary tree, so they are
+    // collapsed again after every refit
+    if (settings_.layout == BVHLayout::Wide4) {
+        wide4_ = WideBVH<4>(bvh_);
+    } else if (settings_.layout == BVHLayout::Wide8) {
+        wide8_ = WideBVH<8>(bvh_);
+    } else if (settings_.layout == BVHLayout::Quantized4) {
+        quantized4_ = QuantizedBVH<4>(WideBVH<4>(bvh_));
+    } else if (settings_.layout == BVHLayout::Quantized8) {
+        quantized8_ = QuantizedBVH<8>(WideBVH<8>(bvh_));
+    }
+}
+
+bool BVHAccel::has_layout_nodes() const {
+    switch (settings_.layout) {
+        case BVHLayout::Wide4:
+            return !wide4_.empty();
+        case BVHLayout::Wide8:
+            return !wide8_.empty();
+        case BVHLayout::Quantized4:
+            return !quantized4_.empty();
+        case BVHLayout::Quantized8:
+            return !quantized8_.empty();
+        case BVHLayout::Binary:
+        default:
+            return true;
+    }
+}
+
+void BVHAccel::build_typed_leaves() {
+    refs_.assign(primitives_.size(), PrimitiveRef{PrimitiveKind::Other, 1, 0});
+    spheres_.clear();
+    quads_.clear();
+    triangle_groups_.clear();
+
+    auto is_triangle = [](const std::shared_ptr<geometry::Primitive>& primitive) {
+        return dynamic_cast<const geometry::Triangle*>(primitive.get()) != nullptr;
+    };
+
+    const auto& nodes = bvh_.nodes();
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (!nodes[n].is_leaf()) {
+            continue;
+        }
+        const uint32_t first = nodes[n].primitives_offset;
+        const uint32_t end = first + nodes[n].primitive_count;
+
+        // Only the order within a leaf changes, so the leaf ranges stay valid
+        auto leaf_begin = primitives_.begin() + first;
+        auto triangles_end = std::stable_partition(leaf_begin, primitives_.begin() + end, is_triangle);
+        const uint32_t triangle_count = static_cast<uint32_t>(triangles_end - leaf_begin);
+        if (triangle_count > 0) {
+            refs_[first] = PrimitiveRef{PrimitiveKind::Triangles, static_cast<uint16_t>(triangle_count),
+                                        static_cast<uint32_t>(triangle_groups_.size())};
+            for (uint32_t base = 0; base < triangle_count; base += kTriangleGroupWidth) {
+                geometry::TriangleGroup<kTriangleGroupWidth> group;
+                for (uint32_t lane = 0; lane < kTriangleGroupWidth && base + lane < triangle_count; ++lane) {
+                    const auto& triangle = static_cast<const geometry::Triangle&>(*primitives_[first + base + lane]);
+                    group.set(lane, triangle.record());
+                }
+                triangle_groups_.push_back(group);
+            }
+        }
+
+        for (uint32_t i = first + triangle_count; i < end; ++i) {
+            const geometry::Primitive* primitive = primitives_[i].get();
+            if (const auto* sphere = dynamic_cast<const geometry::Sphere*>(primitive)) {
+                refs_[i] = PrimitiveRef{PrimitiveKind::Sphere, 1, static_cast<uint32_t>(spheres_.size())};
+                spheres_.push_back(*sphere);
+            } else if (const auto* quad = dynamic_cast<const geometry::Quad*>(primitive)) {
+                refs_[i] = PrimitiveRef{PrimitiveKind::Quad, 1, static_cast<uint32_t>(quads_.size())};
+                quads_.push_back(*quad);
+            }
+        }
+    }
+}
+
+bool BVHAccel::find_hit_in_leaf(const core::Ray& ray, uint32_t first, uint32_t count, float t_min, float& t_max,
+                                geometry::SurfaceHit& hit) const {
+    bool hit_anything = false;
+    const uint32_t end = first + count;
+    for (uint32_t i = first; i < end; ++i) {
+        const PrimitiveRef& ref = refs_[i];
+        switch (ref.kind) {
+            case PrimitiveKind::Sphere:
+                if (spheres_[ref.index].find_hit(ray, t_min, t_max, hit)) {
+                    hit_anything = true;
+                    t_max = hit.t;
+                }
+                break;
+            case PrimitiveKind::Quad:
+                if (quads_[ref.index].find_hit(ray, t_min, t_max, hit)) {
+                    hit_anything = true;
+                    t_max = hit.t;
+                }
+                break;
+            case PrimitiveKind::Triangles: {
+                // The hit names the original Triangle, which computes the surface data
+                uint32_t group = ref.index;
+                for (uint32_t base = 0; base < ref.count; base += kTriangleGroupWidth, ++group) {
+                    float t, u, v;
+                    int lane = geometry::intersect_triangle_group(triangle_groups_[group], ray, t_min, t_max, t, u, v);
+                    if (lane >= 0) {
+                        hit_anything = true;
+                        t_max = t;
+                        hit.set(t, u, v, 0, primitives_[i + base + static_cast<uint32_t>(lane)].get());
+                    }
+                }
+                i += ref.count - 1;
+                break;
+            }
+            case PrimitiveKind::Other:
+            default:
+                if (primitives_[i]->find_hit(ray, t_min, t_max, hit)) {
+                    hit_anything = true;
+                    t_max = hit.t;
+                }
+                break;
+        }
+    }
+    return hit_anything;
+}
+
+bool BVHAccel::occluded_in_leaf(const core::Ray& ray, uint32_t first, uint32_t count, float t_min,
+                                float t_max) const {
+    const uint32_t end = first + count;
+    for (uint32_t i = first; i < end; ++i) {
+        const PrimitiveRef& ref = refs_[i];
+        switch (ref.kind) {
+            case PrimitiveKind::Sphere: {
+                float t;
+                if (spheres_[ref.index].intersect(ray, t_min, t_max, t)) {
+                    return true;
+                }
+                break;
+            }
+            case PrimitiveKind::Quad: {
+                float t, alpha, beta;
+                if (quads_[ref.index].intersect(ray, t_min, t_max, t, alpha, beta)) {
+                    return true;
+                }
+                break;
+            }
+            case PrimitiveKind::Triangles: {
+                const uint32_t groups = (ref.count + kTriangleGroupWidth - 1) / kTriangleGroupWidth;
+                for (uint32_t group = ref.index; group < ref.index + groups; ++group) {
+                    if (geometry::occluded_triangle_group(triangle_groups_[group], ray, t_min, t_max)) {
+                        return true;
+                    }
+                }
+                i += ref.count - 1;
+                break;
+            }
+            case PrimitiveKind::Other:
+            default:
+                if (primitives_[i]->occluded(ray, t_min, t_max)) {
+                    return true;
+                }
+                break;
+        }
+    }
+    return false;
+}
+
+template <typename NodeCounter>
+bool BVHAccel::closest_hit(const core::Ray& ray, float t_min, float t_max, geometry::SurfaceHit& hit,
+                           uint32_t& primitives_tested, NodeCounter&& count_node) const {
+    auto intersect_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float& closest_so_far) {
+        primitives_tested += count;
+        return find_hit_in_leaf(ray, first, count, leaf_t_min, closest_so_far, hit);
+    };
+
+    switch (settings_.layout) {
+        case BVHLayout::Wide4:
+            return wide4_.intersect(ray, t_min, t_max, intersect_leaf, count_node);
+        case BVHLayout::Wide8:
+            return wide8_.intersect(ray, t_min, t_max, intersect_leaf, count_node);
+        case BVHLayout::Quantized4:
+            return quantized4_.intersect(ray, t_min, t_max, intersect_leaf, count_node);
+        case BVHLayout::Quantized8:
+            return quantized8_.intersect(ray, t_min, t_max, intersect_leaf, count_node);
+        case BVHLayout::Binary:
+        default:
+            return bvh_.intersect(ray, t_min, t_max, intersect_leaf, count_node);
+    }
+}
+
+bool BVHAccel::hit(const core::Ray& ray, float t_min, float t_max, geometry::HitRecord& rec) const {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool BVHAccel::find_hit(const core::Ray& ray, float t_min, float t_max, geometry::SurfaceHit& hit) const {
+    // The count is a dead store here and optimizes away
+    uint32_t primitives_tested = 0;
+    return closest_hit(ray, t_min, t_max, hit, primitives_tested, IgnoreNodeVisits());
+}
+
+bool BVHAccel::hit(const core::Ray& ray, float t_min, float t_max, geometry::HitRecord& rec,
+                   TraversalCounts& counts) const {
+    geometry::SurfaceHit hit;
+    if (!closest_hit(ray, t_min, t_max, hit, counts.primitives_tested, [&counts]() { ++counts.nodes_visited; })) {
+        return false;
+    }
+    return hit.complete(ray, rec);
+}
+
+uint32_t BVHAccel::hit_packet(const core::RayPacket& packet, float t_min, float* t_max,
+                              geometry::HitRecord* records) const {
+    geometry::SurfaceHit hits[core::RayPacket::kMaxSize];
+    uint32_t hit_mask = find_hit_packet(packet, t_min, t_max, hits);
+    for (int i = 0; i < packet.size; ++i) {
+        if ((hit_mask & (1u << i)) && !hits[i].complete(packet.rays[i], records[i])) {
+            hit_mask &= ~(1u << i);
+        }
+    }
+    return hit_mask;
+}
+
+uint32_t BVHAccel::find_hit_packet(const core::RayPacket& packet, float t_min, float* t_max,
+                                   geometry::SurfaceHit* hits) const {
+    uint32_t hit_mask = 0;
+    if (!packet.is_coherent()) {
+        for (int i = 0; i < packet.size; ++i) {
+            if (find_hit(packet.rays[i], t_min, t_max[i], hits[i])) {
+                hit_mask |= 1u << i;
+                t_max[i] = hits[i].t;
+            }
+        }
+        return hit_mask;
+    }
+
+    auto intersect_leaf = [&](int ray, uint32_t first, uint32_t count, float leaf_t_min, float& closest_so_far) {
+        bool hit_anything = find_hit_in_leaf(packet.rays[ray], first, count, leaf_t_min, closest_so_far, hits[ray]);
+        if (hit_anything) {
+            hit_mask |= 1u << ray;
+        }
+        return hit_anything;
+    };
+    bvh_.intersect_packet(packet, t_min, t_max, intersect_leaf);
+    return hit_mask;
+}
+
+bool BVHAccel::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    auto occluded_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float leaf_t_max) {
+        return occluded_in_leaf(ray, first, count, leaf_t_min, leaf_t_max);
+    };
+
+    switch (settings_.layout) {
+        case BVHLayout::Wide4:
+            return wide4_.occluded(ray, t_min, t_max, occluded_leaf);
+        case BVHLayout::Wide8:
+            return wide8_.occluded(ray, t_min, t_max, occluded_leaf);
+        case BVHLayout::Quantized4:
+            return quantized4_.occluded(ray, t_min, t_max, occluded_leaf);
+        case BVHLayout::Quantized8:
+            return quantized8_.occluded(ray, t_min, t_max, occluded_leaf);
+        case BVHLayout::Binary:
+        default:
+            return bvh_.occluded(ray, t_min, t_max, occluded_leaf);
+    }
+}
+
+bool BVHAccel::bounding_box(AABB& output_box) const {
+    output_box = bvh_.bounds();
+    return !bvh_.empty();
+}
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,269 @@
+/**
+ * @file bvh_accel.h
+ * @brief Primitive aggregate backed by a flattened BVH
+ * 
+ * This is the acceleration structure the scene traces against. It owns
+ * the primitives in leaf order so that leaf ranges of the linear BVH
+ * address them directly.
+ * 
+ * The common shapes are not called through the Primitive interface.
+ * Spheres and quads are copied into contiguous per-type arrays, and the
+ * triangles of each leaf into SIMD triangle groups; every leaf slot holds
+ * a (kind, index) reference and leaves dispatch on the kind with a
+ * switch, so the tests inline into traversal. Any other shape, including
+ * meshes, sphere sets, instances and custom Primitive subclasses, is
+ * called virtually.
+ */
+
+#pragma once
+
+#include "../geometry/primitive.h"
+#include "../geometry/quad.h"
+#include "../geometry/sphere.h"
+#include "../geometry/triangle_group.h"
+#include "linear_bvh.h"
+#include "quantized_bvh.h"
+#include "wide_bvh.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace raytracer {
+namespace acceleration {
+
+/**
+ * @brief Node layout traversed at render time
+ * 
+ * Every layout is derived from the same binary tree. The wide layouts
+ * test 4 or 8 child boxes per node with one SIMD slab test. The quantized
+ * layouts are the wide ones with 8-bit child boxes, half the node memory
+ * for the cost of decoding them during traversal.
+ */
+enum class BVHLayout {
+    Binary,
+    Wide4,
+    Wide8,
+    Quantized4,
+    Quantized8
+};
+
+/**
+ * @brief Builder used to produce the binary tree
+ * 
+ * Quality runs the binned SAH builder. Fast runs the parallel Morton-code
+ * builder, which finishes much sooner on large scenes at some cost in
+ * traversal speed. HighQuality runs the Quality build and then
+ * restructures its treelets for a lower SAH cost, for final renders that
+ * can afford the extra build time.
+ */
+enum class BVHBuildMode {
+    Fast,
+    Quality,
+    HighQuality
+};
+
+struct BVHBuildSettings {
+    BVHBuildMode mode = BVHBuildMode::Quality;
+    bool refine_upper_levels = true;    // Fast mode: SAH over the top of the Morton tree (HLBVH)
+    bool spatial_splits = false;        // Quality modes: SBVH, duplicating straddling primitives; Fast ignores it
+    float spatial_split_budget = 0.3f;  // Extra references SBVH may add, as a fraction of the primitive count
+    int treelet_size = 7;               // HighQuality mode: leaves per restructured treelet (5 to 7)
+    BVHLayout layout = BVHLayout::Wide4;
+    float rebuild_cost_ratio = 1.5f;    // Refit: rebuild once SAH cost exceeds this multiple of the built cost
+    std::string cache_directory;        // Where built trees are cached across runs; empty disables the cache
+};
+
+/**
+ * @brief Work done by one traversal, for hierarchy quality reports
+ */
+struct TraversalCounts {
+    uint32_t nodes_visited = 0;      // Nodes whose bounds were tested (wide nodes count once)
+    uint32_t primitives_tested = 0;  // Primitive intersection tests in visited leaves
+};
+
+class BVHAccel : public geometry::Primitive {
+public:
+    using PrimitiveList = std::vector<std::shared_ptr<geometry::Primitive>>;
+
+    // Smaller trees build faster than a cache file is hashed and written
+    static constexpr size_t kMinCachedPrimitives = 4096;
+
+    /**
+     * @brief Builds the hierarchy over a list of bounded primitives
+     * 
+     * With a cache directory set, the tree is looked up by a hash of the
+     * primitives' geometry and the build settings, and mapped from disk on
+     * a hit; on a miss it is built and written there for the next run.
+     * 
+     * @param primitives Primitives to enclose (all must have a bounding box)
+     * @param settings Build and layout options
+     * @throws std::runtime_error if a primitive is unbounded
+     */
+    explicit BVHAccel(const PrimitiveList& primitives, const BVHBuildSettings& settings = BVHBuildSettings());
+
+    bool hit(const core::Ray& ray, float t_min, float t_max, geometry::HitRecord& rec) const override;
+    
+    /**
+     * @brief Closest hit without surface data
+     * 
+     * Leaves report their hits as SurfaceHits, so only the closest one is
+     * ever expanded, by the caller. The hit names the leaf primitive, not
+     * this aggregate.
+     */
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, geometry::SurfaceHit& hit) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(AABB& output_box) const override;
+    
+    /**
+     * @brief hit() that also counts the traversal work it does
+     * 
+     * Slower than the plain query; meant for statistics, not rendering.
+     * 
+     * @param counts Incremented by the nodes and primitives this ray visits
+     */
+    bool hit(const core::Ray& ray, float t_min, float t_max, geometry::HitRecord& rec, TraversalCounts& counts) const;
+    
+    /**
+     * @brief Finds the closest hit of every ray in a packet
+     * 
+     * Coherent packets (see RayPacket::is_coherent) are traced together
+     * through the binary tree with packet culling; others fall back to
+     * one single-ray traversal per ray.
+     * 
+     * @param packet Rays to trace
+     * @param t_min Minimum hit distance
+     * @param t_max Per-ray maximum hit distance; each shrinks to its closest hit
+     * @param records Receives the hit record of every ray that hits
+     * @return Bit mask of the rays that hit
+     */
+    uint32_t hit_packet(const core::RayPacket& packet, float t_min, float* t_max,
+                        geometry::HitRecord* records) const;
+    
+    /**
+     * @brief hit_packet() without surface data, see find_hit()
+     * 
+     * @param hits Receives the hit of every ray that hits
+     */
+    uint32_t find_hit_packet(const core::RayPacket& packet, float t_min, float* t_max,
+                             geometry::SurfaceHit* hits) const;
+
+    const LinearBVH& linear_bvh() const { return bvh_; }
+    const WideBVH<4>& wide4_bvh() const { return wide4_; }
+    const WideBVH<8>& wide8_bvh() const { return wide8_; }
+    const QuantizedBVH<4>& quantized4_bvh() const { return quantized4_; }
+    const QuantizedBVH<8>& quantized8_bvh() const { return quantized8_; }
+    const BVHBuildSettings& settings() const { return settings_; }
+    size_t primitive_count() const { return primitives_.size(); }
+    
+    /**
+     * @brief Primitives in leaf order; spatial splits can list one several times
+     */
+    const PrimitiveList& primitives() const { return primitives_; }
+    
+    /**
+     * @brief Wall-clock time of the build, including the wide-layout collapse
+     *        (or of hashing and mapping the cache file on a cache hit)
+     */
+    double build_time_ms() const { return build_time_ms_; }
+    
+    /**
+     * @brief True if the tree was mapped from the cache instead of built
+     */
+    bool loaded_from_cache() const { return loaded_from_cache_; }
+    
+    /**
+     * @brief Recomputes node bounds after primitives moved in place
+     * 
+     * Keeps the tree topology and primitive order; only valid while the
+     * set of primitives is unchanged.
+     * 
+     * @throws std::runtime_error if a primitive has become unbounded
+     */
+    void refit();
+    
+    /**
+     * @brief True once refits have degraded the SAH cost past the
+     *        configured ratio of its build-time value
+     */
+    bool needs_rebuild() const;
+    
+    float sah_cost() const { return bvh_.sah_cost(); }
+    float build_sah_cost() const { return build_sah_cost_; }
+    
+    /**
+     * @brief SAH cost before treelet restructuring in HighQuality mode
+     * 
+     * @return 0 in other modes, and for trees loaded from the cache
+     */
+    float unoptimized_sah_cost() const { return unoptimized_sah_cost_; }
+    double refit_time_ms() const { return refit_time_ms_; }
+
+private:
+    // HighQuality restructuring sweeps; gains flatten out after about three
+    static constexpr int kTreeletPasses = 3;
+    
+    // Lanes per triangle group, matching the default leaf size
+    static constexpr int kTriangleGroupWidth = 4;
+    
+    /**
+     * @brief How the primitive in a leaf slot is tested
+     */
+    enum class PrimitiveKind : uint8_t {
+        Sphere,     // spheres_[index]
+        Quad,       // quads_[index]
+        Triangles,  // The leaf's count triangles from this slot on, in triangle_groups_ from index
+        Other       // Virtual call on primitives_ at the slot
+    };
+    
+    struct PrimitiveRef {
+        PrimitiveKind kind;
+        uint16_t count;
+        uint32_t index;
+    };
+
+    BVHBuildSettings settings_;
+    LinearBVH bvh_;             // Always built; the wide layouts are collapsed from it
+    WideBVH<4> wide4_;
+    WideBVH<8> wide8_;
+    QuantizedBVH<4> quantized4_;
+    QuantizedBVH<8> quantized8_;
+    PrimitiveList primitives_;  // Leaf order, each leaf's triangles first
+    std::vector<PrimitiveRef> refs_;    // One per entry of primitives_
+    std::vector<geometry::Sphere> spheres_;
+    std::vector<geometry::Quad> quads_;
+    std::vector<geometry::TriangleGroup<kTriangleGroupWidth>> triangle_groups_;
+    double build_time_ms_ = 0.0;
+    double refit_time_ms_ = 0.0;
+    float build_sah_cost_ = 0.0f;
+    float unoptimized_sah_cost_ = 0.0f;
+    bool loaded_from_cache_ = false;
+    
+    void build(const PrimitiveList& primitives, const std::vector<AABB>& bounds);
+    
+    /**
+     * @brief Sorts each leaf's triangles to its front and fills the typed arrays
+     * 
+     * Spheres, quads and triangles cannot change after construction, so
+     * the copies stay valid across refits.
+     */
+    void build_typed_leaves();
+    
+    /**
+     * @brief Closest hit among the primitives [first, first + count) of a leaf
+     * 
+     * @param t_max Shrinks to the closest hit
+     */
+    bool find_hit_in_leaf(const core::Ray& ray, uint32_t first, uint32_t count, float t_min, float& t_max,
+                          geometry::SurfaceHit& hit) const;
+    bool occluded_in_leaf(const core::Ray& ray, uint32_t first, uint32_t count, float t_min, float t_max) const;
+    
+    template <typename NodeCounter>
+    bool closest_hit(const core::Ray& ray, float t_min, float t_max, geometry::SurfaceHit& hit,
+                     uint32_t& primitives_tested, NodeCounter&& count_node) const;
+    void build_wide_layout();
+    bool has_layout_nodes() const;
+    uint64_t cache_key(const std::vector<uint64_t>& geometry_hashes) const;
+};
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,223 @@
+/**
+ * @file bvh_cache.cpp
+ * @brief Cache file format, mapping and writing
+ */
+
+#include "bvh_cache.h"
+#include "../core/mapped_file.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    constexpr char kMagic[8] = {'R', 'T', 'B', 'V', 'H', 'C', 0, 0};
+    constexpr uint32_t kVersion = 2;
+    constexpr uint32_t kByteOrderMark = 0x01020304;
+    constexpr uint64_t kSectionAlignment = 64;
+
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t key;
+        uint32_t node_size;
+        uint32_t wide4_node_size;
+        uint32_t wide8_node_size;
+        uint32_t quantized4_node_size;
+        uint32_t quantized8_node_size;
+        float sah_cost;
+        uint64_t node_count;
+        uint64_t index_count;
+        uint64_t wide4_count;
+        uint64_t wide8_count;
+        uint64_t quantized4_count;
+        uint64_t quantized8_count;
+        uint64_t node_offset;
+        uint64_t index_offset;
+        uint64_t wide4_offset;
+        uint64_t wide8_offset;
+        uint64_t quantized4_offset;
+        uint64_t quantized8_offset;
+    };
+
+    uint64_t align_up(uint64_t offset) {
+        return (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+    }
+
+    bool section_fits(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size) {
+        return offset % kSectionAlignment == 0 && offset <= file_size &&
+               count <= (file_size - offset) / element_size;
+    }
+
+    template <typename T>
+    NodeArray<T> map_section(const std::shared_ptr<const core::MappedFile>& file, uint64_t offset, uint64_t count) {
+        const T* data = reinterpret_cast<const T*>(file->data() + offset);
+        return NodeArray<T>::view(data, static_cast<size_t>(count), file);
+    }
+
+    template <typename T>
+    void write_section(std::ofstream& out, uint64_t offset, const NodeArray<T>& section) {
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(reinterpret_cast<const char*>(section.data()),
+                  static_cast<std::streamsize>(section.size() * sizeof(T)));
+    }
+}
+
+std::string bvh_cache_path(const std::string& directory, uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bvh", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool load_cached_bvh(const std::string& path, uint64_t key, uint64_t primitive_count, LinearBVH& binary,
+                     WideBVH<4>& wide4,
+                     WideBVH<8>& wide8, QuantizedBVH<4>& quantized4, QuantizedBVH<8>& quantized8,
+                     float& sah_cost) {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        return false;
+    }
+
+    std::shared_ptr<const core::MappedFile> file;
+    try {
+        file = core::MappedFile::open(path);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+
+    if (file->size() < sizeof(CacheHeader)) {
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.byte_order != kByteOrderMark || header.key != key ||
+        header.node_size != sizeof(LinearBVHNode) || header.wide4_node_size != sizeof(WideBVHNode<4>) ||
+        header.wide8_node_size != sizeof(WideBVHNode<8>) ||
+        header.quantized4_node_size != sizeof(QuantizedBVHNode<4>) ||
+        header.quantized8_node_size != sizeof(QuantizedBVHNode<8>) || header.node_count == 0) {
+        return false;
+    }
+
+    const uint64_t size = file->size();
+    if (!section_fits(header.node_offset, header.node_count, sizeof(LinearBVHNode), size) ||
+        !section_fits(header.index_offset, header.index_count, sizeof(uint32_t), size) ||
+        !section_fits(header.wide4_offset, header.wide4_count, sizeof(WideBVHNode<4>), size) ||
+        !section_fits(header.wide8_offset, header.wide8_count, sizeof(WideBVHNode<8>), size) ||
+        !section_fits(header.quantized4_offset, header.quantized4_count, sizeof(QuantizedBVHNode<4>), size) ||
+        !section_fits(header.quantized8_offset, header.quantized8_count, sizeof(QuantizedBVHNode<8>), size)) {
+        return false;
+    }
+
+    // Each section holds a share of the mapping, which is released with the last of them
+    LinearBVH mapped_binary(map_section<LinearBVHNode>(file, header.node_offset, header.node_count),
+                            map_section<uint32_t>(file, header.index_offset, header.index_count));
+    WideBVH<4> mapped_wide4 =
+        header.wide4_count > 0 ? WideBVH<4>(map_section<WideBVHNode<4>>(file, header.wide4_offset, header.wide4_count))
+                               : WideBVH<4>();
+    WideBVH<8> mapped_wide8 =
+        header.wide8_count > 0 ? WideBVH<8>(map_section<WideBVHNode<8>>(file, header.wide8_offset, header.wide8_count))
+                               : WideBVH<8>();
+    QuantizedBVH<4> mapped_quantized4 =
+        header.quantized4_count > 0
+            ? QuantizedBVH<4>(map_section<QuantizedBVHNode<4>>(file, header.quantized4_offset, header.quantized4_count))
+            : QuantizedBVH<4>();
+    QuantizedBVH<8> mapped_quantized8 =
+        header.quantized8_count > 0
+            ? QuantizedBVH<8>(map_section<QuantizedBVHNode<8>>(file, header.quantized8_offset, header.quantized8_count))
+            : QuantizedBVH<8>();
+
+    // A stale, truncated or edited file must not send traversal outside
+    // the arrays, so every offset and index is checked once
+    const uint64_t index_count = header.index_count;
+    if (!mapped_binary.valid(primitive_count) || !mapped_wide4.valid(index_count) ||
+        !mapped_wide8.valid(index_count) || !mapped_quantized4.valid(index_count) ||
+        !mapped_quantized8.valid(index_count)) {
+        return false;
+    }
+
+    binary = std::move(mapped_binary);
+    wide4 = std::move(mapped_wide4);
+    wide8 = std::move(mapped_wide8);
+    quantized4 = std::move(mapped_quantized4);
+    quantized8 = std::move(mapped_quantized8);
+    sah_cost = header.sah_cost;
+    return true;
+}
+
+void save_cached_bvh(const std::string& path, uint64_t key, const LinearBVH& binary, const WideBVH<4>& wide4,
+                     const WideBVH<8>& wide8, const QuantizedBVH<4>& quantized4,
+                     const QuantizedBVH<8>& quantized8, float sah_cost) {
+    CacheHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrderMark;
+    header.key = key;
+    header.node_size = sizeof(LinearBVHNode);
+    header.wide4_node_size = sizeof(WideBVHNode<4>);
+    header.wide8_node_size = sizeof(WideBVHNode<8>);
+    header.quantized4_node_size = sizeof(QuantizedBVHNode<4>);
+    header.quantized8_node_size = sizeof(QuantizedBVHNode<8>);
+    header.sah_cost = sah_cost;
+    header.node_count = binary.nodes().size();
+    header.index_count = binary.primitive_indices().size();
+    header.wide4_count = wide4.nodes().size();
+    header.wide8_count = wide8.nodes().size();
+    header.quantized4_count = quantized4.nodes().size();
+    header.quantized8_count = quantized8.nodes().size();
+    header.node_offset = align_up(sizeof(CacheHeader));
+    header.index_offset = align_up(header.node_offset + header.node_count * sizeof(LinearBVHNode));
+    header.wide4_offset = align_up(header.index_offset + header.index_count * sizeof(uint32_t));
+    header.wide8_offset = align_up(header.wide4_offset + header.wide4_count * sizeof(WideBVHNode<4>));
+    header.quantized4_offset = align_up(header.wide8_offset + header.wide8_count * sizeof(WideBVHNode<8>));
+    header.quantized8_offset =
+        align_up(header.quantized4_offset + header.quantized4_count * sizeof(QuantizedBVHNode<4>));
+    const uint64_t file_size = header.quantized8_offset + header.quantized8_count * sizeof(QuantizedBVHNode<8>);
+
+    std::filesystem::path target(path);
+    std::error_code error;
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to create BVH cache file: " + temporary);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_section(out, header.node_offset, binary.nodes());
+        write_section(out, header.index_offset, binary.primitive_indices());
+        write_section(out, header.wide4_offset, wide4.nodes());
+        write_section(out, header.wide8_offset, wide8.nodes());
+        write_section(out, header.quantized4_offset, quantized4.nodes());
+        write_section(out, header.quantized8_offset, quantized8.nodes());
+
+        // Seeking past the end leaves the gaps unwritten; pin the final size
+        if (static_cast<uint64_t>(out.tellp()) < file_size) {
+            out.seekp(static_cast<std::streamoff>(file_size - 1));
+            out.put('\0');
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write BVH cache file: " + temporary);
+        }
+    }
+
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("Failed to move BVH cache file into place: " + path);
+    }
+}
+
+} // namespace acceleration
+} // namespace raytracer
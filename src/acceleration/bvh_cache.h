@@ -0,0 +1,62 @@
+/**
+ * @file bvh_cache.h
+ * @brief On-disk cache of built BVHs
+ *
+ * A cache file stores the node and index arrays exactly as they sit in
+ * memory, each section aligned for the node types. Loading maps the file
+ * and points the hierarchy at the mapped sections, so a cache hit costs
+ * one bounds-checking pass over nodes and indices instead of a build.
+ * Files are only valid on machines with the same byte order and node
+ * layout; anything else is treated as a miss.
+ */
+
+#pragma once
+
+#include "linear_bvh.h"
+#include "quantized_bvh.h"
+#include "wide_bvh.h"
+#include <cstdint>
+#include <string>
+
+namespace raytracer {
+namespace acceleration {
+
+/**
+ * @brief Path of the cache file for a key inside a cache directory
+ */
+std::string bvh_cache_path(const std::string& directory, uint64_t key);
+
+/**
+ * @brief Maps a cached hierarchy
+ *
+ * @param path Cache file
+ * @param key Expected key; a file written for another key is a miss
+ * @param primitive_count Number of primitives the cached indices must address
+ * @param binary Receives the binary tree and primitive order
+ * @param wide4 Receives the 4-wide nodes, empty if none were stored
+ * @param wide8 Receives the 8-wide nodes, empty if none were stored
+ * @param quantized4 Receives the quantized 4-wide nodes, empty if none were stored
+ * @param quantized8 Receives the quantized 8-wide nodes, empty if none were stored
+ * @param sah_cost Receives the SAH cost recorded when the tree was built
+ * @return False on a miss: missing, truncated, stale, corrupt or foreign
+ *         file, including any offset or index outside its array
+ */
+bool load_cached_bvh(const std::string& path, uint64_t key, uint64_t primitive_count, LinearBVH& binary,
+                     WideBVH<4>& wide4,
+                     WideBVH<8>& wide8, QuantizedBVH<4>& quantized4, QuantizedBVH<8>& quantized8,
+                     float& sah_cost);
+
+/**
+ * @brief Writes a hierarchy to the cache
+ *
+ * The file is written under a temporary name and renamed into place, so
+ * a concurrent or interrupted run never sees a partial file.
+ *
+ * @throws std::runtime_error if the file cannot be written
+ */
+void save_cached_bvh(const std::string& path, uint64_t key, const LinearBVH& binary, const WideBVH<4>& wide4,
+                     const WideBVH<8>& wide8, const QuantizedBVH<4>& quantized4,
+                     const QuantizedBVH<8>& quantized8, float sah_cost);
+
+} // namespace acceleration
+} // namespace raytracer
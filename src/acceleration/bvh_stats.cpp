@@ -0,0 +1,232 @@
+/**
+ * @file bvh_stats.cpp
+ * @brief Implementation of the BVH quality report
+ */
+
+#include "bvh_stats.h"
+#include "../geometry/sphere_set.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    // Nearest-rank percentile of an unsorted sample; reorders it
+    uint32_t percentile(std::vector<uint32_t>& values, double fraction) {
+        if (values.empty()) {
+            return 0;
+        }
+        // Smallest value with at least fraction of the sample at or below it
+        const double position = std::ceil(fraction * static_cast<double>(values.size()));
+        size_t rank = position > 1.0 ? static_cast<size_t>(position) - 1 : 0;
+        rank = std::min(rank, values.size() - 1);
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(rank), values.end());
+        return values[rank];
+    }
+
+    const char* mode_name(const BVHBuildSettings& settings) {
+        if (settings.mode == BVHBuildMode::Fast) {
+            return settings.refine_upper_levels ? "fast (HLBVH)" : "fast (LBVH)";
+        }
+        if (settings.mode == BVHBuildMode::HighQuality) {
+            return settings.spatial_splits ? "high quality (SBVH + treelets)" : "high quality (SAH + treelets)";
+        }
+        return settings.spatial_splits ? "quality (SBVH)" : "quality (SAH)";
+    }
+
+    const char* layout_name(BVHLayout layout) {
+        switch (layout) {
+            case BVHLayout::Wide4:
+                return "wide4";
+            case BVHLayout::Wide8:
+                return "wide8";
+            case BVHLayout::Quantized4:
+                return "quantized4";
+            case BVHLayout::Quantized8:
+                return "quantized8";
+            case BVHLayout::Binary:
+            default:
+                return "binary";
+        }
+    }
+}
+
+BVHStats compute_bvh_stats(const BVHAccel& bvh) {
+    BVHStats stats;
+    stats.settings = bvh.settings();
+    stats.loaded_from_cache = bvh.loaded_from_cache();
+    stats.build_time_ms = bvh.build_time_ms();
+    stats.sah_cost = bvh.sah_cost();
+    stats.build_sah_cost = bvh.build_sah_cost();
+    stats.unoptimized_sah_cost = bvh.unoptimized_sah_cost();
+
+    const LinearBVH& binary = bvh.linear_bvh();
+    const auto& nodes = binary.nodes();
+    stats.primitive_references = binary.primitive_indices().size();
+    stats.node_count = nodes.size();
+    stats.node_bytes = nodes.size() * sizeof(LinearBVHNode);
+    stats.index_bytes = binary.primitive_indices().size() * sizeof(uint32_t);
+
+    if (stats.settings.layout == BVHLayout::Wide4) {
+        stats.wide_node_count = bvh.wide4_bvh().nodes().size();
+        stats.wide_node_bytes = stats.wide_node_count * sizeof(WideBVHNode<4>);
+    } else if (stats.settings.layout == BVHLayout::Wide8) {
+        stats.wide_node_count = bvh.wide8_bvh().nodes().size();
+        stats.wide_node_bytes = stats.wide_node_count * sizeof(WideBVHNode<8>);
+    } else if (stats.settings.layout == BVHLayout::Quantized4) {
+        stats.wide_node_count = bvh.quantized4_bvh().nodes().size();
+        stats.wide_node_bytes = stats.wide_node_count * sizeof(QuantizedBVHNode<4>);
+    } else if (stats.settings.layout == BVHLayout::Quantized8) {
+        stats.wide_node_count = bvh.quantized8_bvh().nodes().size();
+        stats.wide_node_bytes = stats.wide_node_count * sizeof(QuantizedBVHNode<8>);
+    }
+
+    // Spatial splits can reference one primitive from several leaves
+    std::unordered_set<const geometry::Primitive*> seen;
+    for (const auto& primitive : bvh.primitives()) {
+        const auto* spheres = dynamic_cast<const geometry::SphereSet*>(primitive.get());
+        if (spheres && seen.insert(spheres).second) {
+            stats.sphere_set_count++;
+            stats.sphere_set_spheres += spheres->size();
+            stats.sphere_set_bytes += spheres->memory_bytes();
+        }
+    }
+
+    if (nodes.empty()) {
+        return stats;
+    }
+
+    // Depth-first walk carrying each node's depth
+    std::vector<std::pair<uint32_t, int>> stack = {{0u, 0}};
+    size_t depth_sum = 0;
+    while (!stack.empty()) {
+        auto [index, depth] = stack.back();
+        stack.pop_back();
+        const LinearBVHNode& node = nodes[index];
+        stats.max_depth = std::max(stats.max_depth, depth);
+
+        if (node.is_leaf()) {
+            ++stats.leaf_count;
+            depth_sum += static_cast<size_t>(depth);
+            if (stats.leaves_per_depth.size() <= static_cast<size_t>(depth)) {
+                stats.leaves_per_depth.resize(static_cast<size_t>(depth) + 1, 0);
+            }
+            ++stats.leaves_per_depth[static_cast<size_t>(depth)];
+            if (stats.leaves_per_size.size() <= node.primitive_count) {
+                stats.leaves_per_size.resize(node.primitive_count + 1u, 0);
+            }
+            ++stats.leaves_per_size[node.primitive_count];
+        } else {
+            stack.push_back({node.second_child_offset, depth + 1});
+            stack.push_back({index + 1, depth + 1});
+        }
+    }
+    stats.mean_leaf_depth = static_cast<double>(depth_sum) / static_cast<double>(stats.leaf_count);
+
+    return stats;
+}
+
+TraversalStats sample_traversal(const BVHAccel& bvh, const std::vector<core::Ray>& rays) {
+    TraversalStats stats;
+    stats.ray_count = rays.size();
+    if (rays.empty()) {
+        return stats;
+    }
+
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(rays.size());
+    std::vector<uint32_t> nodes_visited(rays.size());
+    std::vector<uint32_t> primitives_tested(rays.size());
+    size_t hit_count = 0;
+
+    #pragma omp parallel for reduction(+:hit_count)
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        TraversalCounts counts;
+        geometry::HitRecord rec;
+        if (bvh.hit(rays[i], 0.001f, std::numeric_limits<float>::infinity(), rec, counts)) {
+            ++hit_count;
+        }
+        nodes_visited[i] = counts.nodes_visited;
+        primitives_tested[i] = counts.primitives_tested;
+    }
+    stats.hit_count = hit_count;
+
+    double node_sum = 0.0;
+    double primitive_sum = 0.0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        node_sum += nodes_visited[i];
+        primitive_sum += primitives_tested[i];
+        stats.max_nodes_visited = std::max(stats.max_nodes_visited, nodes_visited[i]);
+        stats.max_primitives_tested = std::max(stats.max_primitives_tested, primitives_tested[i]);
+    }
+    stats.mean_nodes_visited = node_sum / static_cast<double>(rays.size());
+    stats.mean_primitives_tested = primitive_sum / static_cast<double>(rays.size());
+    stats.p99_nodes_visited = percentile(nodes_visited, 0.99);
+    stats.p99_primitives_tested = percentile(primitives_tested, 0.99);
+
+    return stats;
+}
+
+void to_json(nlohmann::json& json, const BVHStats& stats) {
+    json = nlohmann::json{
+        {"build", {
+            {"mode", mode_name(stats.settings)},
+            {"layout", layout_name(stats.settings.layout)},
+            {"loaded_from_cache", stats.loaded_from_cache},
+            {"time_ms", stats.build_time_ms}
+        }},
+        {"primitive_references", stats.primitive_references},
+        {"nodes", {
+            {"total", stats.node_count},
+            {"interior", stats.node_count - stats.leaf_count},
+            {"leaves", stats.leaf_count},
+            {"wide", stats.wide_node_count}
+        }},
+        {"depth", {
+            {"max", stats.max_depth},
+            {"mean_leaf", stats.mean_leaf_depth},
+            {"leaves_per_depth", stats.leaves_per_depth}
+        }},
+        {"leaves_per_size", stats.leaves_per_size},
+        {"sah_cost", {
+            {"current", stats.sah_cost},
+            {"at_build", stats.build_sah_cost},
+            {"before_treelet_optimization", stats.unoptimized_sah_cost}
+        }},
+        {"memory_bytes", {
+            {"total", stats.node_bytes + stats.wide_node_bytes + stats.index_bytes},
+            {"binary_nodes", stats.node_bytes},
+            {"wide_nodes", stats.wide_node_bytes},
+            {"primitive_indices", stats.index_bytes}
+        }},
+        {"sphere_sets", {
+            {"count", stats.sphere_set_count},
+            {"spheres", stats.sphere_set_spheres},
+            {"memory_bytes", stats.sphere_set_bytes}
+        }}
+    };
+}
+
+void to_json(nlohmann::json& json, const TraversalStats& stats) {
+    json = nlohmann::json{
+        {"rays", stats.ray_count},
+        {"hits", stats.hit_count},
+        {"nodes_visited", {
+            {"mean", stats.mean_nodes_visited},
+            {"p99", stats.p99_nodes_visited},
+            {"max", stats.max_nodes_visited}
+        }},
+        {"primitives_tested", {
+            {"mean", stats.mean_primitives_tested},
+            {"p99", stats.p99_primitives_tested},
+            {"max", stats.max_primitives_tested}
+        }}
+    };
+}
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,80 @@
+/**
+ * @file bvh_stats.h
+ * @brief Quality report of a built BVH
+ *
+ * Structural statistics come from walking the node arrays; traversal
+ * statistics come from tracing a set of sample rays with counting
+ * enabled. Both serialize to JSON so a scene's hierarchy can be tracked
+ * across asset revisions.
+ */
+
+#pragma once
+
+#include "bvh_accel.h"
+#include "../core/ray.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../external/json.hpp"
+
+namespace raytracer {
+namespace acceleration {
+
+struct BVHStats {
+    BVHBuildSettings settings;
+    bool loaded_from_cache = false;
+    double build_time_ms = 0.0;
+
+    size_t primitive_references = 0;           // Leaf entries; exceeds the primitive count with spatial splits
+    size_t node_count = 0;                      // Binary tree
+    size_t leaf_count = 0;
+    size_t wide_node_count = 0;                 // Nodes of the traversed wide or quantized layout, 0 for Binary
+    int max_depth = 0;
+    double mean_leaf_depth = 0.0;
+    std::vector<size_t> leaves_per_depth;       // Indexed by depth, root at 0
+    std::vector<size_t> leaves_per_size;        // Indexed by primitive count
+
+    float sah_cost = 0.0f;
+    float build_sah_cost = 0.0f;
+    float unoptimized_sah_cost = 0.0f;          // HighQuality mode only
+
+    size_t node_bytes = 0;                      // Binary nodes, always kept
+    size_t wide_node_bytes = 0;
+    size_t index_bytes = 0;                     // Primitive index array
+
+    size_t sphere_set_count = 0;                // Sphere sets among the primitives
+    size_t sphere_set_spheres = 0;
+    size_t sphere_set_bytes = 0;                // Their arrays and inner BVHs
+};
+
+struct TraversalStats {
+    size_t ray_count = 0;
+    size_t hit_count = 0;
+    double mean_nodes_visited = 0.0;
+    uint32_t p99_nodes_visited = 0;
+    uint32_t max_nodes_visited = 0;
+    double mean_primitives_tested = 0.0;
+    uint32_t p99_primitives_tested = 0;
+    uint32_t max_primitives_tested = 0;
+};
+
+/**
+ * @brief Walks the hierarchy and collects its shape, cost and size
+ */
+BVHStats compute_bvh_stats(const BVHAccel& bvh);
+
+/**
+ * @brief Traces sample rays through the layout used for rendering and
+ *        summarizes the work per ray
+ *
+ * @param bvh Hierarchy to trace
+ * @param rays Sample rays, e.g. random camera rays
+ */
+TraversalStats sample_traversal(const BVHAccel& bvh, const std::vector<core::Ray>& rays);
+
+void to_json(nlohmann::json& json, const BVHStats& stats);
+void to_json(nlohmann::json& json, const TraversalStats& stats);
+
+} // namespace acceleration
+} // namespace raytracer
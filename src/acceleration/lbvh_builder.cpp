@@ -0,0 +1,477 @@
+/**
+ * @file lbvh_builder.cpp
+ * @brief Implementation of the parallel Morton-code BVH builder
+ */
+
+#include "lbvh_builder.h"
+#include "bvh.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    // Above this many primitives 10 bits per axis produce too many duplicate codes
+    constexpr size_t k63BitThreshold = size_t(1) << 22;
+
+    // HLBVH refinement: aim for about this many Morton subtrees under the SAH top
+    constexpr size_t kTargetClusterCount = 1024;
+    constexpr size_t kMinClusterSize = 64;
+
+    // Child references of the radix tree: leaves carry this flag, internal nodes do not
+    constexpr uint32_t kLeafFlag = 0x80000000u;
+    constexpr uint32_t kInvalid = 0xFFFFFFFFu;
+
+    int max_threads() {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    int thread_index() {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+    int team_size() {
+#ifdef _OPENMP
+        return omp_get_num_threads();
+#else
+        return 1;
+#endif
+    }
+
+    int count_leading_zeros(uint32_t x) {
+        if (x == 0) return 32;
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clz(x);
+#elif defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse(&index, x);
+        return 31 - static_cast<int>(index);
+#else
+        int n = 0;
+        while (!(x & 0x80000000u)) { x <<= 1; n++; }
+        return n;
+#endif
+    }
+
+    int count_leading_zeros(uint64_t x) {
+        uint32_t high = static_cast<uint32_t>(x >> 32);
+        return high ? count_leading_zeros(high) : 32 + count_leading_zeros(static_cast<uint32_t>(x));
+    }
+
+    // Spread the low 10 bits of v so that two zero bits separate each bit
+    uint32_t expand_bits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    // Spread the low 21 bits of v so that two zero bits separate each bit
+    uint64_t expand_bits(uint64_t v) {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    template <typename Key>
+    struct MortonPrimitive {
+        Key code;
+        uint32_t index;
+    };
+
+    template <typename Key>
+    constexpr int bits_per_axis() {
+        return sizeof(Key) == 4 ? 10 : 21;
+    }
+
+    // Interleaved as ...x2y2z2 x1y1z1 x0y0z0, so bit b belongs to axis 2 - b % 3
+    template <typename Key>
+    Key morton_code(const Point3& normalized) {
+        const float scale = static_cast<float>((1u << bits_per_axis<Key>()) - 1);
+        Key code = 0;
+        for (int a = 0; a < 3; a++) {
+            float q = std::clamp(normalized[a] * scale, 0.0f, scale);
+            code |= expand_bits(static_cast<Key>(q)) << (2 - a);
+        }
+        return code;
+    }
+
+    /**
+     * @brief Stable LSD radix sort on 8-bit digits with per-thread histograms
+     */
+    template <typename Key>
+    void radix_sort(std::vector<MortonPrimitive<Key>>& items) {
+        constexpr int kDigitBits = 8;
+        constexpr int kBuckets = 1 << kDigitBits;
+        constexpr int kPasses = (3 * bits_per_axis<Key>() + kDigitBits - 1) / kDigitBits;
+
+        const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(items.size());
+        std::vector<MortonPrimitive<Key>> scratch(items.size());
+        std::vector<size_t> histograms(static_cast<size_t>(max_threads()) * kBuckets);
+
+        for (int pass = 0; pass < kPasses; pass++) {
+            const int shift = pass * kDigitBits;
+            std::fill(histograms.begin(), histograms.end(), 0);
+
+            #pragma omp parallel
+            {
+                const int t = thread_index();
+                const int threads = team_size();
+                const std::ptrdiff_t begin = n * t / threads;
+                const std::ptrdiff_t end = n * (t + 1) / threads;
+                size_t* histogram = &histograms[static_cast<size_t>(t) * kBuckets];
+
+                for (std::ptrdiff_t i = begin; i < end; i++) {
+                    histogram[(items[i].code >> shift) & (kBuckets - 1)]++;
+                }
+
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    // Digit-major, thread-minor offsets keep the sort stable
+                    size_t offset = 0;
+                    for (int digit = 0; digit < kBuckets; digit++) {
+                        for (int u = 0; u < threads; u++) {
+                            size_t count = histograms[static_cast<size_t>(u) * kBuckets + digit];
+                            histograms[static_cast<size_t>(u) * kBuckets + digit] = offset;
+                            offset += count;
+                        }
+                    }
+                }
+
+                for (std::ptrdiff_t i = begin; i < end; i++) {
+                    scratch[histogram[(items[i].code >> shift) & (kBuckets - 1)]++] = items[i];
+                }
+            }
+
+            items.swap(scratch);
+        }
+    }
+
+    struct RadixNode {
+        uint32_t left;
+        uint32_t right;
+        uint32_t first;
+        uint32_t last;
+        uint8_t axis;
+    };
+
+    /**
+     * @brief Binary radix tree over sorted Morton codes, flattened into LinearBVH nodes
+     */
+    class RadixTree {
+    public:
+        RadixTree(const std::vector<AABB>& primitive_bounds, std::vector<uint32_t> sorted_indices,
+                  std::vector<RadixNode> nodes, std::vector<AABB> boxes)
+            : primitive_bounds_(primitive_bounds), sorted_(std::move(sorted_indices)),
+              nodes_(std::move(nodes)), boxes_(std::move(boxes)) {}
+
+        LinearBVH flatten(bool refine_upper_levels) {
+            uint32_t root = nodes_.empty() ? (0 | kLeafFlag) : 0;
+            output_.reserve(2 * sorted_.size());
+
+            std::vector<uint32_t> clusters;
+            if (refine_upper_levels) {
+                size_t threshold = std::max(kMinClusterSize, sorted_.size() / kTargetClusterCount);
+                collect_clusters(root, threshold, clusters);
+            }
+
+            if (clusters.size() > 1) {
+                std::vector<BVHPrimitiveInfo> infos(clusters.size());
+                for (size_t i = 0; i < clusters.size(); i++) {
+                    AABB box = bounds_of(clusters[i]);
+                    infos[i] = {i, box, box.centroid()};
+                }
+                BVHNode upper(infos, 0, infos.size(), nullptr, 1);
+                emit_upper(upper, infos, clusters, 0);
+            } else {
+                emit(root, 0);
+            }
+
+            return LinearBVH(std::move(output_), std::move(sorted_));
+        }
+
+    private:
+        const std::vector<AABB>& primitive_bounds_;
+        std::vector<uint32_t> sorted_;
+        std::vector<RadixNode> nodes_;
+        std::vector<AABB> boxes_;
+        std::vector<LinearBVHNode> output_;
+
+        AABB bounds_of(uint32_t ref) const {
+            if (ref & kLeafFlag) {
+                return primitive_bounds_[sorted_[ref & ~kLeafFlag]];
+            }
+            return boxes_[ref];
+        }
+
+        uint32_t push(const AABB& box, uint32_t offset, uint32_t count, int axis) {
+            LinearBVHNode node{};
+            node.set_bounds(box);
+            node.primitives_offset = offset;
+            node.primitive_count = static_cast<uint16_t>(count);
+            node.axis = static_cast<uint8_t>(axis);
+            output_.push_back(node);
+            return static_cast<uint32_t>(output_.size() - 1);
+        }
+
+        void collect_clusters(uint32_t ref, size_t threshold, std::vector<uint32_t>& clusters) const {
+            if ((ref & kLeafFlag) || nodes_[ref].last - nodes_[ref].first + 1 <= threshold) {
+                clusters.push_back(ref);
+                return;
+            }
+            collect_clusters(nodes_[ref].left, threshold, clusters);
+            collect_clusters(nodes_[ref].right, threshold, clusters);
+        }
+
+        void emit_upper(const BVHNode& node, const std::vector<BVHPrimitiveInfo>& infos,
+                        const std::vector<uint32_t>& clusters, int depth) {
+            if (node.is_leaf()) {
+                emit(clusters[infos[node.first_primitive()].index], depth);
+                return;
+            }
+            uint32_t index = push(node.box(), 0, 0, node.split_axis());
+            emit_upper(*node.left(), infos, clusters, depth + 1);
+            uint32_t second = static_cast<uint32_t>(output_.size());
+            emit_upper(*node.right(), infos, clusters, depth + 1);
+            output_[index].second_child_offset = second;
+        }
+
+        void emit(uint32_t ref, int depth) {
+            if (ref & kLeafFlag) {
+                push(bounds_of(ref), ref & ~kLeafFlag, 1, 0);
+                return;
+            }
+
+            const RadixNode& node = nodes_[ref];
+            uint32_t count = node.last - node.first + 1;
+            if (count <= BVHNode::kMaxLeafSize) {
+                push(boxes_[ref], node.first, count, node.axis);
+                return;
+            }
+
+            // Degenerate code distributions can nest deeply; finish those
+            // subtrees balanced so the result fits the traversal stack
+            if (depth >= BVHNode::kMedianSplitDepth) {
+                emit_range(node.first, count);
+                return;
+            }
+
+            uint32_t index = push(boxes_[ref], 0, 0, node.axis);
+            emit(node.left, depth + 1);
+            uint32_t second = static_cast<uint32_t>(output_.size());
+            emit(node.right, depth + 1);
+            output_[index].second_child_offset = second;
+        }
+
+        void emit_range(uint32_t first, uint32_t count) {
+            AABB box;
+            for (uint32_t i = first; i < first + count; i++) {
+                box.expand(primitive_bounds_[sorted_[i]]);
+            }
+            if (count <= BVHNode::kMaxLeafSize) {
+                push(box, first, count, 0);
+                return;
+            }
+
+            uint32_t half = count / 2;
+            uint32_t index = push(box, 0, 0, box.longest_axis());
+            emit_range(first, half);
+            uint32_t second = static_cast<uint32_t>(output_.size());
+            emit_range(first + half, count - half);
+            output_[index].second_child_offset = second;
+        }
+    };
+
+    template <typename Key>
+    LinearBVH build_with_keys(const std::vector<AABB>& primitive_bounds, const AABB& centroid_bounds,
+                              bool refine_upper_levels) {
+        const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(primitive_bounds.size());
+        const Vec3 extent = centroid_bounds.extent();
+        const Vec3 inv_extent(extent.x > 0 ? 1.0f / extent.x : 0.0f,
+                              extent.y > 0 ? 1.0f / extent.y : 0.0f,
+                              extent.z > 0 ? 1.0f / extent.z : 0.0f);
+
+        std::vector<MortonPrimitive<Key>> morton(primitive_bounds.size());
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < n; i++) {
+            Point3 normalized = (primitive_bounds[i].centroid() - centroid_bounds.min()) * inv_extent;
+            morton[i] = {morton_code<Key>(normalized), static_cast<uint32_t>(i)};
+        }
+
+        radix_sort(morton);
+
+        std::vector<uint32_t> sorted(primitive_bounds.size());
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < n; i++) {
+            sorted[i] = morton[i].index;
+        }
+
+        if (n == 1) {
+            return RadixTree(primitive_bounds, std::move(sorted), {}, {}).flatten(false);
+        }
+
+        // Length of the common prefix of keys i and j; equal keys fall back
+        // to comparing indices so every key is unique
+        auto delta = [&](std::ptrdiff_t i, std::ptrdiff_t j) -> int {
+            if (j < 0 || j >= n) {
+                return -1;
+            }
+            Key a = morton[i].code;
+            Key b = morton[j].code;
+            if (a == b) {
+                return static_cast<int>(sizeof(Key) * 8) +
+                       count_leading_zeros(static_cast<uint32_t>(i ^ j));
+            }
+            return count_leading_zeros(static_cast<Key>(a ^ b));
+        };
+
+        // Every internal node of the radix tree is independent (Karras 2012)
+        const std::ptrdiff_t internal_count = n - 1;
+        std::vector<RadixNode> nodes(static_cast<size_t>(internal_count));
+        std::vector<uint32_t> internal_parent(static_cast<size_t>(internal_count), kInvalid);
+        std::vector<uint32_t> leaf_parent(static_cast<size_t>(n), kInvalid);
+
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < internal_count; i++) {
+            // Direction of the range and the prefix length it must exceed
+            int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+            int delta_min = delta(i, i - d);
+
+            // Upper bound for the range length, then binary search for the end
+            std::ptrdiff_t max_length = 2;
+            while (delta(i, i + max_length * d) > delta_min) {
+                max_length *= 2;
+            }
+            std::ptrdiff_t length = 0;
+            for (std::ptrdiff_t t = max_length / 2; t >= 1; t /= 2) {
+                if (delta(i, i + (length + t) * d) > delta_min) {
+                    length += t;
+                }
+            }
+            std::ptrdiff_t j = i + length * d;
+
+            // Binary search for the split position inside the range
+            int delta_node = delta(i, j);
+            std::ptrdiff_t split = 0;
+            std::ptrdiff_t divisor = 2;
+            for (std::ptrdiff_t t = (length + divisor - 1) / divisor; t >= 1; t = (length + divisor - 1) / divisor) {
+                if (delta(i, i + (split + t) * d) > delta_node) {
+                    split += t;
+                }
+                if (t == 1) {
+                    break;
+                }
+                divisor *= 2;
+            }
+            std::ptrdiff_t gamma = i + split * d + std::min(d, 0);
+
+            RadixNode& node = nodes[i];
+            node.first = static_cast<uint32_t>(std::min(i, j));
+            node.last = static_cast<uint32_t>(std::max(i, j));
+
+            if (static_cast<std::ptrdiff_t>(node.first) == gamma) {
+                node.left = static_cast<uint32_t>(gamma) | kLeafFlag;
+                leaf_parent[gamma] = static_cast<uint32_t>(i);
+            } else {
+                node.left = static_cast<uint32_t>(gamma);
+                internal_parent[gamma] = static_cast<uint32_t>(i);
+            }
+            if (static_cast<std::ptrdiff_t>(node.last) == gamma + 1) {
+                node.right = static_cast<uint32_t>(gamma + 1) | kLeafFlag;
+                leaf_parent[gamma + 1] = static_cast<uint32_t>(i);
+            } else {
+                node.right = static_cast<uint32_t>(gamma + 1);
+                internal_parent[gamma + 1] = static_cast<uint32_t>(i);
+            }
+
+            // The split happens on the highest bit that differs across the range
+            Key differing = morton[node.first].code ^ morton[node.last].code;
+            int bit = differing ? static_cast<int>(sizeof(Key) * 8) - 1 - count_leading_zeros(differing) : 0;
+            node.axis = static_cast<uint8_t>(2 - bit % 3);
+        }
+
+        // Bottom-up bounds: the second child to arrive at a node computes its box
+        std::vector<AABB> boxes(static_cast<size_t>(internal_count));
+        std::unique_ptr<std::atomic<uint32_t>[]> arrivals(new std::atomic<uint32_t>[internal_count]);
+        for (std::ptrdiff_t i = 0; i < internal_count; i++) {
+            arrivals[i].store(0, std::memory_order_relaxed);
+        }
+
+        auto child_box = [&](uint32_t ref) -> AABB {
+            return (ref & kLeafFlag) ? primitive_bounds[sorted[ref & ~kLeafFlag]] : boxes[ref];
+        };
+
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < n; i++) {
+            uint32_t node = leaf_parent[i];
+            while (node != kInvalid) {
+                if (arrivals[node].fetch_add(1, std::memory_order_acq_rel) == 0) {
+                    break;
+                }
+                boxes[node] = surrounding_box(child_box(nodes[node].left), child_box(nodes[node].right));
+                node = internal_parent[node];
+            }
+        }
+
+        return RadixTree(primitive_bounds, std::move(sorted), std::move(nodes), std::move(boxes))
+            .flatten(refine_upper_levels);
+    }
+}
+
+LinearBVH build_lbvh(const std::vector<AABB>& primitive_bounds, bool refine_upper_levels) {
+    if (primitive_bounds.empty()) {
+        return LinearBVH();
+    }
+
+    // Parallel reduction of the centroid bounds with one partial box per thread
+    const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(primitive_bounds.size());
+    std::vector<AABB> partial(static_cast<size_t>(max_threads()));
+    #pragma omp parallel
+    {
+        AABB local;
+        #pragma omp for
+        for (std::ptrdiff_t i = 0; i < n; i++) {
+            local.expand(primitive_bounds[i].centroid());
+        }
+        partial[thread_index()] = local;
+    }
+
+    AABB centroid_bounds;
+    for (const auto& box : partial) {
+        centroid_bounds.expand(box);
+    }
+
+    if (primitive_bounds.size() > k63BitThreshold) {
+        return build_with_keys<uint64_t>(primitive_bounds, centroid_bounds, refine_upper_levels);
+    }
+    return build_with_keys<uint32_t>(primitive_bounds, centroid_bounds, refine_upper_levels);
+}
+
+} // namespace acceleration
+} // namespace raytracer
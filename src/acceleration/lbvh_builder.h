@@ -0,0 +1,34 @@
+/**
+ * @file lbvh_builder.h
+ * @brief Parallel Morton-code BVH construction (LBVH / HLBVH)
+ *
+ * Primitive centroids are quantized to Morton codes, radix-sorted in
+ * parallel, and the binary radix tree over the sorted codes is emitted
+ * with every internal node computed independently (Karras 2012). The
+ * result trades some traversal quality for a build that scales with the
+ * number of cores, which is what large scenes need at load time.
+ */
+
+#pragma once
+
+#include "aabb.h"
+#include "linear_bvh.h"
+#include <vector>
+
+namespace raytracer {
+namespace acceleration {
+
+/**
+ * @brief Builds a linear BVH from Morton codes of primitive centroids
+ *
+ * Uses 30-bit codes for up to 4M primitives and 63-bit codes above that.
+ *
+ * @param primitive_bounds Bounding box of every primitive, indexed by primitive id
+ * @param refine_upper_levels Rebuild the top of the hierarchy with binned SAH
+ *                            over small Morton subtrees (HLBVH)
+ * @return Hierarchy in the same format as the SAH builder produces
+ */
+LinearBVH build_lbvh(const std::vector<AABB>& primitive_bounds, bool refine_upper_levels);
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,193 @@
+/**
+ * @file linear_bvh.cpp
+ * @brief Construction and flattening of the linear BVH
+ */
+
+#include "linear_bvh.h"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    size_t count_nodes(const BVHNode& node) {
+        if (node.is_leaf()) {
+            return 1;
+        }
+        return 1 + count_nodes(*node.left()) + count_nodes(*node.right());
+    }
+}
+
+LinearBVH::LinearBVH(const std::vector<AABB>& primitive_bounds, size_t leaf_group_width) {
+    if (primitive_bounds.empty()) {
+        return;
+    }
+
+    std::vector<BVHPrimitiveInfo> infos(primitive_bounds.size());
+    for (size_t i = 0; i < primitive_bounds.size(); ++i) {
+        infos[i] = {i, primitive_bounds[i], primitive_bounds[i].centroid()};
+    }
+
+    BVHNode root(infos, 0, infos.size(), nullptr, std::max(BVHNode::kMaxLeafSize, leaf_group_width),
+                 leaf_group_width);
+    *this = LinearBVH(root, infos);
+}
+
+LinearBVH::LinearBVH(const BVHNode& root, const std::vector<BVHPrimitiveInfo>& infos) {
+    std::vector<uint32_t> primitive_indices;
+    primitive_indices.reserve(infos.size());
+    for (const auto& info : infos) {
+        primitive_indices.push_back(static_cast<uint32_t>(info.index));
+    }
+    primitive_indices_ = std::move(primitive_indices);
+
+    std::vector<LinearBVHNode> nodes;
+    nodes.reserve(count_nodes(root));
+    flatten(root, nodes);
+    nodes_ = std::move(nodes);
+}
+
+uint32_t LinearBVH::flatten(const BVHNode& node, std::vector<LinearBVHNode>& nodes) {
+    uint32_t offset = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    AABB box = node.box();
+    LinearBVHNode flat{};
+    flat.set_bounds(box);
+    flat.axis = static_cast<uint8_t>(node.split_axis());
+
+    if (node.is_leaf()) {
+        flat.primitives_offset = static_cast<uint32_t>(node.first_primitive());
+        flat.primitive_count = static_cast<uint16_t>(node.primitive_count());
+    } else {
+        flatten(*node.left(), nodes);
+        flat.second_child_offset = flatten(*node.right(), nodes);
+        flat.primitive_count = 0;
+    }
+
+    nodes[offset] = flat;
+    return offset;
+}
+
+void LinearBVH::refit(const std::vector<AABB>& leaf_bounds) {
+    if (nodes_.empty()) {
+        return;
+    }
+    if (refit_subtrees_.empty()) {
+        build_refit_order();
+    }
+
+    // Children follow their parent in the array, so a reverse sweep over
+    // a contiguous subtree range updates it bottom-up with good locality.
+    // A tree mapped from a cache file is copied out on this first write.
+    LinearBVHNode* nodes = nodes_.mutable_data();
+    auto refit_node = [&](uint32_t index) {
+        LinearBVHNode& node = nodes[index];
+        if (node.is_leaf()) {
+            AABB box;
+            for (uint32_t k = node.primitives_offset; k < node.primitives_offset + node.primitive_count; k++) {
+                box.expand(leaf_bounds[k]);
+            }
+            node.set_bounds(box);
+            return;
+        }
+        const LinearBVHNode& first = nodes[index + 1];
+        const LinearBVHNode& second = nodes[node.second_child_offset];
+        for (int a = 0; a < 3; a++) {
+            node.bounds_min[a] = std::min(first.bounds_min[a], second.bounds_min[a]);
+            node.bounds_max[a] = std::max(first.bounds_max[a], second.bounds_max[a]);
+        }
+    };
+
+    const std::ptrdiff_t subtree_count = static_cast<std::ptrdiff_t>(refit_subtrees_.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (std::ptrdiff_t s = 0; s < subtree_count; s++) {
+        for (uint32_t index = refit_subtrees_[s].end; index-- > refit_subtrees_[s].root;) {
+            refit_node(index);
+        }
+    }
+
+    // The few nodes above the subtrees, in reverse order
+    for (uint32_t index : refit_top_) {
+        refit_node(index);
+    }
+}
+
+float LinearBVH::sah_cost() const {
+    if (nodes_.empty()) {
+        return 0.0f;
+    }
+
+    float root_area = nodes_[0].bounds().surface_area();
+    if (root_area <= 0.0f) {
+        return 0.0f;
+    }
+
+    float cost = 0.0f;
+    for (const auto& node : nodes_) {
+        float weight = node.bounds().surface_area() / root_area;
+        cost += weight * (node.is_leaf() ? static_cast<float>(node.primitive_count) : BVHNode::kTraversalCost);
+    }
+    return cost;
+}
+
+bool LinearBVH::valid(uint64_t primitive_count) const {
+    for (uint32_t index : primitive_indices_) {
+        if (index >= primitive_count) {
+            return false;
+        }
+    }
+
+    // Parents always precede their children, so one forward pass sees
+    // every node's depth before its children need it
+    const size_t count = nodes_.size();
+    std::vector<uint8_t> depth(count, 0);
+    for (size_t index = 0; index < count; ++index) {
+        const LinearBVHNode& node = nodes_[index];
+        if (node.is_leaf()) {
+            if (node.primitive_count > kMaxWideLeafSize ||
+                uint64_t(node.primitives_offset) + node.primitive_count > primitive_indices_.size()) {
+                return false;
+            }
+            continue;
+        }
+        const uint32_t second = node.second_child_offset;
+        if (index + 1 >= count || second <= index + 1 || second >= count || depth[index] + 1 >= kStackSize) {
+            return false;
+        }
+        const uint8_t child_depth = static_cast<uint8_t>(depth[index] + 1);
+        depth[index + 1] = std::max(depth[index + 1], child_depth);
+        depth[second] = std::max(depth[second], child_depth);
+    }
+    return true;
+}
+
+void LinearBVH::build_refit_order() {
+    // Subtree end (one past its last node) for every node, from the back
+    std::vector<uint32_t> subtree_end(nodes_.size());
+    for (uint32_t i = static_cast<uint32_t>(nodes_.size()); i-- > 0;) {
+        subtree_end[i] = nodes_[i].is_leaf() ? i + 1 : subtree_end[nodes_[i].second_child_offset];
+    }
+
+    // Nodes at the split depth (or leaves above it) become independent
+    // refit tasks; the interior nodes above them are refit afterwards
+    std::vector<std::pair<uint32_t, int>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto [index, depth] = stack.back();
+        stack.pop_back();
+        if (nodes_[index].is_leaf() || depth == kRefitSubtreeDepth) {
+            refit_subtrees_.push_back({index, subtree_end[index]});
+        } else {
+            refit_top_.push_back(index);
+            stack.push_back({index + 1, depth + 1});
+            stack.push_back({nodes_[index].second_child_offset, depth + 1});
+        }
+    }
+    std::sort(refit_top_.begin(), refit_top_.end(), std::greater<uint32_t>());
+}
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,415 @@
+/**
+ * @file linear_bvh.h
+ * @brief Flattened, pointer-free BVH used on the traversal hot path
+ *
+ * The binary tree produced by BVHNode is only a build artifact. It is
+ * flattened into a depth-first array of 32-byte nodes: the first child
+ * of an interior node immediately follows it, the second child is
+ * referenced by index, and leaves reference a range of primitive indices.
+ */
+
+#pragma once
+
+#include "../common.h"
+#include "../core/ray.h"
+#include "../core/ray_packet.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "node_array.h"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace raytracer {
+namespace acceleration {
+
+struct alignas(32) LinearBVHNode {
+    float bounds_min[3];
+    union {
+        uint32_t primitives_offset;    // Leaf: first entry in the primitive index array
+        uint32_t second_child_offset;  // Interior: index of the second child
+    };
+    float bounds_max[3];
+    uint16_t primitive_count;          // 0 for interior nodes
+    uint8_t axis;                      // Split axis, used for front-to-back ordering
+    uint8_t pad;
+
+    bool is_leaf() const { return primitive_count > 0; }
+    AABB bounds() const {
+        return AABB(Point3(bounds_min[0], bounds_min[1], bounds_min[2]),
+                    Point3(bounds_max[0], bounds_max[1], bounds_max[2]));
+    }
+    void set_bounds(const AABB& box) {
+        for (int a = 0; a < 3; a++) {
+            bounds_min[a] = box.min()[a];
+            bounds_max[a] = box.max()[a];
+        }
+    }
+};
+
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode must stay 32 bytes");
+
+/**
+ * @brief Default node counter of the traversals; compiles away
+ */
+struct IgnoreNodeVisits {
+    void operator()() const {}
+};
+
+class LinearBVH {
+public:
+    // Traversal stack depth; BVHNode bounds tree depth well below this
+    static constexpr int kStackSize = 64;
+
+    // Largest leaf the wide and quantized layouts can address with their 8-bit counts
+    static constexpr uint16_t kMaxWideLeafSize = std::numeric_limits<uint8_t>::max();
+
+    LinearBVH() = default;
+
+    /**
+     * @brief Builds a BVH over a set of primitive bounds
+     *
+     * @param primitive_bounds Bounding box of every primitive, indexed by primitive id
+     * @param leaf_group_width Primitives the owner tests at once (see BVHNode)
+     */
+    explicit LinearBVH(const std::vector<AABB>& primitive_bounds, size_t leaf_group_width = 1);
+
+    /**
+     * @brief Flattens an existing build tree
+     *
+     * @param root Root of a tree built over infos
+     * @param infos Primitive infos in the leaf order produced by the build
+     */
+    LinearBVH(const BVHNode& root, const std::vector<BVHPrimitiveInfo>& infos);
+
+    /**
+     * @brief Adopts nodes emitted by another builder or mapped from a cache file
+     *
+     * @param nodes Depth-first node array
+     * @param primitive_indices Primitive ids in leaf order
+     */
+    LinearBVH(NodeArray<LinearBVHNode> nodes, NodeArray<uint32_t> primitive_indices)
+        : nodes_(std::move(nodes)), primitive_indices_(std::move(primitive_indices)) {}
+
+    bool empty() const { return nodes_.empty(); }
+    AABB bounds() const { return empty() ? AABB() : nodes_[0].bounds(); }
+
+    const NodeArray<LinearBVHNode>& nodes() const { return nodes_; }
+
+    /**
+     * @brief Primitive ids in leaf order; leaf ranges index into this array
+     *
+     * Owners typically reorder their primitive storage by this permutation
+     * so that leaf ranges address their data directly.
+     */
+    const NodeArray<uint32_t>& primitive_indices() const { return primitive_indices_; }
+
+    /**
+     * @brief Recomputes all node bounds bottom-up for moved primitives
+     *
+     * The topology is kept, so the tree stays valid but loses quality as
+     * primitives drift from where they were at build time; compare
+     * sah_cost() against its build-time value to decide when to rebuild.
+     * Leaves of spatial-split trees go back to unclipped primitive bounds.
+     *
+     * @param leaf_bounds New bounding box for every entry of primitive_indices(),
+     *                    in the same order
+     */
+    void refit(const std::vector<AABB>& leaf_bounds);
+
+    /**
+     * @brief Expected cost of tracing a random ray under the SAH model,
+     *        in units of primitive intersections
+     */
+    float sah_cost() const;
+
+    /**
+     * @brief Checks that the tree can be traversed without leaving its arrays
+     *
+     * Children must follow their parent within the node array, the depth
+     * must fit the traversal stack, leaf ranges must lie within the index
+     * array and hold at most kMaxWideLeafSize entries, and every index must
+     * name one of the owner's primitives.
+     * Meant for trees read from files.
+     *
+     * @param primitive_count Number of primitives the indices address
+     */
+    bool valid(uint64_t primitive_count) const;
+
+    /**
+     * @brief Finds the closest hit by iterating the node array with a fixed stack
+     *
+     * Children are visited nearest-first using the sign of the ray direction
+     * along the node's split axis.
+     *
+     * @param ray Ray to trace
+     * @param t_min Minimum hit distance
+     * @param t_max Maximum hit distance; shrinks to the closest hit found
+     * @param intersect_leaf Callable (first, count, t_min, t_max&) -> bool that tests
+     *                       a leaf's primitives and shrinks t_max on a hit
+     * @param count_node Callable invoked for every node whose bounds are tested
+     * @return True if any leaf reported a hit
+     */
+    template <typename LeafIntersector, typename NodeCounter = IgnoreNodeVisits>
+    bool intersect(const core::Ray& ray, float t_min, float& t_max, LeafIntersector&& intersect_leaf,
+                   NodeCounter&& count_node = NodeCounter()) const;
+
+    /**
+     * @brief Any-hit traversal: stops at the first leaf that reports a hit
+     *
+     * Children are still visited nearest-first, which tends to reach an
+     * occluder sooner, but the interval never shrinks.
+     *
+     * @param occluded_leaf Callable (first, count, t_min, t_max) -> bool that
+     *                      reports whether any primitive of a leaf is hit
+     * @param count_node Callable invoked for every node whose bounds are tested
+     */
+    template <typename LeafOcclusion, typename NodeCounter = IgnoreNodeVisits>
+    bool occluded(const core::Ray& ray, float t_min, float t_max, LeafOcclusion&& occluded_leaf,
+                  NodeCounter&& count_node = NodeCounter()) const;
+
+    /**
+     * @brief Finds the closest hit of every ray in a coherent packet
+     *
+     * Each node is first culled for the whole packet with interval
+     * arithmetic over the rays' inverse directions; if that passes, rays
+     * are slab-tested individually until one hits, and only that ray and
+     * the ones after it descend. Children are visited nearest-first using
+     * the packet's common direction signs.
+     *
+     * @param packet Rays to trace; must satisfy RayPacket::is_coherent()
+     * @param t_min Minimum hit distance for all rays
+     * @param t_max Per-ray maximum hit distance; each shrinks to its closest hit
+     * @param intersect_leaf Callable (ray, first, count, t_min, t_max&) -> bool that
+     *                       tests one ray against a leaf's primitives
+     */
+    template <typename LeafIntersector>
+    void intersect_packet(const core::RayPacket& packet, float t_min, float* t_max,
+                          LeafIntersector&& intersect_leaf) const;
+
+private:
+    NodeArray<LinearBVHNode> nodes_;
+    NodeArray<uint32_t> primitive_indices_;
+
+    // Refit schedule, built on the first refit: contiguous subtrees that
+    // are refit in parallel, then the interior nodes above them
+    static constexpr int kRefitSubtreeDepth = 8;
+    struct RefitRange {
+        uint32_t root;
+        uint32_t end;
+    };
+    std::vector<RefitRange> refit_subtrees_;
+    std::vector<uint32_t> refit_top_;
+
+    uint32_t flatten(const BVHNode& node, std::vector<LinearBVHNode>& nodes);
+    void build_refit_order();
+};
+
+/**
+ * @brief Ordered slab test of a flattened node
+ *
+ * The ray's direction signs pick each axis' near and far plane, so the
+ * test needs no swaps or branches and rejects inverted (empty) boxes. Exits
+ * are widened by kFarPlaneScale like the wide layouts'.
+ */
+inline bool hit_node_bounds(const LinearBVHNode& node, const core::Ray& ray, float t_min, float t_max) {
+    const Point3& origin = ray.origin();
+    const Vec3& inv_direction = ray.inv_direction();
+    for (int a = 0; a < 3; a++) {
+        // Selects rather than indexed loads, so they compile to blends
+        const bool negative = ray.sign(a);
+        float near_plane = negative ? node.bounds_max[a] : node.bounds_min[a];
+        float far_plane = negative ? node.bounds_min[a] : node.bounds_max[a];
+        t_min = std::max(t_min, (near_plane - origin[a]) * inv_direction[a]);
+        t_max = std::min(t_max, (far_plane - origin[a]) * inv_direction[a] * kFarPlaneScale);
+    }
+    return t_min <= t_max;
+}
+
+template <typename LeafIntersector, typename NodeCounter>
+bool LinearBVH::intersect(const core::Ray& ray, float t_min, float& t_max, LeafIntersector&& intersect_leaf,
+                          NodeCounter&& count_node) const {
+    if (nodes_.empty()) {
+        return false;
+    }
+
+    const LinearBVHNode* nodes = nodes_.data();
+    uint32_t stack[kStackSize];
+    int stack_size = 0;
+    uint32_t current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+        const LinearBVHNode& node = nodes[current];
+        count_node();
+        if (hit_node_bounds(node, ray, t_min, t_max)) {
+            if (node.is_leaf()) {
+                if (intersect_leaf(node.primitives_offset, node.primitive_count, t_min, t_max)) {
+                    hit_anything = true;
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else if (ray.sign(node.axis)) {
+                stack[stack_size++] = current + 1;
+                current = node.second_child_offset;
+            } else {
+                stack[stack_size++] = node.second_child_offset;
+                current = current + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    return hit_anything;
+}
+
+template <typename LeafIntersector>
+void LinearBVH::intersect_packet(const core::RayPacket& packet, float t_min, float* t_max,
+                                 LeafIntersector&& intersect_leaf) const {
+    const int count = packet.size;
+    if (nodes_.empty() || count == 0) {
+        return;
+    }
+
+    // Shared origin, per-ray inverse directions and their range per axis
+    const Point3 origin = packet.rays[0].origin();
+    float inv_direction[3][core::RayPacket::kMaxSize];
+    float inv_low[3];
+    float inv_high[3];
+    for (int a = 0; a < 3; a++) {
+        inv_low[a] = std::numeric_limits<float>::infinity();
+        inv_high[a] = -std::numeric_limits<float>::infinity();
+        for (int i = 0; i < count; i++) {
+            inv_direction[a][i] = packet.rays[i].inv_direction()[a];
+            inv_low[a] = std::min(inv_low[a], inv_direction[a][i]);
+            inv_high[a] = std::max(inv_high[a], inv_direction[a][i]);
+        }
+    }
+    const core::Ray& lead = packet.rays[0];
+
+    float packet_t_max = 0.0f;
+    for (int i = 0; i < count; i++) {
+        packet_t_max = std::max(packet_t_max, t_max[i]);
+    }
+
+    // Index of the first ray at or after first_active that hits the node, or count
+    const LinearBVHNode* nodes = nodes_.data();
+    auto first_hit = [&](const LinearBVHNode& node, int first_active) {
+        const float* planes[2] = {node.bounds_min, node.bounds_max};
+        float near_offset[3];
+        float far_offset[3];
+        float entry = t_min;
+        float exit = packet_t_max;
+        for (int a = 0; a < 3; a++) {
+            near_offset[a] = planes[lead.sign(a)][a] - origin[a];
+            far_offset[a] = planes[1 - lead.sign(a)][a] - origin[a];
+            entry = std::max(entry, std::min(near_offset[a] * inv_low[a], near_offset[a] * inv_high[a]));
+            exit = std::min(exit, std::max(far_offset[a] * inv_low[a], far_offset[a] * inv_high[a]) *
+                                      kFarPlaneScale);
+        }
+        if (entry > exit) {
+            return count;
+        }
+
+        for (int i = first_active; i < count; i++) {
+            float ray_entry = t_min;
+            float ray_exit = t_max[i];
+            for (int a = 0; a < 3; a++) {
+                ray_entry = std::max(ray_entry, near_offset[a] * inv_direction[a][i]);
+                ray_exit = std::min(ray_exit, far_offset[a] * inv_direction[a][i] * kFarPlaneScale);
+            }
+            if (ray_entry <= ray_exit) {
+                return i;
+            }
+        }
+        return count;
+    };
+
+    struct StackEntry {
+        uint32_t node;
+        int first_active;
+    };
+    StackEntry stack[kStackSize];
+    int stack_size = 0;
+    uint32_t current = 0;
+    int first_active = 0;
+
+    while (true) {
+        const LinearBVHNode& node = nodes[current];
+        int first = first_hit(node, first_active);
+        if (first < count) {
+            if (node.is_leaf()) {
+                // Rays after the first were not tested yet; the leaf
+                // callback sees only the ones whose slab test passes
+                for (int i = first; i < count; i++) {
+                    if (i > first && !hit_node_bounds(node, packet.rays[i], t_min, t_max[i])) {
+                        continue;
+                    }
+                    intersect_leaf(i, node.primitives_offset, node.primitive_count, t_min, t_max[i]);
+                }
+                packet_t_max = 0.0f;
+                for (int i = 0; i < count; i++) {
+                    packet_t_max = std::max(packet_t_max, t_max[i]);
+                }
+                if (stack_size == 0) break;
+                current = stack[stack_size - 1].node;
+                first_active = stack[--stack_size].first_active;
+            } else if (lead.sign(node.axis)) {
+                stack[stack_size++] = {current + 1, first};
+                current = node.second_child_offset;
+                first_active = first;
+            } else {
+                stack[stack_size++] = {node.second_child_offset, first};
+                current = current + 1;
+                first_active = first;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[stack_size - 1].node;
+            first_active = stack[--stack_size].first_active;
+        }
+    }
+}
+
+template <typename LeafOcclusion, typename NodeCounter>
+bool LinearBVH::occluded(const core::Ray& ray, float t_min, float t_max, LeafOcclusion&& occluded_leaf,
+                         NodeCounter&& count_node) const {
+    if (nodes_.empty()) {
+        return false;
+    }
+
+    const LinearBVHNode* nodes = nodes_.data();
+    uint32_t stack[kStackSize];
+    int stack_size = 0;
+    uint32_t current = 0;
+
+    while (true) {
+        const LinearBVHNode& node = nodes[current];
+        count_node();
+        if (hit_node_bounds(node, ray, t_min, t_max)) {
+            if (node.is_leaf()) {
+                if (occluded_leaf(node.primitives_offset, node.primitive_count, t_min, t_max)) {
+                    return true;
+                }
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else if (ray.sign(node.axis)) {
+                stack[stack_size++] = current + 1;
+                current = node.second_child_offset;
+            } else {
+                stack[stack_size++] = node.second_child_offset;
+                current = current + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    return false;
+}
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,73 @@
+/**
+ * @file node_array.h
+ * @brief Read-mostly array that owns its elements or views external memory
+ *
+ * BVH node and index arrays are normally built in memory, but a cached
+ * hierarchy is traversed straight out of a memory-mapped file. NodeArray
+ * lets both cases share one type: a view keeps the mapping alive through
+ * a shared owner and is copied into owned storage on the first write.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace raytracer {
+namespace acceleration {
+
+template <typename T>
+class NodeArray {
+public:
+    NodeArray() = default;
+
+    // Implicit so builders can hand over the vectors they filled
+    NodeArray(std::vector<T> elements) : owned_(std::move(elements)) {}
+
+    /**
+     * @brief Wraps memory owned elsewhere without copying it
+     *
+     * @param data First element; must stay valid while owner is alive
+     * @param size Number of elements
+     * @param owner Keeps the memory alive (e.g. a mapped file)
+     */
+    static NodeArray view(const T* data, size_t size, std::shared_ptr<const void> owner) {
+        NodeArray array;
+        array.view_ = data;
+        array.view_size_ = size;
+        array.owner_ = std::move(owner);
+        return array;
+    }
+
+    bool is_view() const { return view_ != nullptr; }
+    const T* data() const { return view_ ? view_ : owned_.data(); }
+    size_t size() const { return view_ ? view_size_ : owned_.size(); }
+    bool empty() const { return size() == 0; }
+
+    const T& operator[](size_t index) const { return data()[index]; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    /**
+     * @brief Writable access; detaches a view by copying it first
+     */
+    T* mutable_data() {
+        if (view_) {
+            owned_.assign(view_, view_ + view_size_);
+            view_ = nullptr;
+            view_size_ = 0;
+            owner_.reset();
+        }
+        return owned_.data();
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+    std::shared_ptr<const void> owner_;
+};
+
+} // namespace acceleration
+} // namespace raytracer
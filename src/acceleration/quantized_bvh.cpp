@@ -0,0 +1,114 @@
+/**
+ * @file quantized_bvh.cpp
+ * @brief Quantization of wide BVH nodes
+ */
+
+#include "quantized_bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    constexpr int kMinExponent = -126;
+    constexpr int kMaxExponent = 127;
+    constexpr int kGridMax = 255;
+
+    // Must match decode_child_bounds exactly
+    float decode(float origin, int q, float spacing) {
+        return origin + static_cast<float>(q) * spacing;
+    }
+
+    // Smallest exponent whose grid of 255 steps reaches the node's max plane
+    int grid_exponent(float origin, float max_plane) {
+        const float extent = max_plane - origin;
+        int exponent = kMinExponent;
+        if (extent > 0.0f) {
+            int binary_exponent;
+            std::frexp(extent / static_cast<float>(kGridMax), &binary_exponent);
+            exponent = std::clamp(binary_exponent, kMinExponent, kMaxExponent);
+        }
+        while (exponent < kMaxExponent && decode(origin, kGridMax, grid_spacing(exponent)) < max_plane) {
+            ++exponent;
+        }
+        return exponent;
+    }
+
+    template <int N>
+    QuantizedBVHNode<N> quantize(const WideBVHNode<N>& source) {
+        QuantizedBVHNode<N> node{};
+        // Leaf counts are copied as is; WideBVH already limited them to this width
+        static_assert(std::is_same_v<decltype(node.primitive_count), decltype(source.primitive_count)>,
+                      "quantized and wide leaf counts must share a type");
+        for (int i = 0; i < N; i++) {
+            node.child[i] = source.child[i];
+            node.primitive_count[i] = source.primitive_count[i];
+        }
+
+        for (int a = 0; a < 3; a++) {
+            float low = std::numeric_limits<float>::infinity();
+            float high = -std::numeric_limits<float>::infinity();
+            for (int i = 0; i < N; i++) {
+                if (source.bounds_min[a][i] <= source.bounds_max[a][i]) {
+                    low = std::min(low, source.bounds_min[a][i]);
+                    high = std::max(high, source.bounds_max[a][i]);
+                }
+            }
+            if (low > high) {
+                low = high = 0.0f;
+            }
+
+            const int exponent = grid_exponent(low, high);
+            const float spacing = grid_spacing(exponent);
+            node.origin[a] = low;
+            node.exponent[a] = static_cast<int8_t>(exponent);
+
+            for (int i = 0; i < N; i++) {
+                if (source.bounds_min[a][i] > source.bounds_max[a][i]) {
+                    // Inverted like the full-precision empty slots, rejected by the slab test
+                    node.child_min[a][i] = kGridMax;
+                    node.child_max[a][i] = 0;
+                    continue;
+                }
+
+                // Round outward, then step further while the decoded plane still cuts into the box
+                const float scaled_min = (source.bounds_min[a][i] - low) / spacing;
+                const float scaled_max = (source.bounds_max[a][i] - low) / spacing;
+                int q_min = std::clamp(static_cast<int>(std::floor(scaled_min)), 0, kGridMax);
+                int q_max = std::clamp(static_cast<int>(std::ceil(scaled_max)), 0, kGridMax);
+                while (q_min > 0 && decode(low, q_min, spacing) > source.bounds_min[a][i]) {
+                    --q_min;
+                }
+                while (q_max < kGridMax && decode(low, q_max, spacing) < source.bounds_max[a][i]) {
+                    ++q_max;
+                }
+                node.child_min[a][i] = static_cast<uint8_t>(q_min);
+                node.child_max[a][i] = static_cast<uint8_t>(q_max);
+            }
+        }
+        return node;
+    }
+}
+
+template <int N>
+QuantizedBVH<N>::QuantizedBVH(const WideBVH<N>& wide) {
+    const auto& source = wide.nodes();
+    std::vector<QuantizedBVHNode<N>> nodes(source.size());
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(source.size());
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        nodes[i] = quantize(source[i]);
+    }
+    nodes_ = std::move(nodes);
+}
+
+template class QuantizedBVH<4>;
+template class QuantizedBVH<8>;
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,142 @@
+/**
+ * @file quantized_bvh.h
+ * @brief Wide BVH with child boxes quantized to 8 bits per plane
+ *
+ * Each node stores the minimum corner of its box and a power-of-two grid
+ * spacing per axis; child boxes are stored as 8-bit grid coordinates,
+ * rounded outward so the decoded box always encloses the exact one. That
+ * halves the node size of the full-precision wide layouts (64 instead of
+ * 128 bytes at N = 4, 128 instead of 256 at N = 8) for the cost of
+ * decoding child bounds during traversal. The looser boxes can admit a
+ * few extra node visits but never lose a hit.
+ */
+
+#pragma once
+
+#include "wide_bvh.h"
+#include <cstdint>
+#include <cstring>
+
+namespace raytracer {
+namespace acceleration {
+
+template <int N>
+struct alignas(32) QuantizedBVHNode {
+    float origin[3];                 // Grid origin: minimum corner of the node box
+    int8_t exponent[3];              // Grid spacing per axis is 2^exponent
+    uint8_t pad;
+    uint8_t child_min[3][N];         // [axis][child] in grid steps; empty slots hold an inverted box
+    uint8_t child_max[3][N];
+    uint32_t child[N];               // Interior: node index; leaf: first primitive
+    uint8_t primitive_count[N];      // 0 for interior children and empty slots
+
+    bool is_leaf(int i) const { return primitive_count[i] > 0; }
+    bool is_unused(int i) const {
+        return !is_leaf(i) && child_min[0][i] > child_max[0][i] && child_min[1][i] > child_max[1][i] &&
+               child_min[2][i] > child_max[2][i];
+    }
+};
+
+static_assert(sizeof(QuantizedBVHNode<4>) == 64, "4-wide quantized node must stay one cache line");
+static_assert(sizeof(QuantizedBVHNode<8>) == 128, "8-wide quantized node must stay two cache lines");
+
+/**
+ * @brief Grid spacing for an exponent, built directly from the float bits
+ *
+ * @param exponent Normal-range exponent in [-126, 127]
+ */
+inline float grid_spacing(int exponent) {
+    uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+    float spacing;
+    std::memcpy(&spacing, &bits, sizeof(spacing));
+    return spacing;
+}
+
+/**
+ * @brief Expands a node's child boxes to full precision
+ *
+ * Grid coordinates times a power of two are exact, so decoding rounds
+ * only once, in the add, and matches what the encoder checked against.
+ *
+ * @param bounds Receives the child boxes; its other members are left untouched
+ */
+template <int N>
+inline void decode_child_bounds(const QuantizedBVHNode<N>& node, WideBVHNode<N>& bounds) {
+    for (int a = 0; a < 3; a++) {
+        const float origin = node.origin[a];
+        const float spacing = grid_spacing(node.exponent[a]);
+        for (int i = 0; i < N; i++) {
+            bounds.bounds_min[a][i] = origin + static_cast<float>(node.child_min[a][i]) * spacing;
+            bounds.bounds_max[a][i] = origin + static_cast<float>(node.child_max[a][i]) * spacing;
+        }
+    }
+}
+
+/**
+ * @brief Slab-tests all children of a quantized node by decoding them
+ *        and running the full-precision kernel
+ */
+template <int N>
+inline int intersect_children(const QuantizedBVHNode<N>& node, const WideRay& ray, float t_min, float t_max,
+                              float* t_near) {
+    WideBVHNode<N> decoded;
+    decode_child_bounds(node, decoded);
+    return intersect_children<N>(decoded, ray, t_min, t_max, t_near);
+}
+
+template <int N>
+class QuantizedBVH {
+public:
+    QuantizedBVH() = default;
+
+    /**
+     * @brief Quantizes a wide BVH node for node, keeping its topology
+     */
+    explicit QuantizedBVH(const WideBVH<N>& wide);
+
+    /**
+     * @brief Adopts an already quantized node array, e.g. one mapped from a cache file
+     */
+    explicit QuantizedBVH(NodeArray<QuantizedBVHNode<N>> nodes) : nodes_(std::move(nodes)) {}
+
+    bool empty() const { return nodes_.empty(); }
+    const NodeArray<QuantizedBVHNode<N>>& nodes() const { return nodes_; }
+
+    /**
+     * @brief Checks that the nodes stay within their arrays; see valid_wide_nodes()
+     */
+    bool valid(uint64_t primitive_count) const { return valid_wide_nodes<N>(nodes_, primitive_count); }
+
+    /**
+     * @brief Same contract as WideBVH::intersect
+     */
+    template <typename LeafIntersector, typename NodeCounter = IgnoreNodeVisits>
+    bool intersect(const core::Ray& ray, float t_min, float& t_max, LeafIntersector&& intersect_leaf,
+                   NodeCounter&& count_node = NodeCounter()) const {
+        if (nodes_.empty()) {
+            return false;
+        }
+        return intersect_wide<N>(nodes_.data(), ray, t_min, t_max, intersect_leaf, count_node);
+    }
+
+    /**
+     * @brief Same contract as WideBVH::occluded
+     */
+    template <typename LeafOcclusion, typename NodeCounter = IgnoreNodeVisits>
+    bool occluded(const core::Ray& ray, float t_min, float t_max, LeafOcclusion&& occluded_leaf,
+                  NodeCounter&& count_node = NodeCounter()) const {
+        if (nodes_.empty()) {
+            return false;
+        }
+        return occluded_wide<N>(nodes_.data(), ray, t_min, t_max, occluded_leaf, count_node);
+    }
+
+private:
+    NodeArray<QuantizedBVHNode<N>> nodes_;
+};
+
+extern template class QuantizedBVH<4>;
+extern template class QuantizedBVH<8>;
+
+} // namespace acceleration
+} // namespace raytracer
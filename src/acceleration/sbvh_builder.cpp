@@ -0,0 +1,404 @@
+/**
+ * @file sbvh_builder.cpp
+ * @brief Implementation of the spatial-split BVH builder
+ */
+
+#include "sbvh_builder.h"
+#include "bvh.h"
+#include <algorithm>
+#include <limits>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    // Same bin count as the object-split builder
+    constexpr int kObjectBinCount = 12;
+
+    // Spatial bins are cheap to evaluate relative to their benefit
+    constexpr int kSpatialBinCount = 32;
+
+    // Spatial splits are only tried where the best object split leaves the
+    // children overlapping by more than this fraction of the root area
+    constexpr float kOverlapThreshold = 1e-5f;
+
+    struct Reference {
+        uint32_t primitive;
+        AABB bounds;
+    };
+
+    struct SpatialBin {
+        AABB bounds;
+        size_t entries = 0;
+        size_t exits = 0;
+    };
+
+    struct SplitCandidate {
+        float cost = std::numeric_limits<float>::infinity();
+        int axis = -1;
+        int bin = 0;
+        float position = 0.0f;     // Spatial splits: plane position
+        AABB left_bounds;
+        AABB right_bounds;
+        size_t left_count = 0;
+        size_t right_count = 0;
+    };
+
+    int object_bin(const Point3& centroid, const AABB& centroid_bounds, int axis) {
+        float extent = centroid_bounds.max()[axis] - centroid_bounds.min()[axis];
+        int b = static_cast<int>(kObjectBinCount * (centroid[axis] - centroid_bounds.min()[axis]) / extent);
+        return std::clamp(b, 0, kObjectBinCount - 1);
+    }
+
+    AABB clamp_axis(const AABB& box, int axis, float low, float high) {
+        Point3 minimum = box.min();
+        Point3 maximum = box.max();
+        minimum[axis] = std::max(minimum[axis], low);
+        maximum[axis] = std::min(maximum[axis], high);
+        return AABB(minimum, maximum);
+    }
+
+    class SBVHBuilder {
+    public:
+        SBVHBuilder(const PrimitiveClipFunction& clip, size_t reference_limit)
+            : clip_(clip), reference_limit_(reference_limit) {}
+
+        LinearBVH build(std::vector<Reference> references) {
+            reference_count_ = references.size();
+            AABB root_box;
+            for (const auto& reference : references) {
+                root_box.expand(reference.bounds);
+            }
+            root_area_ = root_box.surface_area();
+            build_node(references, 0);
+            return LinearBVH(std::move(nodes_), std::move(indices_));
+        }
+
+    private:
+        const PrimitiveClipFunction& clip_;
+        size_t reference_limit_;
+        size_t reference_count_ = 0;
+        float root_area_ = 0.0f;
+        std::vector<LinearBVHNode> nodes_;
+        std::vector<uint32_t> indices_;
+
+        void build_node(std::vector<Reference>& references, int depth) {
+            AABB node_box;
+            AABB centroid_bounds;
+            for (const auto& reference : references) {
+                node_box.expand(reference.bounds);
+                centroid_bounds.expand(reference.bounds.centroid());
+            }
+
+            const size_t count = references.size();
+            if (count == 1) {
+                emit_leaf(references, node_box);
+                return;
+            }
+
+            std::vector<Reference> left;
+            std::vector<Reference> right;
+            int axis;
+
+            if (depth >= BVHNode::kMedianSplitDepth) {
+                // Past this depth only balanced splits, as in the SAH builder
+                if (count <= BVHNode::kMaxLeafSize) {
+                    emit_leaf(references, node_box);
+                    return;
+                }
+                axis = centroid_bounds.longest_axis();
+                median_split(references, axis, left, right);
+            } else {
+                float node_area = node_box.surface_area();
+                if (node_area <= 0.0f) {
+                    node_area = 1.0f;
+                }
+
+                SplitCandidate object = find_object_split(references, centroid_bounds, node_area);
+                SplitCandidate spatial;
+                if (object.axis >= 0 && reference_count_ < reference_limit_ && root_area_ > 0.0f) {
+                    float overlap = object.left_bounds.intersection(object.right_bounds).surface_area();
+                    if (overlap / root_area_ > kOverlapThreshold) {
+                        spatial = find_spatial_split(references, node_box, node_area);
+                    }
+                }
+
+                float best_cost = std::min(object.cost, spatial.cost);
+                if (count <= BVHNode::kMaxLeafSize && static_cast<float>(count) <= best_cost) {
+                    emit_leaf(references, node_box);
+                    return;
+                }
+
+                if (spatial.cost < object.cost && spatial_split(references, spatial, left, right)) {
+                    axis = spatial.axis;
+                } else if (object.axis >= 0) {
+                    axis = object.axis;
+                    for (auto& reference : references) {
+                        bool goes_left = object_bin(reference.bounds.centroid(), centroid_bounds, axis) <= object.bin;
+                        (goes_left ? left : right).push_back(reference);
+                    }
+                } else {
+                    // All centroids coincide, so no plane separates them; split by count
+                    axis = node_box.longest_axis();
+                    median_split(references, axis, left, right);
+                }
+            }
+
+            // Release the parent's references before descending
+            std::vector<Reference>().swap(references);
+
+            uint32_t index = static_cast<uint32_t>(nodes_.size());
+            LinearBVHNode node{};
+            node.set_bounds(node_box);
+            node.axis = static_cast<uint8_t>(axis);
+            nodes_.push_back(node);
+
+            build_node(left, depth + 1);
+            nodes_[index].second_child_offset = static_cast<uint32_t>(nodes_.size());
+            build_node(right, depth + 1);
+        }
+
+        void emit_leaf(const std::vector<Reference>& references, const AABB& node_box) {
+            LinearBVHNode node{};
+            node.set_bounds(node_box);
+            node.primitives_offset = static_cast<uint32_t>(indices_.size());
+            node.primitive_count = static_cast<uint16_t>(references.size());
+            nodes_.push_back(node);
+            for (const auto& reference : references) {
+                indices_.push_back(reference.primitive);
+            }
+        }
+
+        void median_split(std::vector<Reference>& references, int axis,
+                          std::vector<Reference>& left, std::vector<Reference>& right) {
+            size_t mid = references.size() / 2;
+            std::nth_element(references.begin(), references.begin() + mid, references.end(),
+                [axis](const Reference& a, const Reference& b) {
+                    return a.bounds.centroid()[axis] < b.bounds.centroid()[axis];
+                });
+            left.assign(references.begin(), references.begin() + mid);
+            right.assign(references.begin() + mid, references.end());
+        }
+
+        SplitCandidate find_object_split(const std::vector<Reference>& references, const AABB& centroid_bounds,
+                                         float node_area) const {
+            SplitCandidate best;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (centroid_bounds.max()[axis] <= centroid_bounds.min()[axis]) {
+                    continue;
+                }
+
+                AABB bins[kObjectBinCount];
+                size_t counts[kObjectBinCount] = {};
+                for (const auto& reference : references) {
+                    int b = object_bin(reference.bounds.centroid(), centroid_bounds, axis);
+                    bins[b].expand(reference.bounds);
+                    counts[b]++;
+                }
+
+                AABB right_bounds[kObjectBinCount];
+                size_t right_count[kObjectBinCount];
+                AABB accumulated;
+                size_t count = 0;
+                for (int b = kObjectBinCount - 1; b > 0; --b) {
+                    accumulated.expand(bins[b]);
+                    count += counts[b];
+                    right_bounds[b] = accumulated;
+                    right_count[b] = count;
+                }
+
+                accumulated = AABB();
+                count = 0;
+                for (int b = 0; b < kObjectBinCount - 1; ++b) {
+                    accumulated.expand(bins[b]);
+                    count += counts[b];
+                    if (count == 0 || right_count[b + 1] == 0) {
+                        continue;
+                    }
+                    float cost = BVHNode::kTraversalCost +
+                        (count * accumulated.surface_area() +
+                         right_count[b + 1] * right_bounds[b + 1].surface_area()) / node_area;
+                    if (cost < best.cost) {
+                        best.cost = cost;
+                        best.axis = axis;
+                        best.bin = b;
+                        best.left_bounds = accumulated;
+                        best.right_bounds = right_bounds[b + 1];
+                        best.left_count = count;
+                        best.right_count = right_count[b + 1];
+                    }
+                }
+            }
+            return best;
+        }
+
+        SplitCandidate find_spatial_split(const std::vector<Reference>& references, const AABB& node_box,
+                                          float node_area) const {
+            SplitCandidate best;
+            for (int axis = 0; axis < 3; ++axis) {
+                float origin = node_box.min()[axis];
+                float bin_width = (node_box.max()[axis] - origin) / kSpatialBinCount;
+                if (bin_width <= 0.0f) {
+                    continue;
+                }
+                auto bin_of = [&](float coordinate) {
+                    return std::clamp(static_cast<int>((coordinate - origin) / bin_width), 0, kSpatialBinCount - 1);
+                };
+
+                // Each reference is chopped into the bins it spans
+                SpatialBin bins[kSpatialBinCount];
+                for (const auto& reference : references) {
+                    int first = bin_of(reference.bounds.min()[axis]);
+                    int last = bin_of(reference.bounds.max()[axis]);
+                    if (first == last) {
+                        bins[first].bounds.expand(reference.bounds);
+                    } else {
+                        for (int b = first; b <= last; ++b) {
+                            AABB slab = clamp_axis(reference.bounds, axis, origin + b * bin_width,
+                                                   origin + (b + 1) * bin_width);
+                            bins[b].bounds.expand(clip_(reference.primitive, slab));
+                        }
+                    }
+                    bins[first].entries++;
+                    bins[last].exits++;
+                }
+
+                AABB right_bounds[kSpatialBinCount];
+                size_t right_count[kSpatialBinCount];
+                AABB accumulated;
+                size_t count = 0;
+                for (int b = kSpatialBinCount - 1; b > 0; --b) {
+                    accumulated.expand(bins[b].bounds);
+                    count += bins[b].exits;
+                    right_bounds[b] = accumulated;
+                    right_count[b] = count;
+                }
+
+                accumulated = AABB();
+                count = 0;
+                for (int b = 0; b < kSpatialBinCount - 1; ++b) {
+                    accumulated.expand(bins[b].bounds);
+                    count += bins[b].entries;
+                    if (count == 0 || right_count[b + 1] == 0) {
+                        continue;
+                    }
+                    float cost = BVHNode::kTraversalCost +
+                        (count * accumulated.surface_area() +
+                         right_count[b + 1] * right_bounds[b + 1].surface_area()) / node_area;
+                    if (cost < best.cost) {
+                        best.cost = cost;
+                        best.axis = axis;
+                        best.bin = b;
+                        best.position = origin + (b + 1) * bin_width;
+                        best.left_bounds = accumulated;
+                        best.right_bounds = right_bounds[b + 1];
+                        best.left_count = count;
+                        best.right_count = right_count[b + 1];
+                    }
+                }
+            }
+            return best;
+        }
+
+        /**
+         * @brief Distributes references around a split plane, duplicating straddlers
+         *
+         * A straddling reference is kept whole on one side instead when
+         * that is cheaper under the SAH ("reference unsplitting").
+         *
+         * Once the duplication budget is spent, remaining straddlers are
+         * kept whole as well.
+         *
+         * @return False if a side would be empty; the caller then uses the
+         *         object split
+         */
+        bool spatial_split(const std::vector<Reference>& references, const SplitCandidate& split,
+                           std::vector<Reference>& left, std::vector<Reference>& right) {
+            const int axis = split.axis;
+            const float position = split.position;
+
+            const float left_area = split.left_bounds.surface_area();
+            const float right_area = split.right_bounds.surface_area();
+            const float left_count = static_cast<float>(split.left_count);
+            const float right_count = static_cast<float>(split.right_count);
+            const float split_cost = left_area * left_count + right_area * right_count;
+
+            size_t duplicated = 0;
+            for (const auto& reference : references) {
+                if (reference.bounds.max()[axis] <= position) {
+                    left.push_back(reference);
+                    continue;
+                }
+                if (reference.bounds.min()[axis] >= position) {
+                    right.push_back(reference);
+                    continue;
+                }
+
+                float left_cost = surrounding_box(split.left_bounds, reference.bounds).surface_area() * left_count +
+                                  right_area * (right_count - 1.0f);
+                float right_cost = left_area * (left_count - 1.0f) +
+                                   surrounding_box(split.right_bounds, reference.bounds).surface_area() * right_count;
+                if (left_cost < split_cost && left_cost <= right_cost) {
+                    left.push_back(reference);
+                    continue;
+                }
+                if (right_cost < split_cost) {
+                    right.push_back(reference);
+                    continue;
+                }
+
+                if (reference_count_ + duplicated >= reference_limit_) {
+                    // Out of budget: keep the reference whole on the cheaper side
+                    (left_cost <= right_cost ? left : right).push_back(reference);
+                    continue;
+                }
+
+                float low = reference.bounds.min()[axis];
+                float high = reference.bounds.max()[axis];
+                AABB left_part = clip_(reference.primitive, clamp_axis(reference.bounds, axis, low, position));
+                AABB right_part = clip_(reference.primitive, clamp_axis(reference.bounds, axis, position, high));
+                if (left_part.is_empty() && right_part.is_empty()) {
+                    // Clipping lost the primitive to rounding; keep the unclipped reference
+                    left.push_back(reference);
+                } else if (right_part.is_empty()) {
+                    left.push_back({reference.primitive, left_part});
+                } else if (left_part.is_empty()) {
+                    right.push_back({reference.primitive, right_part});
+                } else {
+                    left.push_back({reference.primitive, left_part});
+                    right.push_back({reference.primitive, right_part});
+                    duplicated++;
+                }
+            }
+
+            if (left.empty() || right.empty()) {
+                left.clear();
+                right.clear();
+                return false;
+            }
+
+            reference_count_ += duplicated;
+            return true;
+        }
+    };
+}
+
+LinearBVH build_sbvh(const std::vector<AABB>& primitive_bounds, const PrimitiveClipFunction& clip,
+                     float duplication_budget) {
+    if (primitive_bounds.empty()) {
+        return LinearBVH();
+    }
+
+    std::vector<Reference> references(primitive_bounds.size());
+    for (size_t i = 0; i < primitive_bounds.size(); ++i) {
+        references[i] = {static_cast<uint32_t>(i), primitive_bounds[i]};
+    }
+
+    size_t limit = primitive_bounds.size() +
+        static_cast<size_t>(std::max(0.0f, duplication_budget) * static_cast<float>(primitive_bounds.size()));
+    SBVHBuilder builder(clip, limit);
+    return builder.build(std::move(references));
+}
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,45 @@
+/**
+ * @file sbvh_builder.h
+ * @brief Spatial-split BVH construction (SBVH)
+ *
+ * Extends the binned SAH build with spatial splits (Stich et al. 2009):
+ * a primitive straddling the split plane is referenced from both
+ * children, each time with its bounds clipped to that side. This keeps
+ * child boxes from overlapping around long, thin, diagonal triangles,
+ * which object splits alone can only enclose with large shared volume.
+ */
+
+#pragma once
+
+#include "aabb.h"
+#include "linear_bvh.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace raytracer {
+namespace acceleration {
+
+/**
+ * @brief Returns the bounds of the part of a primitive inside a box
+ *
+ * Called with a primitive id and a box that lies within the primitive's
+ * current reference bounds; must return an empty box if nothing is inside.
+ */
+using PrimitiveClipFunction = std::function<AABB(uint32_t primitive, const AABB& clip_box)>;
+
+/**
+ * @brief Builds a linear BVH that may reference a primitive from several leaves
+ *
+ * @param primitive_bounds Bounding box of every primitive, indexed by primitive id
+ * @param clip Clips a primitive to a box
+ * @param duplication_budget Extra references allowed, as a fraction of the
+ *                           primitive count (0.3 allows 30% more)
+ * @return Hierarchy in the same format as the SAH builder produces; the
+ *         primitive index array can contain an id more than once
+ */
+LinearBVH build_sbvh(const std::vector<AABB>& primitive_bounds, const PrimitiveClipFunction& clip,
+                     float duplication_budget);
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,328 @@
+/**
+ * @file treelet_optimizer.cpp
+ * @brief Implementation of treelet restructuring
+ */
+
+#include "treelet_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    constexpr int kMinTreeletSize = 5;
+    constexpr int kMaxTreeletSize = 7;
+    constexpr uint32_t kMaxSubsets = 1u << kMaxTreeletSize;
+
+    // Subtrees rooted this deep are restructured as independent parallel tasks
+    constexpr int kTaskDepth = 8;
+
+    // Deepest node the traversal stacks can reach
+    constexpr int kMaxDepth = LinearBVH::kStackSize - 1;
+
+    constexpr uint32_t kNoChild = 0xFFFFFFFFu;
+
+    int lowest_bit(uint32_t bits) {
+        int index = 0;
+        while (!(bits & 1u)) {
+            bits >>= 1;
+            ++index;
+        }
+        return index;
+    }
+
+    /**
+     * @brief Best topology of one treelet, found over all subsets of its leaves
+     */
+    struct Treelet {
+        int leaf_count = 0;
+        int internal_count = 0;
+        uint32_t leaves[kMaxTreeletSize];
+        uint32_t internals[kMaxTreeletSize - 1];  // Root first; reused by the new topology
+
+        // Indexed by leaf subset
+        AABB boxes[kMaxSubsets];
+        float costs[kMaxSubsets];
+        int heights[kMaxSubsets];
+        uint8_t splits[kMaxSubsets];                // Subset holding the lowest leaf of each split
+    };
+
+    /**
+     * @brief Binary tree with explicit child links, restructured in place
+     *
+     * Node ids are the indices of the source tree, so leaves keep their
+     * primitive ranges and the root stays at id 0.
+     */
+    class TreeletOptimizer {
+    public:
+        TreeletOptimizer(const LinearBVH& bvh, int treelet_size)
+            : source_(bvh.nodes()), treelet_size_(treelet_size) {
+            const size_t count = source_.size();
+            left_.resize(count);
+            right_.resize(count);
+            boxes_.resize(count);
+            costs_.resize(count);
+            heights_.resize(count);
+            depths_.resize(count);
+
+            // Children follow their parent, so a reverse sweep is bottom-up
+            for (size_t i = count; i-- > 0;) {
+                const LinearBVHNode& node = source_[i];
+                boxes_[i] = node.bounds();
+                if (node.is_leaf()) {
+                    left_[i] = right_[i] = kNoChild;
+                    costs_[i] = boxes_[i].surface_area() * static_cast<float>(node.primitive_count);
+                    heights_[i] = 0;
+                } else {
+                    left_[i] = static_cast<uint32_t>(i + 1);
+                    right_[i] = node.second_child_offset;
+                    costs_[i] = BVHNode::kTraversalCost * boxes_[i].surface_area() + costs_[left_[i]] +
+                                costs_[right_[i]];
+                    heights_[i] = 1 + std::max(heights_[left_[i]], heights_[right_[i]]);
+                }
+            }
+        }
+
+        void run_pass() {
+            // Interior nodes above the task depth in pre-order, and the task roots
+            std::vector<uint32_t> top;
+            std::vector<uint32_t> tasks;
+            std::vector<std::pair<uint32_t, int>> stack = {{0u, 0}};
+            while (!stack.empty()) {
+                auto [id, depth] = stack.back();
+                stack.pop_back();
+                depths_[id] = depth;
+                if (is_leaf(id)) {
+                    continue;
+                }
+                if (depth == kTaskDepth) {
+                    tasks.push_back(id);
+                    continue;
+                }
+                top.push_back(id);
+                stack.push_back({right_[id], depth + 1});
+                stack.push_back({left_[id], depth + 1});
+            }
+
+            // A treelet only reaches into its root's subtree, so the task
+            // subtrees are independent
+            const std::ptrdiff_t task_count = static_cast<std::ptrdiff_t>(tasks.size());
+            #pragma omp parallel for schedule(dynamic)
+            for (std::ptrdiff_t t = 0; t < task_count; ++t) {
+                std::vector<uint32_t> order = subtree_preorder(tasks[t]);
+                for (size_t i = order.size(); i-- > 0;) {
+                    optimize(order[i]);
+                }
+            }
+
+            // Reverse pre-order visits every node after its descendants
+            for (size_t i = top.size(); i-- > 0;) {
+                optimize(top[i]);
+            }
+        }
+
+        // Leaf ranges are repacked in the new depth-first order, so leaves
+        // that are near in the tree stay near in primitive storage
+        LinearBVH flatten(const NodeArray<uint32_t>& primitive_indices) const {
+            std::vector<LinearBVHNode> nodes;
+            std::vector<uint32_t> indices;
+            nodes.reserve(source_.size());
+            indices.reserve(primitive_indices.size());
+            emit(0, primitive_indices, nodes, indices);
+            return LinearBVH(std::move(nodes), std::move(indices));
+        }
+
+    private:
+        const NodeArray<LinearBVHNode>& source_;
+        int treelet_size_;
+        std::vector<uint32_t> left_;
+        std::vector<uint32_t> right_;
+        std::vector<AABB> boxes_;
+        std::vector<float> costs_;   // SAH cost of the subtree, not normalized by the root area
+        std::vector<int> heights_;   // Longest path down to a leaf
+        std::vector<int> depths_;    // Set at the start of each pass
+
+        bool is_leaf(uint32_t id) const { return left_[id] == kNoChild; }
+
+        // Fills in depths_ on the way, like run_pass does above the tasks
+        std::vector<uint32_t> subtree_preorder(uint32_t root) {
+            std::vector<uint32_t> order;
+            std::vector<uint32_t> stack = {root};
+            while (!stack.empty()) {
+                uint32_t id = stack.back();
+                stack.pop_back();
+                if (is_leaf(id)) {
+                    continue;
+                }
+                order.push_back(id);
+                depths_[left_[id]] = depths_[right_[id]] = depths_[id] + 1;
+                stack.push_back(right_[id]);
+                stack.push_back(left_[id]);
+            }
+            return order;
+        }
+
+        void optimize(uint32_t root) {
+            Treelet treelet;
+            treelet.internals[treelet.internal_count++] = root;
+            treelet.leaves[treelet.leaf_count++] = left_[root];
+            treelet.leaves[treelet.leaf_count++] = right_[root];
+
+            // Grow by opening the largest interior leaf, the one most worth rearranging
+            while (treelet.leaf_count < treelet_size_) {
+                int best = -1;
+                float best_area = -1.0f;
+                for (int i = 0; i < treelet.leaf_count; i++) {
+                    uint32_t id = treelet.leaves[i];
+                    if (!is_leaf(id) && boxes_[id].surface_area() > best_area) {
+                        best = i;
+                        best_area = boxes_[id].surface_area();
+                    }
+                }
+                if (best < 0) {
+                    break;
+                }
+                uint32_t opened = treelet.leaves[best];
+                treelet.internals[treelet.internal_count++] = opened;
+                treelet.leaves[best] = left_[opened];
+                treelet.leaves[treelet.leaf_count++] = right_[opened];
+            }
+
+            // Two leaves have only one topology
+            if (treelet.leaf_count < 3) {
+                return;
+            }
+
+            const uint32_t full = (1u << treelet.leaf_count) - 1;
+            find_best_topology(treelet, full);
+
+            const bool cheaper = treelet.costs[full] < costs_[root] * (1.0f - 1e-6f);
+            const bool fits_stack = depths_[root] + treelet.heights[full] <= kMaxDepth;
+            if (cheaper && fits_stack) {
+                int next_internal = 0;
+                rebuild(treelet, full, next_internal);
+            }
+        }
+
+        void find_best_topology(Treelet& treelet, uint32_t full) const {
+            for (uint32_t subset = 1; subset <= full; subset++) {
+                AABB box;
+                for (int i = 0; i < treelet.leaf_count; i++) {
+                    if (subset & (1u << i)) {
+                        box.expand(boxes_[treelet.leaves[i]]);
+                    }
+                }
+                treelet.boxes[subset] = box;
+            }
+
+            // Subsets of a subset are smaller numbers, so increasing order
+            // has every partition's halves solved before the subset itself
+            for (uint32_t subset = 1; subset <= full; subset++) {
+                const uint32_t lowest = subset & (~subset + 1);
+                if (subset == lowest) {
+                    uint32_t leaf = treelet.leaves[lowest_bit(subset)];
+                    treelet.costs[subset] = costs_[leaf];
+                    treelet.heights[subset] = heights_[leaf];
+                    continue;
+                }
+
+                // Fixing the lowest leaf on one side visits each split once
+                const uint32_t others = subset ^ lowest;
+                float best_cost = std::numeric_limits<float>::infinity();
+                uint32_t best_part = lowest;
+                for (uint32_t rest = others;; rest = (rest - 1) & others) {
+                    uint32_t part = rest | lowest;
+                    if (part != subset) {
+                        float cost = treelet.costs[part] + treelet.costs[subset ^ part];
+                        if (cost < best_cost) {
+                            best_cost = cost;
+                            best_part = part;
+                        }
+                    }
+                    if (rest == 0) {
+                        break;
+                    }
+                }
+
+                treelet.splits[subset] = static_cast<uint8_t>(best_part);
+                treelet.costs[subset] = BVHNode::kTraversalCost * treelet.boxes[subset].surface_area() + best_cost;
+                treelet.heights[subset] =
+                    1 + std::max(treelet.heights[best_part], treelet.heights[subset ^ best_part]);
+            }
+        }
+
+        uint32_t rebuild(const Treelet& treelet, uint32_t subset, int& next_internal) {
+            if ((subset & (subset - 1)) == 0) {
+                return treelet.leaves[lowest_bit(subset)];
+            }
+            uint32_t id = treelet.internals[next_internal++];
+            uint32_t part = treelet.splits[subset];
+            left_[id] = rebuild(treelet, part, next_internal);
+            right_[id] = rebuild(treelet, subset ^ part, next_internal);
+            boxes_[id] = treelet.boxes[subset];
+            costs_[id] = treelet.costs[subset];
+            heights_[id] = treelet.heights[subset];
+            return id;
+        }
+
+        uint32_t emit(uint32_t id, const NodeArray<uint32_t>& primitive_indices, std::vector<LinearBVHNode>& nodes,
+                      std::vector<uint32_t>& indices) const {
+            uint32_t offset = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+
+            if (is_leaf(id)) {
+                LinearBVHNode leaf = source_[id];
+                const uint32_t first = leaf.primitives_offset;
+                leaf.primitives_offset = static_cast<uint32_t>(indices.size());
+                indices.insert(indices.end(), primitive_indices.begin() + first,
+                               primitive_indices.begin() + first + leaf.primitive_count);
+                nodes[offset] = leaf;
+                return offset;
+            }
+
+            // Order children along the axis that separates them most, with
+            // the first child on the low side as traversal expects
+            uint32_t left = left_[id];
+            uint32_t right = right_[id];
+            Point3 first = boxes_[left].centroid();
+            Point3 second = boxes_[right].centroid();
+            int axis = 0;
+            for (int a = 1; a < 3; a++) {
+                if (std::abs(second[a] - first[a]) > std::abs(second[axis] - first[axis])) {
+                    axis = a;
+                }
+            }
+            if (second[axis] < first[axis]) {
+                std::swap(left, right);
+            }
+
+            LinearBVHNode node{};
+            node.set_bounds(boxes_[id]);
+            node.axis = static_cast<uint8_t>(axis);
+            node.primitive_count = 0;
+            emit(left, primitive_indices, nodes, indices);
+            node.second_child_offset = emit(right, primitive_indices, nodes, indices);
+            nodes[offset] = node;
+            return offset;
+        }
+    };
+}
+
+LinearBVH optimize_treelets(const LinearBVH& bvh, int treelet_size, int passes) {
+    if (bvh.nodes().size() < 3) {
+        return bvh;
+    }
+
+    TreeletOptimizer optimizer(bvh, std::clamp(treelet_size, kMinTreeletSize, kMaxTreeletSize));
+    for (int pass = 0; pass < passes; pass++) {
+        optimizer.run_pass();
+    }
+    return optimizer.flatten(bvh.primitive_indices());
+}
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,35 @@
+/**
+ * @file treelet_optimizer.h
+ * @brief Post-build BVH optimization by treelet restructuring (TRBVH)
+ *
+ * After Karras and Aila 2013: every interior node is taken as the root of
+ * a treelet grown to a handful of leaves by opening its largest children,
+ * and the treelet is rebuilt with the topology of minimum SAH cost found
+ * by dynamic programming over subsets of its leaves. Treelets are
+ * processed bottom-up, independent subtrees in parallel, and the whole
+ * pass is repeated a few times. Leaves keep their primitives; only the
+ * interior nodes and the order of the leaves change.
+ */
+
+#pragma once
+
+#include "linear_bvh.h"
+
+namespace raytracer {
+namespace acceleration {
+
+/**
+ * @brief Restructures treelets of a built tree to lower its SAH cost
+ *
+ * Works on the output of any builder. Restructurings that would deepen
+ * the tree past the traversal stack are skipped.
+ *
+ * @param bvh Tree to optimize
+ * @param treelet_size Leaves per treelet; clamped to [5, 7]
+ * @param passes Bottom-up sweeps over the tree
+ * @return Optimized tree; its SAH cost never exceeds the input's
+ */
+LinearBVH optimize_treelets(const LinearBVH& bvh, int treelet_size, int passes);
+
+} // namespace acceleration
+} // namespace raytracer
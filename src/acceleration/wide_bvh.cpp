@@ -0,0 +1,122 @@
+/**
+ * @file wide_bvh.cpp
+ * @brief Collapse of a binary BVH into 4-wide and 8-wide nodes
+ */
+
+#include "wide_bvh.h"
+#include <limits>
+#include <stdexcept>
+
+namespace raytracer {
+namespace acceleration {
+
+namespace {
+    // Unused slots get an inverted box, which the ordered slab test always rejects
+    template <int N>
+    void clear_slot(WideBVHNode<N>& node, int i) {
+        for (int a = 0; a < 3; a++) {
+            node.bounds_min[a][i] = std::numeric_limits<float>::infinity();
+            node.bounds_max[a][i] = -std::numeric_limits<float>::infinity();
+        }
+        node.child[i] = 0;
+        node.primitive_count[i] = 0;
+    }
+
+    template <int N>
+    void set_slot(WideBVHNode<N>& node, int i, const LinearBVHNode& source) {
+        for (int a = 0; a < 3; a++) {
+            node.bounds_min[a][i] = source.bounds_min[a];
+            node.bounds_max[a][i] = source.bounds_max[a];
+        }
+        if (source.primitive_count > LinearBVH::kMaxWideLeafSize) {
+            throw std::runtime_error("WideBVH: leaf holds more primitives than a wide node can address");
+        }
+        node.child[i] = source.primitives_offset;
+        node.primitive_count[i] = static_cast<uint8_t>(source.primitive_count);
+    }
+}
+
+template <int N>
+WideBVH<N>::WideBVH(const LinearBVH& binary) {
+    if (binary.empty()) {
+        return;
+    }
+
+    const auto& binary_nodes = binary.nodes();
+    if (binary_nodes[0].is_leaf()) {
+        // A single-leaf tree still needs an interior root to start traversal
+        WideBVHNode<N> root;
+        for (int i = 1; i < N; i++) {
+            clear_slot(root, i);
+        }
+        set_slot(root, 0, binary_nodes[0]);
+        nodes_ = std::vector<WideBVHNode<N>>{root};
+        return;
+    }
+
+    std::vector<WideBVHNode<N>> nodes;
+    collapse(binary, 0, nodes);
+    nodes_ = std::move(nodes);
+}
+
+template <int N>
+uint32_t WideBVH<N>::collapse(const LinearBVH& binary, uint32_t binary_index,
+                             std::vector<WideBVHNode<N>>& nodes) {
+    const auto& binary_nodes = binary.nodes();
+
+    // Start from the two children and keep opening the interior child with
+    // the largest surface area, which is the one most likely to be visited
+    uint32_t children[N];
+    int child_count = 0;
+    children[child_count++] = binary_index + 1;
+    children[child_count++] = binary_nodes[binary_index].second_child_offset;
+
+    while (child_count < N) {
+        int best = -1;
+        float best_area = -1.0f;
+        for (int i = 0; i < child_count; i++) {
+            const LinearBVHNode& candidate = binary_nodes[children[i]];
+            if (candidate.is_leaf()) {
+                continue;
+            }
+            float area = candidate.bounds().surface_area();
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        uint32_t opened = children[best];
+        children[best] = opened + 1;
+        children[child_count++] = binary_nodes[opened].second_child_offset;
+    }
+
+    uint32_t node_index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    WideBVHNode<N> node;
+    for (int i = 0; i < N; i++) {
+        if (i >= child_count) {
+            clear_slot(node, i);
+            continue;
+        }
+
+        const LinearBVHNode& source = binary_nodes[children[i]];
+        set_slot(node, i, source);
+        if (!source.is_leaf()) {
+            node.child[i] = collapse(binary, children[i], nodes);
+        }
+    }
+
+    nodes[node_index] = node;
+    return node_index;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
+
+} // namespace acceleration
+} // namespace raytracer
@@ -0,0 +1,362 @@
+/**
+ * @file wide_bvh.h
+ * @brief 4-wide / 8-wide BVH with SIMD slab tests
+ *
+ * A WideBVH is collapsed from a binary LinearBVH. Each node stores the
+ * bounds of up to N children in structure-of-arrays form, so a single
+ * SSE (N = 4) or AVX (N = 8) slab test checks all children at once.
+ * Leaves keep the primitive ranges of the binary tree they came from.
+ */
+
+#pragma once
+
+#include "../common.h"
+#include "../core/ray.h"
+#include "aabb.h"
+#include "linear_bvh.h"
+#include "node_array.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define RAYTRACER_WIDE_BVH_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define RAYTRACER_WIDE_BVH_AVX 1
+#endif
+
+namespace raytracer {
+namespace acceleration {
+
+template <int N>
+struct alignas(32) WideBVHNode {
+    float bounds_min[3][N];          // [axis][child]; empty slots hold an inverted box
+    float bounds_max[3][N];
+    uint32_t child[N];               // Interior: node index; leaf: first primitive
+    uint8_t primitive_count[N];      // 0 for interior children and empty slots
+
+    bool is_leaf(int i) const { return primitive_count[i] > 0; }
+    bool is_unused(int i) const {
+        return !is_leaf(i) && bounds_min[0][i] > bounds_max[0][i] && bounds_min[1][i] > bounds_max[1][i] &&
+               bounds_min[2][i] > bounds_max[2][i];
+    }
+};
+
+static_assert(sizeof(WideBVHNode<4>) == 128, "4-wide node must stay two cache lines");
+static_assert(sizeof(WideBVHNode<8>) == 256, "8-wide node must stay four cache lines");
+
+/**
+ * @brief Ray data shared by all child slab tests of one traversal
+ */
+struct WideRay {
+    Point3 origin;
+    Vec3 inv_direction;
+    Vec3 far_inv_direction;     // Rounded up so far-plane distances never fall short (Ize 2013)
+    int near_is_max[3];    // Per axis: 1 if the near plane is the max plane
+};
+
+/**
+ * @brief Slab-tests all children of a node at once
+ *
+ * @param t_near Receives the entry distance of each child
+ * @return Bit mask of children whose box overlaps [t_min, t_max]
+ */
+template <int N>
+int intersect_children(const WideBVHNode<N>& node, const WideRay& ray, float t_min, float t_max, float* t_near);
+
+/**
+ * @brief Checks that wide nodes of any encoding stay within their arrays
+ *
+ * Interior children must come after their parent, which rules out
+ * cycles, and keep the tree within the traversal stack; leaf ranges must
+ * lie within the primitives.
+ *
+ * @param primitive_count Number of entries the leaf ranges address
+ */
+template <int N, typename Node>
+bool valid_wide_nodes(const NodeArray<Node>& nodes, uint64_t primitive_count) {
+    // Depth in interior levels; parents always precede their children, so
+    // one forward pass sees every parent first
+    const size_t count = nodes.size();
+    std::vector<uint8_t> depth(count, 0);
+    for (size_t index = 0; index < count; ++index) {
+        const Node& node = nodes[index];
+        for (int i = 0; i < N; i++) {
+            if (node.is_leaf(i)) {
+                if (uint64_t(node.child[i]) + node.primitive_count[i] > primitive_count) {
+                    return false;
+                }
+            } else if (!node.is_unused(i)) {
+                const uint32_t child = node.child[i];
+                if (child <= index || child >= count || depth[index] + 1 >= LinearBVH::kStackSize) {
+                    return false;
+                }
+                depth[child] = std::max(depth[child], static_cast<uint8_t>(depth[index] + 1));
+            }
+        }
+    }
+    return true;
+}
+
+template <int N>
+class WideBVH {
+public:
+    // Each popped interior node pushes at most N - 1 extra entries
+    static constexpr int kStackSize = LinearBVH::kStackSize * (N - 1) + 1;
+
+    WideBVH() = default;
+
+    /**
+     * @brief Collapses a binary BVH, pulling the largest-area interior
+     *        grandchildren up until every node has N children or only leaves
+     *
+     * @param binary Source tree; leaf primitive ranges are reused unchanged
+     */
+    explicit WideBVH(const LinearBVH& binary);
+
+    /**
+     * @brief Adopts an already collapsed node array, e.g. one mapped from a cache file
+     */
+    explicit WideBVH(NodeArray<WideBVHNode<N>> nodes) : nodes_(std::move(nodes)) {}
+
+    bool empty() const { return nodes_.empty(); }
+    const NodeArray<WideBVHNode<N>>& nodes() const { return nodes_; }
+
+    /**
+     * @brief Checks that the nodes can be traversed without leaving their
+     *        arrays; see valid_wide_nodes(). Meant for nodes read from files.
+     */
+    bool valid(uint64_t primitive_count) const { return valid_wide_nodes<N>(nodes_, primitive_count); }
+
+    /**
+     * @brief Finds the closest hit, visiting hit children nearest-first
+     *
+     * Same contract as LinearBVH::intersect; count_node is invoked once per
+     * wide node, whose children are tested together.
+     */
+    template <typename LeafIntersector, typename NodeCounter = IgnoreNodeVisits>
+    bool intersect(const core::Ray& ray, float t_min, float& t_max, LeafIntersector&& intersect_leaf,
+                   NodeCounter&& count_node = NodeCounter()) const;
+
+    /**
+     * @brief Any-hit traversal; same contract as LinearBVH::occluded
+     *
+     * Hit children are pushed unsorted: without a shrinking interval the
+     * ordering rarely pays for itself.
+     */
+    template <typename LeafOcclusion, typename NodeCounter = IgnoreNodeVisits>
+    bool occluded(const core::Ray& ray, float t_min, float t_max, LeafOcclusion&& occluded_leaf,
+                  NodeCounter&& count_node = NodeCounter()) const;
+
+private:
+    NodeArray<WideBVHNode<N>> nodes_;
+
+    uint32_t collapse(const LinearBVH& binary, uint32_t binary_index, std::vector<WideBVHNode<N>>& nodes);
+};
+
+inline WideRay make_wide_ray(const core::Ray& ray) {
+    WideRay wide_ray;
+    wide_ray.origin = ray.origin();
+    wide_ray.inv_direction = ray.inv_direction();
+    wide_ray.far_inv_direction = ray.inv_direction() * kFarPlaneScale;
+    for (int a = 0; a < 3; a++) {
+        wide_ray.near_is_max[a] = ray.sign(a);
+    }
+    return wide_ray;
+}
+
+template <int N>
+inline int intersect_children(const WideBVHNode<N>& node, const WideRay& ray, float t_min, float t_max, float* t_near) {
+    // Portable path; selecting the near/far plane by direction sign keeps
+    // inverted (empty) boxes from ever passing the test
+    int mask = 0;
+    for (int i = 0; i < N; i++) {
+        float entry = t_min;
+        float exit = t_max;
+        for (int a = 0; a < 3; a++) {
+            const float* near_plane = ray.near_is_max[a] ? node.bounds_max[a] : node.bounds_min[a];
+            const float* far_plane = ray.near_is_max[a] ? node.bounds_min[a] : node.bounds_max[a];
+            entry = std::max(entry, (near_plane[i] - ray.origin[a]) * ray.inv_direction[a]);
+            exit = std::min(exit, (far_plane[i] - ray.origin[a]) * ray.far_inv_direction[a]);
+        }
+        t_near[i] = entry;
+        mask |= (entry <= exit) ? (1 << i) : 0;
+    }
+    return mask;
+}
+
+#ifdef RAYTRACER_WIDE_BVH_SSE
+template <>
+inline int intersect_children<4>(const WideBVHNode<4>& node, const WideRay& ray, float t_min, float t_max, float* t_near) {
+    __m128 entry = _mm_set1_ps(t_min);
+    __m128 exit = _mm_set1_ps(t_max);
+    for (int a = 0; a < 3; a++) {
+        const float* near_plane = ray.near_is_max[a] ? node.bounds_max[a] : node.bounds_min[a];
+        const float* far_plane = ray.near_is_max[a] ? node.bounds_min[a] : node.bounds_max[a];
+        __m128 origin = _mm_set1_ps(ray.origin[a]);
+        __m128 inv_direction = _mm_set1_ps(ray.inv_direction[a]);
+        __m128 far_inv_direction = _mm_set1_ps(ray.far_inv_direction[a]);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_plane), origin), inv_direction);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_plane), origin), far_inv_direction);
+        // Slab distance first: if it is NaN (0 * inf) the running bound is kept
+        entry = _mm_max_ps(t0, entry);
+        exit = _mm_min_ps(t1, exit);
+    }
+    _mm_storeu_ps(t_near, entry);
+    return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+}
+#endif
+
+#ifdef RAYTRACER_WIDE_BVH_AVX
+template <>
+inline int intersect_children<8>(const WideBVHNode<8>& node, const WideRay& ray, float t_min, float t_max, float* t_near) {
+    __m256 entry = _mm256_set1_ps(t_min);
+    __m256 exit = _mm256_set1_ps(t_max);
+    for (int a = 0; a < 3; a++) {
+        const float* near_plane = ray.near_is_max[a] ? node.bounds_max[a] : node.bounds_min[a];
+        const float* far_plane = ray.near_is_max[a] ? node.bounds_min[a] : node.bounds_max[a];
+        __m256 origin = _mm256_set1_ps(ray.origin[a]);
+        __m256 inv_direction = _mm256_set1_ps(ray.inv_direction[a]);
+        __m256 far_inv_direction = _mm256_set1_ps(ray.far_inv_direction[a]);
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(near_plane), origin), inv_direction);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(far_plane), origin), far_inv_direction);
+        entry = _mm256_max_ps(t0, entry);
+        exit = _mm256_min_ps(t1, exit);
+    }
+    _mm256_storeu_ps(t_near, entry);
+    return _mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ));
+}
+#endif
+
+/**
+ * @brief Closest-hit traversal shared by the wide layouts
+ *
+ * @param nodes Node array; intersect_children<N> must accept its node type
+ */
+template <int N, typename Node, typename LeafIntersector, typename NodeCounter>
+bool intersect_wide(const Node* nodes, const core::Ray& ray, float t_min, float& t_max,
+                    LeafIntersector&& intersect_leaf, NodeCounter&& count_node) {
+    struct StackEntry {
+        uint32_t index;
+        uint32_t primitive_count;
+        float t_near;
+    };
+
+    const WideRay wide_ray = make_wide_ray(ray);
+    StackEntry stack[WideBVH<N>::kStackSize];
+    int stack_size = 0;
+    stack[stack_size++] = {0, 0, t_min};
+    bool hit_anything = false;
+
+    while (stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+
+        // Skip subtrees that start behind the closest hit found since the push
+        if (entry.t_near > t_max) {
+            continue;
+        }
+
+        if (entry.primitive_count > 0) {
+            if (intersect_leaf(entry.index, entry.primitive_count, t_min, t_max)) {
+                hit_anything = true;
+            }
+            continue;
+        }
+
+        const Node& node = nodes[entry.index];
+        count_node();
+        alignas(32) float t_near[N];
+        int mask = intersect_children<N>(node, wide_ray, t_min, t_max, t_near);
+
+        // Order hit children far-to-near so the nearest is popped first
+        StackEntry hits[N];
+        int hit_count = 0;
+        for (int i = 0; i < N; i++) {
+            if (!(mask & (1 << i))) {
+                continue;
+            }
+            StackEntry child = {node.child[i], node.primitive_count[i], t_near[i]};
+            int j = hit_count++;
+            while (j > 0 && hits[j - 1].t_near < child.t_near) {
+                hits[j] = hits[j - 1];
+                --j;
+            }
+            hits[j] = child;
+        }
+        for (int i = 0; i < hit_count; i++) {
+            stack[stack_size++] = hits[i];
+        }
+    }
+
+    return hit_anything;
+}
+
+/**
+ * @brief Any-hit traversal shared by the wide layouts
+ */
+template <int N, typename Node, typename LeafOcclusion, typename NodeCounter>
+bool occluded_wide(const Node* nodes, const core::Ray& ray, float t_min, float t_max,
+                   LeafOcclusion&& occluded_leaf, NodeCounter&& count_node) {
+    struct StackEntry {
+        uint32_t index;
+        uint32_t primitive_count;
+    };
+
+    const WideRay wide_ray = make_wide_ray(ray);
+    StackEntry stack[WideBVH<N>::kStackSize];
+    int stack_size = 0;
+    stack[stack_size++] = {0, 0};
+
+    while (stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+
+        if (entry.primitive_count > 0) {
+            if (occluded_leaf(entry.index, entry.primitive_count, t_min, t_max)) {
+                return true;
+            }
+            continue;
+        }
+
+        const Node& node = nodes[entry.index];
+        count_node();
+        alignas(32) float t_near[N];
+        int mask = intersect_children<N>(node, wide_ray, t_min, t_max, t_near);
+        for (int i = 0; i < N; i++) {
+            if (mask & (1 << i)) {
+                stack[stack_size++] = {node.child[i], node.primitive_count[i]};
+            }
+        }
+    }
+
+    return false;
+}
+
+template <int N>
+template <typename LeafIntersector, typename NodeCounter>
+bool WideBVH<N>::intersect(const core::Ray& ray, float t_min, float& t_max, LeafIntersector&& intersect_leaf,
+                           NodeCounter&& count_node) const {
+    if (nodes_.empty()) {
+        return false;
+    }
+    return intersect_wide<N>(nodes_.data(), ray, t_min, t_max, intersect_leaf, count_node);
+}
+
+template <int N>
+template <typename LeafOcclusion, typename NodeCounter>
+bool WideBVH<N>::occluded(const core::Ray& ray, float t_min, float t_max, LeafOcclusion&& occluded_leaf,
+                          NodeCounter&& count_node) const {
+    if (nodes_.empty()) {
+        return false;
+    }
+    return occluded_wide<N>(nodes_.data(), ray, t_min, t_max, occluded_leaf, count_node);
+}
+
+extern template class WideBVH<4>;
+extern template class WideBVH<8>;
+
+} // namespace acceleration
+} // namespace raytracer
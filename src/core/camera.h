@@ -14,6 +14,11 @@ public:
 
     Ray get_ray(float u, float v) const;
     
+    /**
+     * @brief True without depth of field: every ray starts at the camera position
+     */
+    bool is_pinhole() const { return lens_radius_ == 0.0f; }
+    
     /**
      * @brief Updates camera position and orientation
      * 
@@ -0,0 +1,41 @@
+/**
+ * @file hash.h
+ * @brief 64-bit FNV-1a hashing for cache keys
+ *
+ * Not cryptographic; used to detect when geometry or build options
+ * changed since a cached result was written.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace raytracer {
+namespace core {
+
+constexpr uint64_t kHashSeed = 14695981039346656037ull;
+
+/**
+ * @brief Hashes a byte range, continuing from a previous hash value
+ */
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = kHashSeed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Folds a trivially copyable value into a running hash
+ */
+template <typename T>
+inline uint64_t hash_combine(uint64_t seed, const T& value) {
+    return hash_bytes(&value, sizeof(T), seed);
+}
+
+} // namespace core
+} // namespace raytracer
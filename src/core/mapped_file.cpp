@@ -0,0 +1,110 @@
+/**
+ * @file mapped_file.cpp
+ * @brief POSIX and Win32 implementations of the read-only file mapping
+ */
+
+#include "mapped_file.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace raytracer {
+namespace core {
+
+#ifdef _WIN32
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filename) {
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    mapped->file_ = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        throw std::runtime_error("Failed to query file size: " + filename);
+    }
+    mapped->size_ = static_cast<size_t>(size.QuadPart);
+    if (mapped->size_ == 0) {
+        return mapped;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+    mapped->mapping_ = mapping;
+
+    mapped->data_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped->data_) {
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    if (file_) {
+        CloseHandle(file_);
+    }
+}
+
+#else
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filename) {
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to query file size: " + filename);
+    }
+    mapped->size_ = static_cast<size_t>(info.st_size);
+    if (mapped->size_ == 0) {
+        ::close(fd);
+        return mapped;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(nullptr, mapped->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+    mapped->data_ = data;
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+}
+
+#endif
+
+} // namespace core
+} // namespace raytracer
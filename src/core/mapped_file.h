@@ -0,0 +1,49 @@
+/**
+ * @file mapped_file.h
+ * @brief Read-only memory-mapped file
+ *
+ * Large binary inputs such as cached acceleration structures are mapped
+ * rather than read, so opening them costs no copying and pages are only
+ * faulted in when traversal touches them.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace raytracer {
+namespace core {
+
+class MappedFile {
+public:
+    /**
+     * @brief Maps a whole file read-only
+     *
+     * @param filename Path of the file to map
+     * @return Shared mapping; data stays valid while any copy of the pointer is alive
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    static std::shared_ptr<const MappedFile> open(const std::string& filename);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return static_cast<const unsigned char*>(data_); }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    void* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+} // namespace core
+} // namespace raytracer
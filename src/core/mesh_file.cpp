@@ -0,0 +1,291 @@
+/**
+ * @file mesh_file.cpp
+ * @brief Native mesh file layout, mapping, writing and conversion
+ */
+
+#include "mesh_file.h"
+#include "mapped_file.h"
+#include "mesh_importer.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace raytracer {
+namespace core {
+
+namespace {
+    constexpr char kMagic[8] = {'R', 'T', 'M', 'E', 'S', 'H', 0, 0};
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kByteOrderMark = 0x01020304;
+    constexpr uint64_t kBlockAlignment = 64;
+
+    constexpr uint32_t kHasNormals = 1u << 0;
+    constexpr uint32_t kHasTextureCoordinates = 1u << 1;
+    constexpr uint32_t kHasBVH = 1u << 2;
+
+    enum Block {
+        kX, kY, kZ,
+        kNormalX, kNormalY, kNormalZ,
+        kU, kV,
+        kIndices,
+        kFaceIds,
+        kNodes,
+        kBlockCount
+    };
+
+    struct MeshFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t node_size;
+        uint32_t flags;
+        uint64_t vertex_count;
+        uint64_t face_count;
+        uint64_t node_count;
+        uint64_t offsets[kBlockCount];      // 0 for blocks the flags leave out
+    };
+
+    uint64_t align_up(uint64_t offset) {
+        return (offset + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment;
+    }
+
+    bool block_fits(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size) {
+        return offset % kBlockAlignment == 0 && offset <= file_size && count <= (file_size - offset) / element_size;
+    }
+
+    template <typename T>
+    acceleration::NodeArray<T> map_block(const std::shared_ptr<const MappedFile>& file, uint64_t offset,
+                                         uint64_t count) {
+        const T* data = reinterpret_cast<const T*>(file->data() + offset);
+        return acceleration::NodeArray<T>::view(data, static_cast<size_t>(count), file);
+    }
+
+    template <typename T>
+    void write_block(std::ofstream& out, uint64_t offset, const acceleration::NodeArray<T>& block) {
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(T)));
+    }
+
+    template <typename T>
+    std::vector<T> copy_block(const acceleration::NodeArray<T>& block) {
+        return std::vector<T>(block.begin(), block.end());
+    }
+
+    std::string lowercase_extension(const std::string& filename) {
+        std::string extension = std::filesystem::path(filename).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+}
+
+void save_mesh_file(const std::string& filename, const geometry::Mesh& mesh, bool include_bvh) {
+    const geometry::MeshArrays& arrays = mesh.arrays();
+
+    MeshFileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrderMark;
+    header.node_size = sizeof(acceleration::WideBVHNode<4>);
+    header.flags = (mesh.has_vertex_normals() ? kHasNormals : 0) |
+                   (mesh.has_texture_coordinates() ? kHasTextureCoordinates : 0) | (include_bvh ? kHasBVH : 0);
+    header.vertex_count = mesh.vertex_count();
+    header.face_count = mesh.face_count();
+    header.node_count = include_bvh ? mesh.bvh().nodes().size() : 0;
+
+    // Without the BVH the faces go back to their original order, which
+    // the rebuild on load then permutes again
+    acceleration::NodeArray<uint32_t> original_order;
+    if (!include_bvh) {
+        std::vector<uint32_t> indices(arrays.indices.size());
+        for (size_t i = 0; i < arrays.face_ids.size(); ++i) {
+            std::copy_n(arrays.indices.data() + 3 * i, 3, indices.data() + 3 * size_t(arrays.face_ids[i]));
+        }
+        original_order = std::move(indices);
+    }
+
+    const acceleration::NodeArray<float>* attributes[] = {
+        &arrays.x, &arrays.y, &arrays.z, &arrays.normal_x, &arrays.normal_y, &arrays.normal_z, &arrays.u, &arrays.v,
+    };
+    uint64_t offset = align_up(sizeof(MeshFileHeader));
+    for (int block = kX; block <= kV; block++) {
+        if (attributes[block]->empty()) {
+            continue;
+        }
+        header.offsets[block] = offset;
+        offset = align_up(offset + header.vertex_count * sizeof(float));
+    }
+    header.offsets[kIndices] = offset;
+    offset = align_up(offset + header.face_count * 3 * sizeof(uint32_t));
+    if (include_bvh) {
+        header.offsets[kFaceIds] = offset;
+        offset = align_up(offset + header.face_count * sizeof(uint32_t));
+        header.offsets[kNodes] = offset;
+        offset += header.node_count * sizeof(acceleration::WideBVHNode<4>);
+    }
+    const uint64_t file_size = offset;
+
+    std::filesystem::path target(filename);
+    std::error_code error;
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to create mesh file: " + temporary);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (int block = kX; block <= kV; block++) {
+            if (header.offsets[block] != 0) {
+                write_block(out, header.offsets[block], *attributes[block]);
+            }
+        }
+        write_block(out, header.offsets[kIndices], include_bvh ? arrays.indices : original_order);
+        if (include_bvh) {
+            write_block(out, header.offsets[kFaceIds], arrays.face_ids);
+            write_block(out, header.offsets[kNodes], mesh.bvh().nodes());
+        }
+
+        // Seeking past the end leaves the gaps unwritten; pin the final size
+        if (static_cast<uint64_t>(out.tellp()) < file_size) {
+            out.seekp(static_cast<std::streamoff>(file_size - 1));
+            out.put('\0');
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write mesh file: " + temporary);
+        }
+    }
+
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("Failed to move mesh file into place: " + filename);
+    }
+}
+
+std::shared_ptr<geometry::Mesh> load_mesh_file(const std::string& filename,
+                                               uint32_t material, bool validate) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto file = MappedFile::open(filename);
+    if (file->size() < sizeof(MeshFileHeader)) {
+        throw std::runtime_error("Not a mesh file: " + filename);
+    }
+    MeshFileHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a mesh file: " + filename);
+    }
+    if (header.version != kVersion || header.byte_order != kByteOrderMark ||
+        header.node_size != sizeof(acceleration::WideBVHNode<4>)) {
+        throw std::runtime_error("Mesh file was written by an incompatible build: " + filename);
+    }
+
+    // Three 32-bit indices per face must not overflow the block size check
+    if (header.face_count > UINT64_MAX / 12) {
+        throw std::runtime_error("Mesh file is corrupt: " + filename);
+    }
+
+    const bool has_bvh = (header.flags & kHasBVH) != 0;
+    bool present[kBlockCount] = {true, true, true};
+    std::fill(present + kNormalX, present + kU, (header.flags & kHasNormals) != 0);
+    std::fill(present + kU, present + kIndices, (header.flags & kHasTextureCoordinates) != 0);
+    present[kIndices] = true;
+    present[kFaceIds] = has_bvh;
+    present[kNodes] = has_bvh;
+
+    const uint64_t size = file->size();
+    for (int block = 0; block < kBlockCount; block++) {
+        uint64_t count = block <= kV ? header.vertex_count
+                       : block == kIndices ? header.face_count * 3
+                       : block == kFaceIds ? header.face_count
+                       : header.node_count;
+        uint64_t element_size = block == kNodes ? sizeof(acceleration::WideBVHNode<4>) : 4;
+        if (present[block] && !block_fits(header.offsets[block], count, element_size, size)) {
+            throw std::runtime_error("Mesh file is truncated: " + filename);
+        }
+    }
+
+    // Every block holds a share of the mapping, which is released with the last of them
+    geometry::MeshArrays arrays;
+    acceleration::NodeArray<float>* attributes[] = {
+        &arrays.x, &arrays.y, &arrays.z, &arrays.normal_x, &arrays.normal_y, &arrays.normal_z, &arrays.u, &arrays.v,
+    };
+    for (int block = kX; block <= kV; block++) {
+        if (present[block]) {
+            *attributes[block] = map_block<float>(file, header.offsets[block], header.vertex_count);
+        }
+    }
+    arrays.indices = map_block<uint32_t>(file, header.offsets[kIndices], header.face_count * 3);
+
+    std::shared_ptr<geometry::Mesh> mesh;
+    if (has_bvh) {
+        arrays.face_ids = map_block<uint32_t>(file, header.offsets[kFaceIds], header.face_count);
+        acceleration::WideBVH<4> bvh(
+            map_block<acceleration::WideBVHNode<4>>(file, header.offsets[kNodes], header.node_count));
+        mesh = std::make_shared<geometry::Mesh>(std::move(arrays), std::move(bvh), material, validate);
+    } else {
+        mesh = std::make_shared<geometry::Mesh>(copy_block(arrays.x), copy_block(arrays.y), copy_block(arrays.z),
+                                                copy_block(arrays.indices), material);
+        if (present[kNormalX]) {
+            mesh->set_vertex_normals(copy_block(arrays.normal_x), copy_block(arrays.normal_y),
+                                     copy_block(arrays.normal_z));
+        }
+        if (present[kU]) {
+            mesh->set_texture_coordinates(copy_block(arrays.u), copy_block(arrays.v));
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+    std::cout << "Mapped " << filename << ": " << mesh->face_count() << " triangles, " << mesh->vertex_count()
+              << " vertices in " << elapsed.count() << " ms" << (has_bvh ? "" : " (face BVH built)") << std::endl;
+    return mesh;
+}
+
+std::shared_ptr<geometry::Mesh> load_mesh(const std::string& filename,
+                                          uint32_t material, bool validate) {
+    if (lowercase_extension(filename) == kMeshFileExtension) {
+        return load_mesh_file(filename, material, validate);
+    }
+
+    MeshData data = import_mesh(filename);
+    auto mesh = std::make_shared<geometry::Mesh>(std::move(data.x), std::move(data.y), std::move(data.z),
+                                                 std::move(data.indices), material);
+    if (!data.normal_x.empty()) {
+        mesh->set_vertex_normals(std::move(data.normal_x), std::move(data.normal_y), std::move(data.normal_z));
+    }
+    if (!data.u.empty()) {
+        mesh->set_texture_coordinates(std::move(data.u), std::move(data.v));
+    }
+    return mesh;
+}
+
+void convert_mesh(const std::string& input, const std::string& output) {
+    if (lowercase_extension(input) == kMeshFileExtension) {
+        throw std::runtime_error("Mesh is already in the native format: " + input);
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto mesh = load_mesh(input, 0);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+
+    save_mesh_file(output, *mesh);
+    std::cout << "Converted " << input << " to " << output << ": " << mesh->face_count() << " triangles, "
+              << mesh->memory_bytes() / (1024.0 * 1024.0) << " MB of mesh data (import and face BVH build "
+              << elapsed.count() << " ms)" << std::endl;
+}
+
+} // namespace core
+} // namespace raytracer
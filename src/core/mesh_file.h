@@ -0,0 +1,69 @@
+/**
+ * @file mesh_file.h
+ * @brief Native binary mesh format, loaded by mapping instead of parsing
+ *
+ * A mesh file holds a header followed by one block per vertex attribute,
+ * the index array and optionally the face BVH, each stored exactly as a
+ * Mesh keeps it in memory and aligned for direct access. Loading maps the
+ * file and points the mesh arrays into the mapping, so startup costs a
+ * header check and one bounds-checking pass over indices and nodes;
+ * vertex pages are only read as traversal touches them. Files are only
+ * valid on machines with the same byte order and node layout.
+ */
+
+#pragma once
+
+#include "../geometry/mesh.h"
+#include <memory>
+#include <string>
+
+namespace raytracer {
+namespace core {
+
+// Extension that selects the native format when loading meshes by name
+constexpr const char* kMeshFileExtension = ".rtmesh";
+
+/**
+ * @brief Writes a mesh in the native format
+ *
+ * Written under a temporary name and renamed into place, like BVH cache files.
+ *
+ * @param include_bvh Store the face BVH so loading needs no build
+ * @throws std::runtime_error if the file cannot be written
+ */
+void save_mesh_file(const std::string& filename, const geometry::Mesh& mesh, bool include_bvh = true);
+
+/**
+ * @brief Maps a native mesh file
+ *
+ * The mesh arrays are views into the mapping. Files stored without a
+ * face BVH are copied and built instead.
+ *
+ * @param validate Bounds-check indices, face ids and nodes; only skip this
+ *                 for files this build wrote and nothing has modified
+ * @throws std::runtime_error on a missing, truncated, corrupt or foreign file
+ */
+std::shared_ptr<geometry::Mesh> load_mesh_file(const std::string& filename,
+                                               uint32_t material, bool validate = true);
+
+/**
+ * @brief Loads a mesh of any supported format, chosen by extension
+ *
+ * Native files are mapped; OBJ and PLY files are imported and their
+ * face BVH is built.
+ *
+ * @param validate Passed on to load_mesh_file() for native files
+ * @throws std::runtime_error if the file cannot be loaded
+ */
+std::shared_ptr<geometry::Mesh> load_mesh(const std::string& filename,
+                                          uint32_t material, bool validate = true);
+
+/**
+ * @brief Converts an OBJ or PLY file to the native format, face BVH included
+ *
+ * @throws std::runtime_error if the input cannot be imported or the output written
+ */
+void convert_mesh(const std::string& input, const std::string& output);
+
+} // namespace core
+} // namespace raytracer
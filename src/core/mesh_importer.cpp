@@ -0,0 +1,717 @@
+/**
+ * @file mesh_importer.cpp
+ * @brief Chunked parallel OBJ tokenizer and binary PLY decoder
+ */
+
+#include "mesh_importer.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace raytracer {
+namespace core {
+
+namespace {
+    // Chunks below this size cost more in merging than they gain in parallelism
+    constexpr size_t kMinChunkBytes = size_t(1) << 20;
+    constexpr size_t kChunksPerThread = 4;
+
+    int max_threads() {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    bool is_blank(char c) { return c == ' ' || c == '\t'; }
+    bool is_line_end(char c) { return c == '\n' || c == '\r'; }
+
+    const char* skip_blanks(const char* p, const char* end) {
+        while (p < end && is_blank(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* next_line(const char* p, const char* end) {
+        const void* newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+        return newline ? static_cast<const char*>(newline) + 1 : end;
+    }
+
+    double power_of_ten(int exponent) {
+        // Powers up to 1e22 are exact in a double
+        static const double kExact[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        return exponent <= 22 ? kExact[exponent] : std::pow(10.0, exponent);
+    }
+
+    /**
+     * @brief Parses a decimal number without the locale and allocation of strtof
+     *
+     * Keeps 19 significant digits and scales once in double precision, which
+     * is well inside float accuracy.
+     *
+     * @return False if p does not start a number; p is left after it otherwise
+     */
+    bool parse_float(const char*& p, const char* end, float& value) {
+        const char* s = p;
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+')) {
+            negative = *s == '-';
+            ++s;
+        }
+
+        uint64_t mantissa = 0;
+        int significant_digits = 0;
+        int exponent = 0;
+        bool any_digit = false;
+        while (s < end && is_digit(*s)) {
+            if (significant_digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+                significant_digits += mantissa != 0 ? 1 : 0;
+            } else {
+                ++exponent;
+            }
+            any_digit = true;
+            ++s;
+        }
+        if (s < end && *s == '.') {
+            ++s;
+            while (s < end && is_digit(*s)) {
+                if (significant_digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+                    significant_digits += mantissa != 0 ? 1 : 0;
+                    --exponent;
+                }
+                any_digit = true;
+                ++s;
+            }
+        }
+        if (!any_digit) {
+            return false;
+        }
+
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            const char* e = s + 1;
+            bool negative_exponent = false;
+            if (e < end && (*e == '-' || *e == '+')) {
+                negative_exponent = *e == '-';
+                ++e;
+            }
+            if (e < end && is_digit(*e)) {
+                int written_exponent = 0;
+                while (e < end && is_digit(*e)) {
+                    written_exponent = std::min(written_exponent * 10 + (*e - '0'), 100000);
+                    ++e;
+                }
+                exponent += negative_exponent ? -written_exponent : written_exponent;
+                s = e;
+            }
+        }
+
+        double result = static_cast<double>(mantissa);
+        if (mantissa != 0 && exponent != 0) {
+            result = exponent < 0 ? result / power_of_ten(-exponent) : result * power_of_ten(exponent);
+        }
+        value = static_cast<float>(negative ? -result : result);
+        p = s;
+        return true;
+    }
+
+    bool parse_integer(const char*& p, const char* end, int64_t& value) {
+        const char* s = p;
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+')) {
+            negative = *s == '-';
+            ++s;
+        }
+        if (s >= end || !is_digit(*s)) {
+            return false;
+        }
+        int64_t result = 0;
+        while (s < end && is_digit(*s)) {
+            result = std::min<int64_t>(result * 10 + (*s - '0'), int64_t(1) << 40);
+            ++s;
+        }
+        value = negative ? -result : result;
+        p = s;
+        return true;
+    }
+
+    /**
+     * @brief Output of one OBJ chunk, before vertex numbering is known
+     *
+     * Relative indices count back from the chunk's running vertex count,
+     * so they are stored chunk-relative and fixed up once the number of
+     * vertices in earlier chunks is known.
+     */
+    struct ObjChunk {
+        std::vector<float> x, y, z;
+        std::vector<uint32_t> indices;
+        std::vector<std::pair<size_t, int64_t>> relative;  // (slot in indices, chunk-relative vertex)
+        std::string error;
+    };
+
+    void parse_obj_chunk(const char* data, const char* begin, const char* end, const char* file_end,
+                         ObjChunk& chunk) {
+        std::vector<int64_t> polygon;
+        std::vector<bool> polygon_relative;
+        auto fail = [&](const char* what, const char* where) {
+            chunk.error = std::string("OBJ: ") + what + " at byte " + std::to_string(where - data);
+        };
+
+        for (const char* p = begin; p < end; p = next_line(p, file_end)) {
+            p = skip_blanks(p, file_end);
+            if (p + 1 >= file_end || !is_blank(p[1])) {
+                continue;
+            }
+
+            if (*p == 'v') {
+                const char* line = p;
+                p += 2;
+                float coordinates[3];
+                for (float& coordinate : coordinates) {
+                    p = skip_blanks(p, file_end);
+                    if (!parse_float(p, file_end, coordinate)) {
+                        fail("malformed vertex", line);
+                        return;
+                    }
+                }
+                chunk.x.push_back(coordinates[0]);
+                chunk.y.push_back(coordinates[1]);
+                chunk.z.push_back(coordinates[2]);
+            } else if (*p == 'f') {
+                const char* line = p;
+                p += 2;
+                polygon.clear();
+                polygon_relative.clear();
+                const int64_t local_vertex_count = static_cast<int64_t>(chunk.x.size());
+                while (true) {
+                    p = skip_blanks(p, file_end);
+                    if (p >= file_end || is_line_end(*p) || *p == '#') {
+                        break;
+                    }
+                    int64_t index;
+                    if (!parse_integer(p, file_end, index) || index == 0) {
+                        fail("malformed face", line);
+                        return;
+                    }
+                    // Texture and normal references are not used
+                    while (p < file_end && !is_blank(*p) && !is_line_end(*p)) {
+                        ++p;
+                    }
+                    if (index > 0) {
+                        if (index - 1 > std::numeric_limits<uint32_t>::max()) {
+                            fail("vertex index out of range", line);
+                            return;
+                        }
+                        polygon.push_back(index - 1);
+                        polygon_relative.push_back(false);
+                    } else {
+                        polygon.push_back(local_vertex_count + index);
+                        polygon_relative.push_back(true);
+                    }
+                }
+                if (polygon.size() < 3) {
+                    fail("face with fewer than three vertices", line);
+                    return;
+                }
+
+                for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                    for (size_t corner : {size_t(0), i, i + 1}) {
+                        if (polygon_relative[corner]) {
+                            chunk.relative.emplace_back(chunk.indices.size(), polygon[corner]);
+                            chunk.indices.push_back(0);
+                        } else {
+                            chunk.indices.push_back(static_cast<uint32_t>(polygon[corner]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+    struct PlyProperty {
+        std::string name;
+        PlyType type = PlyType::Float32;
+        bool is_list = false;
+        PlyType count_type = PlyType::UInt8;
+    };
+
+    struct PlyElement {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> properties;
+    };
+
+    PlyType parse_ply_type(const std::string& name) {
+        if (name == "char" || name == "int8") return PlyType::Int8;
+        if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+        if (name == "short" || name == "int16") return PlyType::Int16;
+        if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+        if (name == "int" || name == "int32") return PlyType::Int32;
+        if (name == "uint" || name == "uint32") return PlyType::UInt32;
+        if (name == "float" || name == "float32") return PlyType::Float32;
+        if (name == "double" || name == "float64") return PlyType::Float64;
+        throw std::runtime_error("PLY: unknown property type " + name);
+    }
+
+    size_t ply_type_size(PlyType type) {
+        switch (type) {
+            case PlyType::Int8:
+            case PlyType::UInt8:
+                return 1;
+            case PlyType::Int16:
+            case PlyType::UInt16:
+                return 2;
+            case PlyType::Int32:
+            case PlyType::UInt32:
+            case PlyType::Float32:
+                return 4;
+            case PlyType::Float64:
+            default:
+                return 8;
+        }
+    }
+
+    template <typename T>
+    T load(const char* p, bool swap) {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, p, sizeof(T));
+        if (swap) {
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    double load_ply_value(const char* p, PlyType type, bool swap) {
+        switch (type) {
+            case PlyType::Int8: return load<int8_t>(p, swap);
+            case PlyType::UInt8: return load<uint8_t>(p, swap);
+            case PlyType::Int16: return load<int16_t>(p, swap);
+            case PlyType::UInt16: return load<uint16_t>(p, swap);
+            case PlyType::Int32: return load<int32_t>(p, swap);
+            case PlyType::UInt32: return load<uint32_t>(p, swap);
+            case PlyType::Float32: return load<float>(p, swap);
+            case PlyType::Float64:
+            default: return load<double>(p, swap);
+        }
+    }
+
+    // Integer-valued PLY data is exact in a double, so one loader serves both
+    int64_t load_ply_integer(const char* p, PlyType type, bool swap) {
+        return static_cast<int64_t>(load_ply_value(p, type, swap));
+    }
+
+    /**
+     * @brief Byte size of one record, or 0 if it contains a list
+     */
+    size_t fixed_record_size(const PlyElement& element) {
+        size_t size = 0;
+        for (const auto& property : element.properties) {
+            if (property.is_list) {
+                return 0;
+            }
+            size += ply_type_size(property.type);
+        }
+        return size;
+    }
+
+    void require(const char* p, size_t bytes, const char* end) {
+        if (bytes > static_cast<size_t>(end - p)) {
+            throw std::runtime_error("PLY: file is truncated");
+        }
+    }
+
+    const char* skip_ply_property(const char* p, const char* end, const PlyProperty& property, bool swap) {
+        if (!property.is_list) {
+            require(p, ply_type_size(property.type), end);
+            return p + ply_type_size(property.type);
+        }
+        require(p, ply_type_size(property.count_type), end);
+        int64_t count = load_ply_integer(p, property.count_type, swap);
+        p += ply_type_size(property.count_type);
+        size_t bytes = static_cast<size_t>(std::max<int64_t>(count, 0)) * ply_type_size(property.type);
+        require(p, bytes, end);
+        return p + bytes;
+    }
+
+    /**
+     * @brief Steps over one record with list properties
+     */
+    const char* skip_ply_record(const char* p, const char* end, const PlyElement& element, bool swap) {
+        for (const auto& property : element.properties) {
+            p = skip_ply_property(p, end, property, swap);
+        }
+        return p;
+    }
+
+    const char* read_ply_vertices(const char* p, const char* end, const PlyElement& element, bool swap,
+                                  MeshData& mesh) {
+        const size_t stride = fixed_record_size(element);
+        if (stride == 0) {
+            throw std::runtime_error("PLY: list properties on vertices are not supported");
+        }
+
+        // Attribute lookup by any of its conventional property names
+        struct Attribute {
+            std::vector<const char*> names;
+            std::vector<float>* target;
+            size_t offset = 0;
+            PlyType type = PlyType::Float32;
+            bool found = false;
+        };
+        Attribute attributes[] = {
+            {{"x"}, &mesh.x}, {{"y"}, &mesh.y}, {{"z"}, &mesh.z},
+            {{"nx"}, &mesh.normal_x}, {{"ny"}, &mesh.normal_y}, {{"nz"}, &mesh.normal_z},
+            {{"u", "s", "texture_u"}, &mesh.u}, {{"v", "t", "texture_v"}, &mesh.v},
+        };
+        for (auto& attribute : attributes) {
+            size_t offset = 0;
+            for (const auto& property : element.properties) {
+                for (const char* name : attribute.names) {
+                    if (!attribute.found && property.name == name) {
+                        attribute.offset = offset;
+                        attribute.type = property.type;
+                        attribute.found = true;
+                    }
+                }
+                offset += ply_type_size(property.type);
+            }
+        }
+        for (int a = 0; a < 3; a++) {
+            if (!attributes[a].found) {
+                throw std::runtime_error(std::string("PLY: vertex element has no ") + attributes[a].names[0] +
+                                         " property");
+            }
+        }
+        // Partial normals or texture coordinates are dropped
+        const bool normals = attributes[3].found && attributes[4].found && attributes[5].found;
+        const bool texture_coordinates = attributes[6].found && attributes[7].found;
+        std::vector<const Attribute*> used = {&attributes[0], &attributes[1], &attributes[2]};
+        if (normals) {
+            used.insert(used.end(), {&attributes[3], &attributes[4], &attributes[5]});
+        }
+        if (texture_coordinates) {
+            used.insert(used.end(), {&attributes[6], &attributes[7]});
+        }
+
+        require(p, element.count * stride, end);
+        for (const Attribute* attribute : used) {
+            attribute->target->resize(element.count);
+        }
+        const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(element.count);
+
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < count; ++i) {
+            const char* record = p + static_cast<size_t>(i) * stride;
+            for (const Attribute* attribute : used) {
+                (*attribute->target)[i] =
+                    static_cast<float>(load_ply_value(record + attribute->offset, attribute->type, swap));
+            }
+        }
+        return p + element.count * stride;
+    }
+
+    const char* read_ply_faces(const char* p, const char* end, const PlyElement& element, bool swap,
+                               MeshData& mesh) {
+        const PlyProperty* list = nullptr;
+        for (const auto& property : element.properties) {
+            if (property.is_list && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                list = &property;
+            }
+        }
+        if (!list) {
+            throw std::runtime_error("PLY: face element has no vertex_indices list");
+        }
+        const size_t count_size = ply_type_size(list->count_type);
+        const size_t index_size = ply_type_size(list->type);
+
+        // Triangle-only files with nothing but the index list have fixed-size
+        // records and decode in parallel
+        if (element.properties.size() == 1) {
+            const size_t stride = count_size + 3 * index_size;
+            if (element.count * stride <= static_cast<size_t>(end - p)) {
+                mesh.indices.resize(element.count * 3);
+                uint32_t* indices = mesh.indices.data();
+                const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(element.count);
+                bool triangles_only = true;
+                bool negative = false;
+
+                #pragma omp parallel for reduction(&&:triangles_only) reduction(||:negative)
+                for (std::ptrdiff_t i = 0; i < count; ++i) {
+                    const char* record = p + static_cast<size_t>(i) * stride;
+                    if (load_ply_integer(record, list->count_type, swap) != 3) {
+                        triangles_only = false;
+                        continue;
+                    }
+                    for (int corner = 0; corner < 3; corner++) {
+                        int64_t index = load_ply_integer(record + count_size + corner * index_size, list->type, swap);
+                        negative = negative || index < 0;
+                        indices[3 * i + corner] = static_cast<uint32_t>(index);
+                    }
+                }
+                // Other polygons put the records at the wrong stride, so what
+                // was read is meaningless and only triangle files can be judged
+                if (triangles_only) {
+                    if (negative) {
+                        throw std::runtime_error("PLY: negative vertex index");
+                    }
+                    return p + element.count * stride;
+                }
+                mesh.indices.clear();
+            }
+        }
+
+        // General records: polygons are fan-triangulated in one sequential pass
+        std::vector<int64_t> polygon;
+        for (size_t face = 0; face < element.count; ++face) {
+            for (const auto& property : element.properties) {
+                if (&property != list) {
+                    p = skip_ply_property(p, end, property, swap);
+                    continue;
+                }
+                require(p, count_size, end);
+                int64_t corners = load_ply_integer(p, list->count_type, swap);
+                p += count_size;
+                if (corners < 0) {
+                    throw std::runtime_error("PLY: negative list length");
+                }
+                require(p, static_cast<size_t>(corners) * index_size, end);
+                polygon.clear();
+                for (int64_t corner = 0; corner < corners; ++corner) {
+                    int64_t index = load_ply_integer(p, list->type, swap);
+                    if (index < 0) {
+                        throw std::runtime_error("PLY: negative vertex index");
+                    }
+                    polygon.push_back(index);
+                    p += index_size;
+                }
+                for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                    mesh.indices.push_back(static_cast<uint32_t>(polygon[0]));
+                    mesh.indices.push_back(static_cast<uint32_t>(polygon[i]));
+                    mesh.indices.push_back(static_cast<uint32_t>(polygon[i + 1]));
+                }
+            }
+        }
+        return p;
+    }
+
+    /**
+     * @brief Checks that every index names an existing vertex
+     */
+    void validate_indices(const MeshData& mesh, const char* format) {
+        const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(mesh.indices.size());
+        const uint32_t vertex_count = static_cast<uint32_t>(mesh.vertex_count());
+        bool out_of_range = false;
+
+        #pragma omp parallel for reduction(||:out_of_range)
+        for (std::ptrdiff_t i = 0; i < count; ++i) {
+            out_of_range = out_of_range || mesh.indices[i] >= vertex_count;
+        }
+        if (out_of_range) {
+            throw std::runtime_error(std::string(format) + ": face references a missing vertex");
+        }
+    }
+}
+
+MeshData parse_obj(const char* data, size_t size) {
+    const char* file_end = data + size;
+    size_t chunk_count = std::min(size / kMinChunkBytes + 1, static_cast<size_t>(max_threads()) * kChunksPerThread);
+
+    // Chunks start at the first line that begins inside their byte range
+    std::vector<const char*> starts(chunk_count + 1);
+    starts[0] = data;
+    for (size_t c = 1; c < chunk_count; ++c) {
+        const char* guess = std::max(data + size / chunk_count * c, starts[c - 1]);
+        starts[c] = guess == data ? data : next_line(guess - 1, file_end);
+    }
+    starts[chunk_count] = file_end;
+
+    std::vector<ObjChunk> chunks(chunk_count);
+    const std::ptrdiff_t parallel_count = static_cast<std::ptrdiff_t>(chunk_count);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (std::ptrdiff_t c = 0; c < parallel_count; ++c) {
+        parse_obj_chunk(data, starts[c], starts[c + 1], file_end, chunks[c]);
+    }
+    for (const auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(chunk.error);
+        }
+    }
+
+    std::vector<size_t> vertex_base(chunk_count + 1, 0);
+    std::vector<size_t> index_base(chunk_count + 1, 0);
+    for (size_t c = 0; c < chunk_count; ++c) {
+        vertex_base[c + 1] = vertex_base[c] + chunks[c].x.size();
+        index_base[c + 1] = index_base[c] + chunks[c].indices.size();
+    }
+    if (vertex_base[chunk_count] > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("OBJ: too many vertices");
+    }
+
+    MeshData mesh;
+    mesh.x.resize(vertex_base[chunk_count]);
+    mesh.y.resize(vertex_base[chunk_count]);
+    mesh.z.resize(vertex_base[chunk_count]);
+    mesh.indices.resize(index_base[chunk_count]);
+    bool bad_relative_index = false;
+
+    #pragma omp parallel for schedule(dynamic, 1) reduction(||:bad_relative_index)
+    for (std::ptrdiff_t c = 0; c < parallel_count; ++c) {
+        ObjChunk& chunk = chunks[c];
+        std::copy(chunk.x.begin(), chunk.x.end(), mesh.x.begin() + vertex_base[c]);
+        std::copy(chunk.y.begin(), chunk.y.end(), mesh.y.begin() + vertex_base[c]);
+        std::copy(chunk.z.begin(), chunk.z.end(), mesh.z.begin() + vertex_base[c]);
+        for (const auto& [slot, local_vertex] : chunk.relative) {
+            int64_t vertex = static_cast<int64_t>(vertex_base[c]) + local_vertex;
+            bad_relative_index = bad_relative_index || vertex < 0;
+            chunk.indices[slot] = static_cast<uint32_t>(vertex);
+        }
+        std::copy(chunk.indices.begin(), chunk.indices.end(), mesh.indices.begin() + index_base[c]);
+
+        // Release each chunk as soon as it is merged to bound peak memory
+        chunk = ObjChunk();
+    }
+    if (bad_relative_index) {
+        throw std::runtime_error("OBJ: relative index points before the first vertex");
+    }
+
+    validate_indices(mesh, "OBJ");
+    return mesh;
+}
+
+MeshData parse_ply(const char* data, size_t size) {
+    const char* end = data + size;
+    static const char kEndHeader[] = "end_header";
+    const char* header_end = std::search(data, end, kEndHeader, kEndHeader + sizeof(kEndHeader) - 1);
+    if (size < 4 || std::memcmp(data, "ply", 3) != 0 || header_end == end) {
+        throw std::runtime_error("PLY: missing header");
+    }
+
+    std::istringstream header(std::string(data, header_end));
+    std::string line;
+    std::getline(header, line);  // "ply"
+    bool big_endian = false;
+    bool have_format = false;
+    std::vector<PlyElement> elements;
+    while (std::getline(header, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            words >> format;
+            if (format == "binary_little_endian") {
+                big_endian = false;
+            } else if (format == "binary_big_endian") {
+                big_endian = true;
+            } else {
+                throw std::runtime_error("PLY: only binary files are supported, found " + format);
+            }
+            have_format = true;
+        } else if (keyword == "element") {
+            PlyElement element;
+            words >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property") {
+            if (elements.empty()) {
+                throw std::runtime_error("PLY: property outside an element");
+            }
+            PlyProperty property;
+            std::string type;
+            words >> type;
+            if (type == "list") {
+                std::string count_type, item_type;
+                words >> count_type >> item_type;
+                property.is_list = true;
+                property.count_type = parse_ply_type(count_type);
+                property.type = parse_ply_type(item_type);
+            } else {
+                property.type = parse_ply_type(type);
+            }
+            words >> property.name;
+            elements.back().properties.push_back(property);
+        }
+    }
+    if (!have_format) {
+        throw std::runtime_error("PLY: missing format line");
+    }
+
+    uint16_t probe = 1;
+    unsigned char first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    const bool swap = big_endian == (first_byte == 1);
+
+    MeshData mesh;
+    bool have_vertices = false;
+    const char* p = next_line(header_end, end);
+    for (const auto& element : elements) {
+        if (element.name == "vertex") {
+            p = read_ply_vertices(p, end, element, swap, mesh);
+            have_vertices = true;
+        } else if (element.name == "face") {
+            p = read_ply_faces(p, end, element, swap, mesh);
+        } else if (size_t stride = fixed_record_size(element)) {
+            require(p, element.count * stride, end);
+            p += element.count * stride;
+        } else {
+            for (size_t i = 0; i < element.count; ++i) {
+                p = skip_ply_record(p, end, element, swap);
+            }
+        }
+    }
+    if (!have_vertices) {
+        throw std::runtime_error("PLY: no vertex element");
+    }
+
+    validate_indices(mesh, "PLY");
+    return mesh;
+}
+
+MeshData import_mesh(const std::string& filename) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    std::string extension = std::filesystem::path(filename).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension != ".obj" && extension != ".ply") {
+        throw std::runtime_error("Unsupported mesh format: " + filename);
+    }
+
+    auto file = MappedFile::open(filename);
+    const char* data = reinterpret_cast<const char*>(file->data());
+    MeshData mesh = extension == ".obj" ? parse_obj(data, file->size()) : parse_ply(data, file->size());
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    const double seconds = std::max(elapsed.count(), 1e-9);
+    const double megabytes = file->size() / (1024.0 * 1024.0);
+    std::cout << "Imported " << filename << ": " << mesh.triangle_count() << " triangles, "
+              << mesh.vertex_count() << " vertices, " << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+              << megabytes / seconds << " MB/s, " << mesh.triangle_count() / seconds / 1e6
+              << " M triangles/s)" << std::endl;
+    return mesh;
+}
+
+} // namespace core
+} // namespace raytracer
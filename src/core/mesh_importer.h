@@ -0,0 +1,68 @@
+/**
+ * @file mesh_importer.h
+ * @brief Memory-mapped OBJ and binary PLY triangle mesh import
+ *
+ * Files are mapped rather than read and parsed straight out of the
+ * mapping. OBJ text is split into chunks at line boundaries that are
+ * tokenized in parallel, each into its own vertex and index arrays, which
+ * are then concatenated; no per-line strings are allocated. Binary PLY
+ * element blocks are decoded in parallel where records have a fixed size.
+ * Polygons are fan-triangulated. PLY vertex normals and texture
+ * coordinates are kept; OBJ indexes them separately from positions, so
+ * they are skipped there along with all other attributes.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raytracer {
+namespace core {
+
+/**
+ * @brief Indexed triangles in the layout geometry::Mesh adopts
+ */
+struct MeshData {
+    std::vector<float> x, y, z;                         // Coordinates per vertex
+    std::vector<float> normal_x, normal_y, normal_z;    // Optional normal per vertex
+    std::vector<float> u, v;                            // Optional texture coordinates per vertex
+    std::vector<uint32_t> indices;                      // Three vertex indices per triangle
+
+    size_t vertex_count() const { return x.size(); }
+    size_t triangle_count() const { return indices.size() / 3; }
+};
+
+/**
+ * @brief Loads an OBJ or PLY file, chosen by extension, and prints the
+ *        parse throughput
+ *
+ * @throws std::runtime_error if the file cannot be mapped or parsed
+ */
+MeshData import_mesh(const std::string& filename);
+
+/**
+ * @brief Parses Wavefront OBJ text
+ *
+ * Supports "v" and "f" records with absolute or negative (relative)
+ * indices in any of the v, v/vt, v//vn and v/vt/vn forms.
+ *
+ * @throws std::runtime_error on malformed records or out-of-range indices
+ */
+MeshData parse_obj(const char* data, size_t size);
+
+/**
+ * @brief Parses a binary (little- or big-endian) PLY file
+ *
+ * Reads x, y, z and, if present, nx, ny, nz and u, v (or s, t) of the
+ * "vertex" element and the vertex_indices list of the "face" element;
+ * all other elements and properties are skipped.
+ *
+ * @throws std::runtime_error on ASCII PLY, malformed headers or truncated data
+ */
+MeshData parse_ply(const char* data, size_t size);
+
+} // namespace core
+} // namespace raytracer
@@ -0,0 +1,99 @@
+/**
+ * @file point_file.cpp
+ * @brief Point file reading
+ */
+
+#include "point_file.h"
+#include "mapped_file.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace raytracer {
+namespace core {
+
+namespace {
+    constexpr char kMagic[8] = {'R', 'T', 'P', 'O', 'I', 'N', 'T', 'S'};
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kByteOrderMark = 0x01020304;
+
+    struct PointFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t count;
+    };
+
+    static_assert(sizeof(PointFileHeader) == 32, "Point file header must stay 32 bytes");
+
+    size_t record_size(uint32_t flags) {
+        return 3 * sizeof(float) + ((flags & kPointRadius) ? sizeof(float) : 0) +
+               ((flags & kPointMaterial) ? sizeof(uint32_t) : 0);
+    }
+}
+
+PointData load_point_file(const std::string& filename) {
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto file = MappedFile::open(filename);
+    if (file->size() < sizeof(PointFileHeader)) {
+        throw std::runtime_error("Not a point file: " + filename);
+    }
+    PointFileHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a point file: " + filename);
+    }
+    if (header.version != kVersion || header.byte_order != kByteOrderMark) {
+        throw std::runtime_error("Point file has an unsupported version or byte order: " + filename);
+    }
+
+    const size_t stride = record_size(header.flags);
+    if (header.count > (file->size() - sizeof(PointFileHeader)) / stride) {
+        throw std::runtime_error("Point file is truncated: " + filename);
+    }
+
+    const size_t count = static_cast<size_t>(header.count);
+    const bool has_radius = (header.flags & kPointRadius) != 0;
+    const bool has_material = (header.flags & kPointMaterial) != 0;
+    PointData points;
+    points.x.resize(count);
+    points.y.resize(count);
+    points.z.resize(count);
+    if (has_radius) {
+        points.radius.resize(count);
+    }
+    if (has_material) {
+        points.material_indices.resize(count);
+    }
+
+    // Records are not aligned for direct access, so every field is copied
+    const unsigned char* records = file->data() + sizeof(PointFileHeader);
+    const std::ptrdiff_t record_count = static_cast<std::ptrdiff_t>(count);
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t i = 0; i < record_count; ++i) {
+        const unsigned char* record = records + static_cast<size_t>(i) * stride;
+        std::memcpy(&points.x[i], record, sizeof(float));
+        std::memcpy(&points.y[i], record + 4, sizeof(float));
+        std::memcpy(&points.z[i], record + 8, sizeof(float));
+        size_t offset = 12;
+        if (has_radius) {
+            std::memcpy(&points.radius[i], record + offset, sizeof(float));
+            offset += sizeof(float);
+        }
+        if (has_material) {
+            std::memcpy(&points.material_indices[i], record + offset, sizeof(uint32_t));
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_time;
+    std::cout << "Loaded " << filename << ": " << count << " points in " << elapsed.count() << " ms" << std::endl;
+    return points;
+}
+
+} // namespace core
+} // namespace raytracer
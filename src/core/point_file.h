@@ -0,0 +1,46 @@
+/**
+ * @file point_file.h
+ * @brief Binary point files holding sphere centers, radii and material indices
+ *
+ * Layout: a 32-byte header (magic "RTPOINTS", version, byte-order mark,
+ * flags, point count) followed by one record per point: x, y, z as
+ * floats, then a float radius if kPointRadius is set and a uint32
+ * material index if kPointMaterial is set. Records are what particle
+ * exporters write naturally; loading maps the file and splits them into
+ * the SoA arrays a geometry::SphereSet adopts.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raytracer {
+namespace core {
+
+// Flags of the point file header
+constexpr uint32_t kPointRadius = 1u << 0;
+constexpr uint32_t kPointMaterial = 1u << 1;
+
+/**
+ * @brief Points in SoA form; radii and material indices may be empty
+ */
+struct PointData {
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+    std::vector<uint32_t> material_indices;
+
+    size_t size() const { return x.size(); }
+};
+
+/**
+ * @brief Maps a point file and splits its records into arrays
+ *
+ * @throws std::runtime_error on a missing, truncated or foreign file
+ */
+PointData load_point_file(const std::string& filename);
+
+} // namespace core
+} // namespace raytracer
@@ -9,18 +9,37 @@ class Ray {
 public:
     Ray() = default;
     Ray(const Point3& origin, const Vec3& direction) 
-        : origin_(origin), direction_(direction) {}
+        : origin_(origin), direction_(direction), inv_direction_(1.0f / direction) {
+        for (int a = 0; a < 3; a++) {
+            sign_[a] = inv_direction_[a] < 0.0f ? 1 : 0;
+        }
+    }
 
-    Point3 origin() const { return origin_; }
-    Vec3 direction() const { return direction_; }
+    const Point3& origin() const { return origin_; }
+    const Vec3& direction() const { return direction_; }
+    
+    /**
+     * @brief Per-axis reciprocal of the direction, computed once for all box tests
+     */
+    const Vec3& inv_direction() const { return inv_direction_; }
+    
+    /**
+     * @brief 1 if the direction is negative along an axis, else 0
+     * 
+     * Indexes the near plane of an ordered slab test: bounds[sign] is
+     * entered first and bounds[1 - sign] is left last.
+     */
+    int sign(int axis) const { return sign_[axis]; }
     
     Point3 at(float t) const {
         return origin_ + t * direction_;
     }
 
 private:
-    Point3 origin_;
-    Vec3 direction_;
+    Point3 origin_{0.0f};
+    Vec3 direction_{0.0f};
+    Vec3 inv_direction_{0.0f};
+    int sign_[3] = {0, 0, 0};
 };
 
 } // namespace core
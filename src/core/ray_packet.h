@@ -0,0 +1,56 @@
+/**
+ * @file ray_packet.h
+ * @brief Small group of coherent rays traced together
+ * 
+ * Camera rays through neighbouring pixels of a pinhole camera share an
+ * origin and point in nearly the same direction. Tracing them as a packet
+ * lets one bounding-volume test cull a node for all of them at once.
+ */
+
+#pragma once
+
+#include "ray.h"
+
+namespace raytracer {
+namespace core {
+
+struct RayPacket {
+    // One 4x4 pixel tile
+    static constexpr int kMaxSize = 16;
+
+    Ray rays[kMaxSize];
+    int size = 0;
+
+    void add(const Ray& ray) { rays[size++] = ray; }
+
+    /**
+     * @brief True if all rays share one origin and, per axis, one nonzero
+     *        direction sign
+     * 
+     * Only then do the rays' inverse directions form a finite interval per
+     * axis, which packet traversal relies on; other packets must be traced
+     * ray by ray.
+     */
+    bool is_coherent() const {
+        if (size == 0) {
+            return false;
+        }
+        const Point3 origin = rays[0].origin();
+        const Vec3 first = rays[0].direction();
+        for (int i = 0; i < size; i++) {
+            const Vec3 direction = rays[i].direction();
+            if (rays[i].origin() != origin) {
+                return false;
+            }
+            for (int a = 0; a < 3; a++) {
+                if (!(direction[a] * first[a] > 0.0f)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace core
+} // namespace raytracer
@@ -1,10 +1,12 @@
 #include "scene.h"
+#include <iostream>
 
 namespace raytracer {
 namespace core {
 
 void Scene::add(std::shared_ptr<geometry::Primitive> object) {
     objects_.push_back(object);
+    acceleration_dirty_ = true;
 }
 
 void Scene::add_light(std::shared_ptr<Light> light) {
@@ -14,22 +16,151 @@ void Scene::add_light(std::shared_ptr<Light> light) {
 void Scene::clear() {
     objects_.clear();
     lights_.clear();
+    materials_.clear();
+    bvh_.reset();
+    unbounded_objects_.clear();
+    acceleration_dirty_ = false;
+}
+
+void Scene::build_acceleration() {
+    rebuild_acceleration();
+}
+
+bool Scene::refit_acceleration() {
+    // Trees rebuilt mid-animation are unlikely to recur, so they bypass the cache
+    if (acceleration_dirty_ || !bvh_) {
+        rebuild_acceleration(false);
+        return true;
+    }
+    
+    bvh_->refit();
+    if (bvh_->needs_rebuild()) {
+        std::cout << "BVH SAH cost grew from " << bvh_->build_sah_cost() << " to " << bvh_->sah_cost()
+                  << " after refit, rebuilding" << std::endl;
+        rebuild_acceleration(false);
+        return true;
+    }
+    return false;
+}
+
+void Scene::set_bvh_settings(const acceleration::BVHBuildSettings& settings) {
+    bvh_settings_ = settings;
+    acceleration_dirty_ = true;
+}
+
+void Scene::rebuild_acceleration(bool use_cache) const {
+    // Unbounded primitives (infinite planes) would stretch the root box to
+    // infinity, so they stay in a short list that is tested separately
+    std::vector<std::shared_ptr<geometry::Primitive>> bounded;
+    unbounded_objects_.clear();
+    for (const auto& object : objects_) {
+        acceleration::AABB box;
+        if (object->bounding_box(box)) {
+            bounded.push_back(object);
+        } else {
+            unbounded_objects_.push_back(object);
+        }
+    }
+
+    acceleration::BVHBuildSettings settings = bvh_settings_;
+    if (!use_cache) {
+        settings.cache_directory.clear();
+    }
+    bvh_ = bounded.empty() ? nullptr : std::make_shared<acceleration::BVHAccel>(bounded, settings);
+    acceleration_dirty_ = false;
+    
+    if (bvh_) {
+        const char* mode = "quality";
+        if (bvh_settings_.mode == acceleration::BVHBuildMode::Fast) {
+            mode = "fast";
+        } else if (bvh_settings_.mode == acceleration::BVHBuildMode::HighQuality) {
+            mode = "high quality";
+        }
+        const char* action = bvh_->loaded_from_cache() ? "loaded from cache" : "built";
+        std::cout << "BVH (" << mode << ") " << action << " over " << bvh_->primitive_count()
+                  << " primitives in " << bvh_->build_time_ms() << " ms" << std::endl;
+        if (bvh_->unoptimized_sah_cost() > 0.0f) {
+            std::cout << "Treelet optimization: SAH cost " << bvh_->unoptimized_sah_cost() << " -> "
+                      << bvh_->build_sah_cost() << std::endl;
+        }
+    }
+}
+
+const acceleration::BVHAccel* Scene::acceleration() const {
+    if (acceleration_dirty_) {
+        rebuild_acceleration();
+    }
+    return bvh_.get();
 }
 
 bool Scene::hit(const Ray& ray, float t_min, float t_max, geometry::HitRecord& rec) const {
-    geometry::HitRecord temp_rec;
+    if (acceleration_dirty_) {
+        rebuild_acceleration();
+    }
+
+    // Surface data is computed once, for the closest hit over everything
+    geometry::SurfaceHit hit;
     bool hit_anything = false;
     auto closest_so_far = t_max;
 
-    for (const auto& object : objects_) {
-        if (object->hit(ray, t_min, closest_so_far, temp_rec)) {
+    if (bvh_ && bvh_->find_hit(ray, t_min, closest_so_far, hit)) {
+        hit_anything = true;
+        closest_so_far = hit.t;
+    }
+
+    for (const auto& object : unbounded_objects_) {
+        if (object->find_hit(ray, t_min, closest_so_far, hit)) {
             hit_anything = true;
-            closest_so_far = temp_rec.t;
-            rec = temp_rec;
+            closest_so_far = hit.t;
+        }
+    }
+
+    return hit_anything && hit.complete(ray, rec);
+}
+
+uint32_t Scene::hit_packet(const RayPacket& packet, float t_min, float t_max, geometry::HitRecord* records) const {
+    if (acceleration_dirty_) {
+        rebuild_acceleration();
+    }
+
+    float closest_so_far[RayPacket::kMaxSize];
+    for (int i = 0; i < packet.size; i++) {
+        closest_so_far[i] = t_max;
+    }
+
+    geometry::SurfaceHit hits[RayPacket::kMaxSize];
+    uint32_t hit_mask = bvh_ ? bvh_->find_hit_packet(packet, t_min, closest_so_far, hits) : 0;
+
+    for (const auto& object : unbounded_objects_) {
+        for (int i = 0; i < packet.size; i++) {
+            if (object->find_hit(packet.rays[i], t_min, closest_so_far[i], hits[i])) {
+                hit_mask |= 1u << i;
+                closest_so_far[i] = hits[i].t;
+            }
+        }
+    }
+
+    for (int i = 0; i < packet.size; i++) {
+        if ((hit_mask & (1u << i)) && !hits[i].complete(packet.rays[i], records[i])) {
+            hit_mask &= ~(1u << i);
+        }
+    }
+    return hit_mask;
+}
+
+bool Scene::occluded(const Ray& ray, float t_min, float t_max) const {
+    if (acceleration_dirty_) {
+        rebuild_acceleration();
+    }
+
+    // The few unbounded objects are cheap and often block large solid angles
+    for (const auto& object : unbounded_objects_) {
+        if (object->occluded(ray, t_min, t_max)) {
+            return true;
         }
     }
 
-    return hit_anything;
+    return bvh_ && bvh_->occluded(ray, t_min, t_max);
 }
 
 } // namespace core
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "../geometry/primitive.h"
+#include "../acceleration/bvh_accel.h"
+#include "../materials/material_table.h"
 #include "light.h"
+#include "ray_packet.h"
 #include <vector>
 #include <memory>
 
@@ -16,12 +19,94 @@ public:
     void add_light(std::shared_ptr<Light> light);
     void clear();
     
+    /**
+     * @brief Adds a material for primitives to refer to
+     * 
+     * @return Index to pass to primitive constructors
+     */
+    uint32_t add_material(std::shared_ptr<materials::Material> material) { return materials_.add(std::move(material)); }
+    
+    /**
+     * @brief The materials that hit records index via HitRecord::material_index
+     */
+    const materials::MaterialTable& materials() const { return materials_; }
+    materials::MaterialTable& materials() { return materials_; }
+    
+    /**
+     * @brief Builds the BVH over all bounded objects added so far
+     * 
+     * hit() rebuilds lazily after objects change, but calling this once
+     * after loading keeps the build out of the first traced ray and must
+     * be done before the scene is queried from several threads.
+     */
+    void build_acceleration();
+    
+    /**
+     * @brief Updates the BVH after objects moved, keeping its topology
+     * 
+     * Much cheaper than a rebuild for per-frame edits and animation. Falls
+     * back to a full rebuild when objects were added since the last build
+     * or when the refitted tree's SAH cost has degraded past
+     * BVHBuildSettings::rebuild_cost_ratio.
+     * 
+     * @return True if a full rebuild was performed
+     */
+    bool refit_acceleration();
+    
+    /**
+     * @brief Sets the BVH build options; takes effect on the next build
+     */
+    void set_bvh_settings(const acceleration::BVHBuildSettings& settings);
+    const acceleration::BVHBuildSettings& bvh_settings() const { return bvh_settings_; }
+    
+    /**
+     * @brief Duration of the most recent BVH build in milliseconds (0 if none)
+     */
+    double acceleration_build_time_ms() const { return bvh_ ? bvh_->build_time_ms() : 0.0; }
+    
+    /**
+     * @brief The BVH over all bounded objects, rebuilt first if objects changed
+     * 
+     * @return Null if the scene has no bounded objects
+     */
+    const acceleration::BVHAccel* acceleration() const;
+    
     bool hit(const Ray& ray, float t_min, float t_max, geometry::HitRecord& rec) const;
+    
+    /**
+     * @brief hit() for every ray of a packet, sharing BVH traversal where the
+     *        packet is coherent
+     * 
+     * @param records Receives the hit record of every ray that hits
+     * @return Bit mask of the rays that hit
+     */
+    uint32_t hit_packet(const RayPacket& packet, float t_min, float t_max, geometry::HitRecord* records) const;
+    
+    /**
+     * @brief Shadow-ray query: true if anything lies on the ray within [t_min, t_max]
+     * 
+     * Stops at the first intersection found and computes no surface data,
+     * so it is much cheaper than hit() when only visibility matters.
+     */
+    bool occluded(const Ray& ray, float t_min, float t_max) const;
     const std::vector<std::shared_ptr<Light>>& lights() const { return lights_; }
 
 private:
     std::vector<std::shared_ptr<geometry::Primitive>> objects_;
     std::vector<std::shared_ptr<Light>> lights_;
+    materials::MaterialTable materials_;
+    
+    acceleration::BVHBuildSettings bvh_settings_;
+    
+    // Acceleration state, derived from objects_ on demand
+    mutable std::shared_ptr<acceleration::BVHAccel> bvh_;
+    mutable std::vector<std::shared_ptr<geometry::Primitive>> unbounded_objects_;
+    mutable bool acceleration_dirty_ = false;
+    
+    /**
+     * @param use_cache False to skip the on-disk BVH cache even if configured
+     */
+    void rebuild_acceleration(bool use_cache = true) const;
 };
 
 } // namespace core
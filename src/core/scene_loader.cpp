@@ -4,9 +4,16 @@
  */
 
 #include "scene_loader.h"
+#include "mesh_file.h"
+#include "point_file.h"
 #include "../geometry/sphere.h"
+#include "../geometry/sphere_set.h"
 #include "../geometry/plane.h"
 #include "../geometry/triangle.h"
+#include "../geometry/quad.h"
+#include "../geometry/box.h"
+#include "../geometry/instance.h"
+#include "../geometry/mesh.h"
 #include "../materials/lambertian.h"
 #include "../materials/textured_lambertian.h"
 #include "../materials/metal.h"
@@ -16,6 +23,7 @@
 #include "../textures/checker_texture.h"
 #include "../textures/normal_map.h"
 #include "../common.h"
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -40,11 +48,24 @@ Scene SceneLoader::load_scene(const std::string& filename) {
     
     Scene scene;
     
+    std::string scene_directory = std::filesystem::path(filename).parent_path().string();
+    scene.set_bvh_settings(load_bvh_settings(scene_json.value("acceleration", nlohmann::json::object()),
+                                             scene_directory));
+    
+    // Shared geometry referenced by instances
+    AssetMap assets;
+    if (scene_json.contains("assets")) {
+        assets = load_assets(scene_json["assets"], scene.bvh_settings(), scene.materials(), scene_directory);
+    }
+    
     // Load objects
     if (scene_json.contains("objects")) {
         for (const auto& object_json : scene_json["objects"]) {
-            auto primitive = create_primitive(object_json);
-            scene.add(primitive);
+            if (object_json.value("type", "") == "instance") {
+                scene.add(create_instance(object_json, assets));
+            } else {
+                scene.add(create_primitive(object_json, scene.materials(), scene_directory));
+            }
         }
     }
     
@@ -56,6 +77,8 @@ Scene SceneLoader::load_scene(const std::string& filename) {
         }
     }
     
+    scene.build_acceleration();
+    
     return scene;
 }
 
@@ -71,9 +94,126 @@ Camera SceneLoader::load_camera(const nlohmann::json& camera_json) {
     return Camera(position, look_at, vup, vfov, aspect_ratio, aperture, focus_distance);
 }
 
-std::shared_ptr<geometry::Primitive> SceneLoader::create_primitive(const nlohmann::json& object_json) {
+acceleration::BVHBuildSettings SceneLoader::load_bvh_settings(const nlohmann::json& acceleration_json,
+                                                              const std::string& scene_directory) {
+    acceleration::BVHBuildSettings settings;
+    
+    // Cached trees go next to the scene unless redirected or disabled
+    std::filesystem::path cache_directory = std::filesystem::path(scene_directory) / ".bvhcache";
+    if (acceleration_json.contains("cache")) {
+        const auto& cache_json = acceleration_json["cache"];
+        if (cache_json.is_boolean()) {
+            if (!cache_json.get<bool>()) {
+                cache_directory.clear();
+            }
+        } else {
+            cache_directory = std::filesystem::path(scene_directory) / cache_json.get<std::string>();
+        }
+    }
+    settings.cache_directory = cache_directory.string();
+    
+    if (acceleration_json.contains("build")) {
+        std::string mode = acceleration_json["build"];
+        if (mode == "fast") {
+            settings.mode = acceleration::BVHBuildMode::Fast;
+        } else if (mode == "quality") {
+            settings.mode = acceleration::BVHBuildMode::Quality;
+        } else if (mode == "high_quality") {
+            settings.mode = acceleration::BVHBuildMode::HighQuality;
+        } else {
+            throw std::runtime_error("Unknown BVH build mode: " + mode);
+        }
+    }
+    
+    if (acceleration_json.contains("refine")) {
+        settings.refine_upper_levels = acceleration_json["refine"];
+    }
+    
+    if (acceleration_json.contains("spatial_splits")) {
+        settings.spatial_splits = acceleration_json["spatial_splits"];
+    }
+    
+    if (acceleration_json.contains("spatial_split_budget")) {
+        settings.spatial_split_budget = acceleration_json["spatial_split_budget"];
+    }
+    
+    if (acceleration_json.contains("treelet_size")) {
+        settings.treelet_size = acceleration_json["treelet_size"];
+    }
+    
+    if (acceleration_json.contains("layout")) {
+        std::string layout = acceleration_json["layout"];
+        if (layout == "binary") {
+            settings.layout = acceleration::BVHLayout::Binary;
+        } else if (layout == "wide4") {
+            settings.layout = acceleration::BVHLayout::Wide4;
+        } else if (layout == "wide8") {
+            settings.layout = acceleration::BVHLayout::Wide8;
+        } else if (layout == "quantized4") {
+            settings.layout = acceleration::BVHLayout::Quantized4;
+        } else if (layout == "quantized8") {
+            settings.layout = acceleration::BVHLayout::Quantized8;
+        } else {
+            throw std::runtime_error("Unknown BVH layout: " + layout);
+        }
+    }
+    
+    if (settings.spatial_splits && settings.mode == acceleration::BVHBuildMode::Fast) {
+        std::cerr << "Warning: spatial_splits applies to the quality build modes only and is ignored by "
+                     "the fast build" << std::endl;
+    }
+    
+    return settings;
+}
+
+SceneLoader::AssetMap SceneLoader::load_assets(const nlohmann::json& assets_json,
+                                               const acceleration::BVHBuildSettings& settings,
+                                               materials::MaterialTable& materials,
+                                               const std::string& scene_directory) {
+    AssetMap assets;
+    for (const auto& [name, asset_json] : assets_json.items()) {
+        std::vector<std::shared_ptr<geometry::Primitive>> primitives;
+        for (const auto& object_json : asset_json["objects"]) {
+            primitives.push_back(create_primitive(object_json, materials, scene_directory));
+        }
+        assets[name] = std::make_shared<acceleration::BVHAccel>(primitives, settings);
+    }
+    return assets;
+}
+
+std::shared_ptr<geometry::Primitive> SceneLoader::create_instance(const nlohmann::json& instance_json,
+                                                                  const AssetMap& assets) {
+    std::string name = instance_json["asset"];
+    auto asset = assets.find(name);
+    if (asset == assets.end()) {
+        throw std::runtime_error("Unknown asset: " + name);
+    }
+    
+    geometry::Transform transform;
+    if (instance_json.contains("scale")) {
+        const auto& scale_json = instance_json["scale"];
+        Vec3 factors = scale_json.is_number() ? Vec3(scale_json.get<float>()) : parse_vec3(scale_json);
+        transform = geometry::Transform::scale(factors) * transform;
+    }
+    if (instance_json.contains("rotate")) {
+        const auto& rotate_json = instance_json["rotate"];
+        transform = geometry::Transform::rotate(rotate_json["angle"], parse_vec3(rotate_json["axis"])) * transform;
+    }
+    if (instance_json.contains("translate")) {
+        transform = geometry::Transform::translate(parse_vec3(instance_json["translate"])) * transform;
+    }
+    
+    return std::make_shared<geometry::Instance>(asset->second, transform);
+}
+
+std::shared_ptr<geometry::Primitive> SceneLoader::create_primitive(const nlohmann::json& object_json,
+                                                                   materials::MaterialTable& materials,
+                                                                   const std::string& scene_directory) {
     std::string type = object_json["type"];
-    auto material = create_material(object_json["material"]);
+    if (type == "sphere_set") {
+        return create_sphere_set(object_json, materials, scene_directory);
+    }
+    uint32_t material = materials.add(create_material(object_json["material"]));
     
     if (type == "sphere") {
         Point3 center = parse_vec3(object_json["center"]);
@@ -91,11 +231,103 @@ std::shared_ptr<geometry::Primitive> SceneLoader::create_primitive(const nlohman
         Point3 v2 = parse_vec3(object_json["v2"]);
         return std::make_shared<geometry::Triangle>(v0, v1, v2, material);
     }
+    else if (type == "quad") {
+        Point3 corner = parse_vec3(object_json["corner"]);
+        Vec3 u = parse_vec3(object_json["u"]);
+        Vec3 v = parse_vec3(object_json["v"]);
+        if (glm::length(glm::cross(u, v)) <= 0.0f) {
+            throw std::runtime_error("Quad edges must not be parallel");
+        }
+        return std::make_shared<geometry::Quad>(corner, u, v, material);
+    }
+    else if (type == "box") {
+        Point3 min = parse_vec3(object_json["min"]);
+        Point3 max = parse_vec3(object_json["max"]);
+        return std::make_shared<geometry::Box>(min, max, material);
+    }
+    else if (type == "mesh") {
+        std::shared_ptr<geometry::Mesh> mesh;
+        if (object_json.contains("file")) {
+            // Relative to the scene file, like the BVH cache directory
+            std::filesystem::path file =
+                std::filesystem::path(scene_directory) / object_json["file"].get<std::string>();
+            mesh = load_mesh(file.string(), material, object_json.value("validate", true));
+        } else {
+            std::vector<Point3> vertices;
+            for (const auto& vertex_json : object_json["vertices"]) {
+                vertices.push_back(parse_vec3(vertex_json));
+            }
+            std::vector<std::array<int, 3>> faces;
+            for (const auto& face_json : object_json["faces"]) {
+                if (!face_json.is_array() || face_json.size() != 3) {
+                    throw std::runtime_error("Invalid mesh face - expected [i, j, k] array");
+                }
+                faces.push_back({face_json[0], face_json[1], face_json[2]});
+            }
+            mesh = std::make_shared<geometry::Mesh>(vertices, faces, material);
+        }
+
+        std::string intersection = object_json.value("intersection", "moller_trumbore");
+        if (intersection == "precomputed") {
+            mesh->set_triangle_test(geometry::TriangleTest::Precomputed);
+        } else if (intersection == "watertight") {
+            mesh->set_triangle_test(geometry::TriangleTest::Watertight);
+        } else if (intersection == "grouped") {
+            mesh->set_triangle_test(geometry::TriangleTest::Grouped);
+        } else if (intersection != "moller_trumbore") {
+            throw std::runtime_error("Unknown mesh intersection test: " + intersection);
+        }
+        return mesh;
+    }
     else {
         throw std::runtime_error("Unknown primitive type: " + type);
     }
 }
 
+std::shared_ptr<geometry::Primitive> SceneLoader::create_sphere_set(const nlohmann::json& set_json,
+                                                                    materials::MaterialTable& materials,
+                                                                    const std::string& scene_directory) {
+    std::vector<uint32_t> palette;
+    if (set_json.contains("materials")) {
+        for (const auto& material_json : set_json["materials"]) {
+            palette.push_back(materials.add(create_material(material_json)));
+        }
+    } else {
+        palette.push_back(materials.add(create_material(set_json["material"])));
+    }
+
+    PointData points;
+    if (set_json.contains("file")) {
+        std::filesystem::path file = std::filesystem::path(scene_directory) / set_json["file"].get<std::string>();
+        points = load_point_file(file.string());
+    } else {
+        for (const auto& center_json : set_json["centers"]) {
+            Point3 center = parse_vec3(center_json);
+            points.x.push_back(center.x);
+            points.y.push_back(center.y);
+            points.z.push_back(center.z);
+        }
+        if (set_json.contains("radii")) {
+            points.radius = set_json["radii"].get<std::vector<float>>();
+        }
+        if (set_json.contains("material_indices")) {
+            points.material_indices = set_json["material_indices"].get<std::vector<uint32_t>>();
+        }
+    }
+
+    // A uniform radius fills in for points that carry none
+    if (points.radius.empty()) {
+        if (!set_json.contains("radius")) {
+            throw std::runtime_error("Sphere set needs \"radius\" when its points carry no radii");
+        }
+        points.radius.assign(points.size(), set_json["radius"].get<float>());
+    }
+
+    return std::make_shared<geometry::SphereSet>(std::move(points.x), std::move(points.y), std::move(points.z),
+                                                 std::move(points.radius), std::move(points.material_indices),
+                                                 std::move(palette));
+}
+
 std::shared_ptr<materials::Material> SceneLoader::create_material(const nlohmann::json& material_json) {
     std::string type = material_json["type"];
     
@@ -12,10 +12,12 @@
 #include "camera.h"
 #include "../geometry/primitive.h"
 #include "../materials/material.h"
+#include "../materials/material_table.h"
 #include "../textures/texture.h"
 #include "../textures/normal_map.h"
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 // Include JSON library
 #include "../../external/json.hpp"
@@ -43,13 +45,91 @@ public:
     static Camera load_camera(const nlohmann::json& camera_json);
 
 private:
+    using AssetMap = std::unordered_map<std::string, std::shared_ptr<const acceleration::BVHAccel>>;
+    
+    /**
+     * @brief Builds a bottom-level BVH for every entry of the "assets" block
+     * 
+     * Each asset is an object with an "objects" array in the same format as
+     * the scene's; it is built once and shared by all instances of it.
+     * 
+     * @param assets_json JSON object mapping asset names to asset definitions
+     * @param settings Build options for the asset BVHs
+     * @param materials Scene table that receives the assets' materials
+     * @param scene_directory Directory of the scene file, for relative file paths
+     * @return Asset BVHs by name
+     */
+    static AssetMap load_assets(const nlohmann::json& assets_json, const acceleration::BVHBuildSettings& settings,
+                                materials::MaterialTable& materials, const std::string& scene_directory);
+    
+    /**
+     * @brief Creates an instance of a named asset
+     * 
+     * The optional "scale" (number or [x, y, z]), "rotate" ({"axis", "angle"}
+     * in degrees) and "translate" keys are applied in that order.
+     * 
+     * @param instance_json JSON object containing instance parameters
+     * @param assets Assets loaded from the scene file
+     * @return Created instance
+     * @throws std::runtime_error if the asset is unknown
+     */
+    static std::shared_ptr<geometry::Primitive> create_instance(const nlohmann::json& instance_json, const AssetMap& assets);
+    
+    /**
+     * @brief Reads BVH build options from the optional "acceleration" block
+     * 
+     * Recognized keys: "build" ("fast", "quality" or "high_quality"),
+     * "refine" (bool), "spatial_splits" (bool), "spatial_split_budget"
+     * (fraction of extra references), "treelet_size" (5 to 7 leaves),
+     * "layout" ("binary", "wide4", "wide8", "quantized4" or "quantized8")
+     * and "cache" (false, or a directory relative to the scene file).
+     * Built trees are cached in ".bvhcache" next to the scene file by default.
+     * 
+     * @param acceleration_json JSON object containing acceleration options
+     * @param scene_directory Directory of the scene file
+     * @return Settings with unspecified options left at their defaults
+     * @throws std::runtime_error on an unknown build mode or layout
+     */
+    static acceleration::BVHBuildSettings load_bvh_settings(const nlohmann::json& acceleration_json,
+                                                            const std::string& scene_directory);
+    
     /**
      * @brief Creates a primitive object from JSON configuration
      * 
+     * Supported types: "sphere" (center, radius), "plane" (point, normal;
+     * infinite, tested outside the BVH), "triangle" (v0, v1, v2), "quad"
+     * (corner and edges u, v), "box" (min, max corners), "mesh" and
+     * "sphere_set" (see create_sphere_set). A mesh "file" is resolved
+     * against the scene directory unless it is absolute.
+     * 
      * @param object_json JSON object containing primitive parameters
+     * @param materials Scene table that receives the primitive's material
+     * @param scene_directory Directory of the scene file
      * @return Created primitive object
+     * @throws std::runtime_error on an unknown type or degenerate quad
+     */
+    static std::shared_ptr<geometry::Primitive> create_primitive(const nlohmann::json& object_json,
+                                                                 materials::MaterialTable& materials,
+                                                                 const std::string& scene_directory);
+    
+    /**
+     * @brief Creates a sphere set from JSON configuration
+     * 
+     * Spheres come from "centers" with optional "radii" and
+     * "material_indices" arrays, or from a binary point "file", resolved
+     * against the scene directory unless it is absolute. "radius"
+     * applies to points without their own. Indices select from the
+     * "materials" array; a single "material" serves all spheres.
+     * 
+     * @param set_json JSON object containing sphere set parameters
+     * @param materials Scene table that receives the set's materials
+     * @param scene_directory Directory of the scene file
+     * @return Created sphere set
+     * @throws std::runtime_error if the points cannot be loaded or are inconsistent
      */
-    static std::shared_ptr<geometry::Primitive> create_primitive(const nlohmann::json& object_json);
+    static std::shared_ptr<geometry::Primitive> create_sphere_set(const nlohmann::json& set_json,
+                                                                  materials::MaterialTable& materials,
+                                                                  const std::string& scene_directory);
     
     /**
      * @brief Creates a material from JSON configuration
@@ -4,11 +4,12 @@
 namespace raytracer {
 namespace core {
 
-// Helper function for random float
+// Helper function for random float; the distribution is static, so the
+// range is applied per call rather than fixed by the first caller
 float random_float(float min, float max) {
-    static std::uniform_real_distribution<float> distribution(min, max);
+    static std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
     static std::mt19937 generator;
-    return distribution(generator);
+    return min + (max - min) * distribution(generator);
 }
 
 // Helper function for random point in unit disk
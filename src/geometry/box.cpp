@@ -0,0 +1,60 @@
+/**
+ * @file box.cpp
+ * @brief Implementation of the six-quad box
+ */
+
+#include "box.h"
+#include <glm/glm.hpp>
+
+namespace raytracer {
+namespace geometry {
+
+Box::Box(const Point3& min, const Point3& max, uint32_t material)
+    : min_(glm::min(min, max)), max_(glm::max(min, max)) {
+    Vec3 dx(max_.x - min_.x, 0, 0);
+    Vec3 dy(0, max_.y - min_.y, 0);
+    Vec3 dz(0, 0, max_.z - min_.z);
+
+    // Edges are ordered so that every face normal points outward
+    faces_[0] = Quad(Point3(min_.x, min_.y, max_.z), dx, dy, material);    // Front (+z)
+    faces_[1] = Quad(Point3(max_.x, min_.y, min_.z), -dx, dy, material);   // Back (-z)
+    faces_[2] = Quad(Point3(max_.x, min_.y, max_.z), -dz, dy, material);   // Right (+x)
+    faces_[3] = Quad(Point3(min_.x, min_.y, min_.z), dz, dy, material);    // Left (-x)
+    faces_[4] = Quad(Point3(min_.x, max_.y, max_.z), dx, -dz, material);   // Top (+y)
+    faces_[5] = Quad(Point3(min_.x, min_.y, min_.z), dx, dz, material);    // Bottom (-y)
+}
+
+bool Box::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool Box::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    // The hit names the face that was struck, which completes it directly
+    bool hit_anything = false;
+    float closest_so_far = t_max;
+    for (const auto& face : faces_) {
+        if (face.find_hit(ray, t_min, closest_so_far, hit)) {
+            hit_anything = true;
+            closest_so_far = hit.t;
+        }
+    }
+    return hit_anything;
+}
+
+bool Box::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    for (const auto& face : faces_) {
+        if (face.occluded(ray, t_min, t_max)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Box::bounding_box(acceleration::AABB& output_box) const {
+    output_box = acceleration::AABB(min_, max_);
+    output_box.pad_to_minimum();
+    return true;
+}
+
+} // namespace geometry
+} // namespace raytracer
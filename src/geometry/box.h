@@ -0,0 +1,36 @@
+/**
+ * @file box.h
+ * @brief Axis-aligned box built from six quads
+ */
+
+#pragma once
+
+#include "primitive.h"
+#include "quad.h"
+#include <array>
+#include <memory>
+
+namespace raytracer {
+namespace geometry {
+
+class Box : public Primitive {
+public:
+    /**
+     * @param min Corner with the smallest coordinates
+     * @param max Opposite corner
+     * @param material Index of the material of all six faces
+     */
+    Box(const Point3& min, const Point3& max, uint32_t material);
+
+    bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
+
+private:
+    Point3 min_, max_;
+    std::array<Quad, 6> faces_;
+};
+
+} // namespace geometry
+} // namespace raytracer
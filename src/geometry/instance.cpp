@@ -0,0 +1,80 @@
+/**
+ * @file instance.cpp
+ * @brief Implementation of transformed geometry instances
+ */
+
+#include "instance.h"
+#include <stdexcept>
+
+namespace raytracer {
+namespace geometry {
+
+Instance::Instance(std::shared_ptr<const acceleration::BVHAccel> object, const Transform& object_to_world)
+    : object_(std::move(object)), object_to_world_(object_to_world),
+      world_to_object_(object_to_world.inverse()) {
+    if (!object_) {
+        throw std::runtime_error("Instance: object BVH must not be null");
+    }
+}
+
+void Instance::set_object_to_world(const Transform& object_to_world) {
+    world_to_object_ = object_to_world.inverse();
+    object_to_world_ = object_to_world;
+}
+
+bool Instance::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool Instance::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    // The direction is not renormalized, so t means the same in both spaces
+    core::Ray object_ray(world_to_object_.apply_point(ray.origin()),
+                         world_to_object_.apply_vector(ray.direction()));
+    if (!object_->find_hit(object_ray, t_min, t_max, hit)) {
+        return false;
+    }
+
+    // A hit has room for one instance; one reached through a nested
+    // instance drops the shape and is found again in complete_hit()
+    if (hit.instance) {
+        hit.primitive = nullptr;
+    }
+    hit.instance = this;
+    return true;
+}
+
+bool Instance::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    core::Ray object_ray(world_to_object_.apply_point(ray.origin()),
+                         world_to_object_.apply_vector(ray.direction()));
+    const bool completed = hit.primitive ? hit.primitive->complete_hit(object_ray, hit, rec)
+                                         : repeat_hit(*object_, object_ray, hit.t, rec);
+    if (!completed) {
+        return false;
+    }
+
+    // Normals transform by the inverse transpose, which also keeps the
+    // sign of dot(direction, normal) and therefore front_face intact
+    rec.point = object_to_world_.apply_point(rec.point);
+    rec.normal = glm::normalize(glm::transpose(world_to_object_.linear) * rec.normal);
+    rec.tangent = glm::normalize(object_to_world_.apply_vector(rec.tangent));
+    rec.bitangent = glm::normalize(object_to_world_.apply_vector(rec.bitangent));
+    return true;
+}
+
+bool Instance::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    core::Ray object_ray(world_to_object_.apply_point(ray.origin()),
+                         world_to_object_.apply_vector(ray.direction()));
+    return object_->occluded(object_ray, t_min, t_max);
+}
+
+bool Instance::bounding_box(acceleration::AABB& output_box) const {
+    acceleration::AABB object_box;
+    if (!object_->bounding_box(object_box)) {
+        return false;
+    }
+    output_box = object_to_world_.apply_box(object_box);
+    return true;
+}
+
+} // namespace geometry
+} // namespace raytracer
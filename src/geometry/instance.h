@@ -0,0 +1,56 @@
+/**
+ * @file instance.h
+ * @brief Transformed reference to shared, pre-built geometry
+ * 
+ * An instance pairs an object-to-world transform with a bottom-level BVH
+ * that many instances share. Added to a scene, instances are enclosed by
+ * the scene BVH, which then acts as the top level of a two-level
+ * hierarchy: rays that reach an instance are moved into object space and
+ * traced through the shared BVH.
+ */
+
+#pragma once
+
+#include "primitive.h"
+#include "transform.h"
+#include "../acceleration/bvh_accel.h"
+#include <memory>
+
+namespace raytracer {
+namespace geometry {
+
+class Instance : public Primitive {
+public:
+    /**
+     * @brief Places shared geometry in the world
+     * 
+     * @param object Bottom-level BVH in object space, typically shared by many instances
+     * @param object_to_world Placement of the object
+     * @throws std::runtime_error if object is null or the transform is singular
+     */
+    Instance(std::shared_ptr<const acceleration::BVHAccel> object, const Transform& object_to_world);
+
+    bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
+
+    const std::shared_ptr<const acceleration::BVHAccel>& object() const { return object_; }
+    const Transform& object_to_world() const { return object_to_world_; }
+    
+    /**
+     * @brief Moves the instance; refit or rebuild the enclosing BVH afterwards
+     * 
+     * @throws std::runtime_error if the transform is singular
+     */
+    void set_object_to_world(const Transform& object_to_world);
+
+private:
+    std::shared_ptr<const acceleration::BVHAccel> object_;
+    Transform object_to_world_;
+    Transform world_to_object_;
+};
+
+} // namespace geometry
+} // namespace raytracer
@@ -1,15 +1,442 @@
+/**
+ * @file mesh.cpp
+ * @brief Indexed triangle mesh intersection and face BVH build
+ */
+
 #include "mesh.h"
+#include "../acceleration/linear_bvh.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace raytracer {
 namespace geometry {
 
+namespace {
+    void require_vertex_attribute(size_t size, size_t vertex_count, const char* what) {
+        if (size != vertex_count) {
+            throw std::runtime_error(std::string("Mesh: ") + what + " count does not match the vertex count");
+        }
+    }
+}
+
 Mesh::Mesh(const std::vector<Point3>& vertices, const std::vector<std::array<int, 3>>& faces,
-           std::shared_ptr<materials::Material> material)
-    : vertices_(vertices), faces_(faces), material_(material) {}
+           uint32_t material)
+    : material_(material) {
+    std::vector<float> x, y, z;
+    x.reserve(vertices.size());
+    y.reserve(vertices.size());
+    z.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        x.push_back(vertex.x);
+        y.push_back(vertex.y);
+        z.push_back(vertex.z);
+    }
+    arrays_.x = std::move(x);
+    arrays_.y = std::move(y);
+    arrays_.z = std::move(z);
+
+    std::vector<uint32_t> indices;
+    indices.reserve(faces.size() * 3);
+    for (const auto& face : faces) {
+        for (int index : face) {
+            if (index < 0) {
+                throw std::runtime_error("Mesh: negative vertex index");
+            }
+            indices.push_back(static_cast<uint32_t>(index));
+        }
+    }
+    build(std::move(indices));
+}
+
+Mesh::Mesh(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<uint32_t> indices,
+           uint32_t material)
+    : material_(material) {
+    require_vertex_attribute(y.size(), x.size(), "y coordinate");
+    require_vertex_attribute(z.size(), x.size(), "z coordinate");
+    if (indices.size() % 3 != 0) {
+        throw std::runtime_error("Mesh: index count is not a multiple of three");
+    }
+    arrays_.x = std::move(x);
+    arrays_.y = std::move(y);
+    arrays_.z = std::move(z);
+    build(std::move(indices));
+}
+
+Mesh::Mesh(MeshArrays arrays, acceleration::WideBVH<4> bvh, uint32_t material, bool validate)
+    : arrays_(std::move(arrays)), bvh_(std::move(bvh)), material_(material) {
+    const size_t count = vertex_count();
+    require_vertex_attribute(arrays_.y.size(), count, "y coordinate");
+    require_vertex_attribute(arrays_.z.size(), count, "z coordinate");
+    if (has_vertex_normals()) {
+        require_vertex_attribute(arrays_.normal_x.size(), count, "normal");
+        require_vertex_attribute(arrays_.normal_y.size(), count, "normal");
+        require_vertex_attribute(arrays_.normal_z.size(), count, "normal");
+    }
+    if (has_texture_coordinates()) {
+        require_vertex_attribute(arrays_.u.size(), count, "texture coordinate");
+        require_vertex_attribute(arrays_.v.size(), count, "texture coordinate");
+    }
+    if (arrays_.indices.size() % 3 != 0 || arrays_.face_ids.size() != face_count()) {
+        throw std::runtime_error("Mesh: index and face id arrays do not match");
+    }
+    if (bvh_.empty() != (face_count() == 0)) {
+        throw std::runtime_error("Mesh: face BVH does not match the faces");
+    }
+    if (validate) {
+        validate_arrays();
+    }
+
+    // The root's child boxes enclose everything; empty slots are inverted
+    if (!bvh_.empty()) {
+        const auto& root = bvh_.nodes()[0];
+        for (int i = 0; i < 4; i++) {
+            if (root.bounds_min[0][i] <= root.bounds_max[0][i]) {
+                bounds_.expand(Point3(root.bounds_min[0][i], root.bounds_min[1][i], root.bounds_min[2][i]));
+                bounds_.expand(Point3(root.bounds_max[0][i], root.bounds_max[1][i], root.bounds_max[2][i]));
+            }
+        }
+    }
+}
+
+void Mesh::validate_arrays() const {
+    // Arrays from a file are untrusted; one pass over them is cheap next
+    // to rendering and keeps traversal from reading out of bounds
+    if (!bvh_.valid(face_count())) {
+        throw std::runtime_error("Mesh: face BVH addresses missing nodes or faces");
+    }
+
+    const uint32_t vertices = static_cast<uint32_t>(std::min<size_t>(vertex_count(), UINT32_MAX));
+    const uint32_t faces = static_cast<uint32_t>(std::min<size_t>(face_count(), UINT32_MAX));
+    const std::ptrdiff_t index_count = static_cast<std::ptrdiff_t>(arrays_.indices.size());
+    const std::ptrdiff_t face_id_count = static_cast<std::ptrdiff_t>(arrays_.face_ids.size());
+    bool out_of_range = false;
+
+    #pragma omp parallel for reduction(||:out_of_range)
+    for (std::ptrdiff_t i = 0; i < index_count; ++i) {
+        out_of_range = out_of_range || arrays_.indices[i] >= vertices;
+    }
+    if (out_of_range) {
+        throw std::runtime_error("Mesh: face references a missing vertex");
+    }
+
+    #pragma omp parallel for reduction(||:out_of_range)
+    for (std::ptrdiff_t i = 0; i < face_id_count; ++i) {
+        out_of_range = out_of_range || arrays_.face_ids[i] >= faces;
+    }
+    if (out_of_range) {
+        throw std::runtime_error("Mesh: face id out of range");
+    }
+}
+
+void Mesh::set_vertex_normals(std::vector<float> x, std::vector<float> y, std::vector<float> z) {
+    require_vertex_attribute(x.size(), vertex_count(), "normal");
+    require_vertex_attribute(y.size(), vertex_count(), "normal");
+    require_vertex_attribute(z.size(), vertex_count(), "normal");
+    arrays_.normal_x = std::move(x);
+    arrays_.normal_y = std::move(y);
+    arrays_.normal_z = std::move(z);
+}
+
+void Mesh::set_texture_coordinates(std::vector<float> u, std::vector<float> v) {
+    require_vertex_attribute(u.size(), vertex_count(), "texture coordinate");
+    require_vertex_attribute(v.size(), vertex_count(), "texture coordinate");
+    arrays_.u = std::move(u);
+    arrays_.v = std::move(v);
+}
+
+void Mesh::build(std::vector<uint32_t> indices) {
+    const size_t vertices = arrays_.x.size();
+    for (uint32_t index : indices) {
+        if (index >= vertices) {
+            throw std::runtime_error("Mesh: face references a missing vertex");
+        }
+    }
+
+    const size_t face_count = indices.size() / 3;
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(face_count);
+    std::vector<acceleration::AABB> bounds(face_count);
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        acceleration::AABB box(vertex(indices[3 * i]), vertex(indices[3 * i]));
+        box.expand(vertex(indices[3 * i + 1]));
+        box.expand(vertex(indices[3 * i + 2]));
+        // Axis-aligned faces produce flat boxes that the slab test would reject
+        box.pad_to_minimum();
+        bounds[i] = box;
+    }
+
+    // The binary tree is only needed to collapse the wide one and to
+    // permute the faces into leaf order
+    acceleration::LinearBVH binary(bounds);
+    bvh_ = acceleration::WideBVH<4>(binary);
+    bounds_ = binary.bounds();
+
+    const auto& order = binary.primitive_indices();
+    std::vector<uint32_t> leaf_indices(indices.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        const uint32_t face = order[i];
+        leaf_indices[3 * i] = indices[3 * face];
+        leaf_indices[3 * i + 1] = indices[3 * face + 1];
+        leaf_indices[3 * i + 2] = indices[3 * face + 2];
+    }
+    arrays_.indices = std::move(leaf_indices);
+    arrays_.face_ids = std::vector<uint32_t>(order.begin(), order.end());
+}
+
+void Mesh::set_triangle_test(TriangleTest test) {
+    triangle_test_ = test;
+    records_.clear();
+    records_.shrink_to_fit();
+    corners_.clear();
+    corners_.shrink_to_fit();
+    groups_.clear();
+    groups_.shrink_to_fit();
+    leaf_groups_.clear();
+    leaf_groups_.shrink_to_fit();
+
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(face_count());
+    const auto& indices = arrays_.indices;
+    if (test == TriangleTest::Precomputed) {
+        records_.resize(face_count());
+
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < count; ++i) {
+            records_[i] = TriangleRecord(vertex(indices[3 * i]), vertex(indices[3 * i + 1]), vertex(indices[3 * i + 2]));
+        }
+    } else if (test == TriangleTest::Watertight) {
+        // Plain copies keep shared vertices bit-identical, which watertightness relies on
+        corners_.resize(face_count() * 3);
+
+        #pragma omp parallel for
+        for (std::ptrdiff_t i = 0; i < count * 3; ++i) {
+            corners_[i] = vertex(indices[i]);
+        }
+    } else if (test == TriangleTest::Grouped) {
+        build_groups();
+    }
+}
+
+void Mesh::build_groups() {
+    leaf_groups_.assign(face_count(), 0);
+    const auto& nodes = bvh_.nodes();
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        for (int c = 0; c < 4; ++c) {
+            if (!nodes[n].is_leaf(c)) {
+                continue;
+            }
+            const uint32_t first = nodes[n].child[c];
+            const uint32_t count = nodes[n].primitive_count[c];
+            leaf_groups_[first] = static_cast<uint32_t>(groups_.size());
+            for (uint32_t base = 0; base < count; base += kGroupWidth) {
+                TriangleGroup<kGroupWidth> group;
+                for (uint32_t lane = 0; lane < kGroupWidth && base + lane < count; ++lane) {
+                    const uint32_t face = first + base + lane;
+                    group.set(lane, TriangleRecord(vertex(arrays_.indices[3 * face]),
+                                                   vertex(arrays_.indices[3 * face + 1]),
+                                                   vertex(arrays_.indices[3 * face + 2])));
+                }
+                groups_.push_back(group);
+            }
+        }
+    }
+}
+
+template <typename FaceTest>
+bool Mesh::closest_face(const core::Ray& ray, float t_min, float& t_max, FaceTest&& test_face, uint32_t& hit_face,
+                        float& hit_u, float& hit_v) const {
+    auto intersect_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float& closest_so_far) {
+        bool hit_anything = false;
+        for (uint32_t face = first; face < first + count; ++face) {
+            float t, u, v;
+            if (test_face(face, leaf_t_min, closest_so_far, t, u, v)) {
+                hit_anything = true;
+                closest_so_far = t;
+                hit_face = face;
+                hit_u = u;
+                hit_v = v;
+            }
+        }
+        return hit_anything;
+    };
+    return bvh_.intersect(ray, t_min, t_max, intersect_leaf);
+}
+
+template <typename FaceTest>
+bool Mesh::any_face(const core::Ray& ray, float t_min, float t_max, FaceTest&& test_face) const {
+    auto occluded_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float leaf_t_max) {
+        for (uint32_t face = first; face < first + count; ++face) {
+            float t, u, v;
+            if (test_face(face, leaf_t_min, leaf_t_max, t, u, v)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    return bvh_.occluded(ray, t_min, t_max, occluded_leaf);
+}
 
 bool Mesh::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
-    // TODO: Implement mesh intersection
-    return false;
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool Mesh::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    // Faces are kept in leaf order, so the hit names them by leaf position
+    uint32_t hit_face = 0;
+    float hit_u = 0.0f;
+    float hit_v = 0.0f;
+    float closest = t_max;
+    bool found = false;
+
+    if (triangle_test_ == TriangleTest::Precomputed) {
+        auto test_face = [&](uint32_t face, float lo, float hi, float& t, float& u, float& v) {
+            return intersect_triangle(records_[face], ray, lo, hi, t, u, v);
+        };
+        found = closest_face(ray, t_min, closest, test_face, hit_face, hit_u, hit_v);
+    } else if (triangle_test_ == TriangleTest::Watertight) {
+        const WatertightRay watertight_ray(ray);
+        auto test_face = [&](uint32_t face, float lo, float hi, float& t, float& u, float& v) {
+            const Point3* corners = &corners_[3 * size_t(face)];
+            return intersect_triangle_watertight(watertight_ray, corners[0], corners[1], corners[2], lo, hi, t, u, v);
+        };
+        found = closest_face(ray, t_min, closest, test_face, hit_face, hit_u, hit_v);
+    } else if (triangle_test_ == TriangleTest::Grouped) {
+        auto intersect_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float& closest_so_far) {
+            bool hit_anything = false;
+            uint32_t group = leaf_groups_[first];
+            for (uint32_t base = 0; base < count; base += kGroupWidth, ++group) {
+                float t, u, v;
+                int lane = intersect_triangle_group(groups_[group], ray, leaf_t_min, closest_so_far, t, u, v);
+                if (lane >= 0) {
+                    hit_anything = true;
+                    closest_so_far = t;
+                    hit_face = first + base + static_cast<uint32_t>(lane);
+                    hit_u = u;
+                    hit_v = v;
+                }
+            }
+            return hit_anything;
+        };
+        found = bvh_.intersect(ray, t_min, closest, intersect_leaf);
+    } else {
+        auto test_face = [&](uint32_t face, float lo, float hi, float& t, float& u, float& v) {
+            const TriangleRecord record(vertex(arrays_.indices[3 * face]), vertex(arrays_.indices[3 * face + 1]),
+                                        vertex(arrays_.indices[3 * face + 2]));
+            return intersect_triangle(record, ray, lo, hi, t, u, v);
+        };
+        found = closest_face(ray, t_min, closest, test_face, hit_face, hit_u, hit_v);
+    }
+    if (!found) {
+        return false;
+    }
+    hit.set(closest, hit_u, hit_v, hit_face, this);
+    return true;
+}
+
+bool Mesh::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    const uint32_t hit_face = hit.index;
+    const float hit_u = hit.u;
+    const float hit_v = hit.v;
+    const uint32_t i0 = arrays_.indices[3 * hit_face];
+    const uint32_t i1 = arrays_.indices[3 * hit_face + 1];
+    const uint32_t i2 = arrays_.indices[3 * hit_face + 2];
+    const Point3 v0 = vertex(i0);
+    const Vec3 edge1 = vertex(i1) - v0;
+    const Vec3 edge2 = vertex(i2) - v0;
+    const float w = 1.0f - hit_u - hit_v;
+
+    rec.t = hit.t;
+    rec.point = ray.at(rec.t);
+    Vec3 outward_normal = glm::normalize(glm::cross(edge1, edge2));
+    rec.set_face_normal(ray, outward_normal);
+    rec.material_index = material_;
+    rec.face_index = arrays_.face_ids[hit_face];
+    rec.barycentric_u = hit_u;
+    rec.barycentric_v = hit_v;
+
+    if (has_vertex_normals()) {
+        auto normal = [this](uint32_t i) {
+            return Vec3(arrays_.normal_x[i], arrays_.normal_y[i], arrays_.normal_z[i]);
+        };
+        Vec3 shading_normal = w * normal(i0) + hit_u * normal(i1) + hit_v * normal(i2);
+        float length = glm::length(shading_normal);
+        if (length > 0.0f) {
+            // Keep the shading normal on the side the geometric one faces
+            shading_normal /= length;
+            if (glm::dot(shading_normal, outward_normal) < 0.0f) {
+                shading_normal = -shading_normal;
+            }
+            rec.normal = rec.front_face ? shading_normal : -shading_normal;
+        }
+    }
+
+    if (has_texture_coordinates()) {
+        rec.u = w * arrays_.u[i0] + hit_u * arrays_.u[i1] + hit_v * arrays_.u[i2];
+        rec.v = w * arrays_.v[i0] + hit_u * arrays_.v[i1] + hit_v * arrays_.v[i2];
+    } else {
+        rec.u = hit_u;
+        rec.v = hit_v;
+    }
+
+    // Edge direction made orthogonal to the (possibly interpolated) normal
+    Vec3 tangent = edge1 - rec.normal * glm::dot(rec.normal, edge1);
+    tangent = glm::length(tangent) > 0.0f ? glm::normalize(tangent) : glm::normalize(edge1);
+    rec.set_tangent_space(tangent, glm::normalize(glm::cross(rec.normal, tangent)));
+    return true;
+}
+
+bool Mesh::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    if (triangle_test_ == TriangleTest::Precomputed) {
+        return any_face(ray, t_min, t_max, [&](uint32_t face, float lo, float hi, float& t, float& u, float& v) {
+            return intersect_triangle(records_[face], ray, lo, hi, t, u, v);
+        });
+    }
+    if (triangle_test_ == TriangleTest::Watertight) {
+        const WatertightRay watertight_ray(ray);
+        return any_face(ray, t_min, t_max, [&](uint32_t face, float lo, float hi, float& t, float& u, float& v) {
+            const Point3* corners = &corners_[3 * size_t(face)];
+            return intersect_triangle_watertight(watertight_ray, corners[0], corners[1], corners[2], lo, hi, t, u, v);
+        });
+    }
+    if (triangle_test_ == TriangleTest::Grouped) {
+        auto occluded_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float leaf_t_max) {
+            uint32_t group = leaf_groups_[first];
+            for (uint32_t base = 0; base < count; base += kGroupWidth, ++group) {
+                if (occluded_triangle_group(groups_[group], ray, leaf_t_min, leaf_t_max)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        return bvh_.occluded(ray, t_min, t_max, occluded_leaf);
+    }
+    return any_face(ray, t_min, t_max, [&](uint32_t face, float lo, float hi, float& t, float& u, float& v) {
+        const TriangleRecord record(vertex(arrays_.indices[3 * face]), vertex(arrays_.indices[3 * face + 1]),
+                                    vertex(arrays_.indices[3 * face + 2]));
+        return intersect_triangle(record, ray, lo, hi, t, u, v);
+    });
+}
+
+bool Mesh::bounding_box(acceleration::AABB& output_box) const {
+    if (bvh_.empty()) {
+        return false;
+    }
+    output_box = bounds_;
+    return true;
+}
+
+size_t Mesh::memory_bytes() const {
+    const size_t attribute_count = arrays_.x.size() + arrays_.y.size() + arrays_.z.size() +
+                                   arrays_.normal_x.size() + arrays_.normal_y.size() + arrays_.normal_z.size() +
+                                   arrays_.u.size() + arrays_.v.size();
+    return attribute_count * sizeof(float) + (arrays_.indices.size() + arrays_.face_ids.size()) * sizeof(uint32_t) +
+           bvh_.nodes().size() * sizeof(acceleration::WideBVHNode<4>) + records_.size() * sizeof(TriangleRecord) +
+           corners_.size() * sizeof(Point3) + groups_.size() * sizeof(TriangleGroup<kGroupWidth>) +
+           leaf_groups_.size() * sizeof(uint32_t);
 }
 
 } // namespace geometry
@@ -1,25 +1,185 @@
+/**
+ * @file mesh.h
+ * @brief Indexed triangle mesh with its own BVH over faces
+ *
+ * Vertex positions are shared between faces and stored as three separate
+ * coordinate arrays; faces are triples of vertex indices. A 4-wide BVH
+ * over the faces is built once when the mesh is created, so the enclosing
+ * scene BVH sees the whole mesh as a single primitive. Per face this costs
+ * the three indices, a face id and a share of the wide nodes, instead of a
+ * heap-allocated Triangle with its own vertices, material index and
+ * scene BVH entry. All arrays can also be views into a mapped mesh file.
+ */
+
 #pragma once
 
 #include "primitive.h"
-#include "../materials/material.h"
+#include "triangle_group.h"
+#include "triangle_intersection.h"
+#include "../acceleration/node_array.h"
+#include "../acceleration/wide_bvh.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 namespace raytracer {
 namespace geometry {
 
+/**
+ * @brief Vertex and face arrays of a mesh, owned or mapped
+ */
+struct MeshArrays {
+    acceleration::NodeArray<float> x, y, z;                         // Position per vertex
+    acceleration::NodeArray<float> normal_x, normal_y, normal_z;    // Optional shading normal per vertex
+    acceleration::NodeArray<float> u, v;                            // Optional texture coordinates per vertex
+    acceleration::NodeArray<uint32_t> indices;                      // Vertex triples in BVH leaf order
+    acceleration::NodeArray<uint32_t> face_ids;                     // Original id of each leaf-ordered face
+};
+
+/**
+ * @brief How a mesh tests its faces
+ */
+enum class TriangleTest {
+    MollerTrumbore,     // Möller-Trumbore on the indexed vertices; no extra memory
+    Precomputed,        // Möller-Trumbore on leaf-ordered vertex/edge records, 36 more bytes per face
+    Watertight,         // Watertight test on leaf-ordered vertex copies, 36 more bytes per face
+    Grouped             // Whole leaves at once on SoA groups of four; ~40 more bytes per face
+};
+
 class Mesh : public Primitive {
 public:
+    // Lanes per triangle group, matching the largest face BVH leaf
+    static constexpr int kGroupWidth = 4;
+
     Mesh() = default;
+
+    /**
+     * @brief Builds a mesh from vertex positions and index triples
+     *
+     * @throws std::runtime_error if a face references a missing vertex
+     */
     Mesh(const std::vector<Point3>& vertices, const std::vector<std::array<int, 3>>& faces,
-         std::shared_ptr<materials::Material> material);
+         uint32_t material);
+
+    /**
+     * @brief Adopts vertex coordinate arrays and a flat index array without copying
+     *
+     * @param x, y, z Vertex coordinates, one entry per vertex
+     * @param indices Three vertex indices per face
+     * @throws std::runtime_error if the arrays are inconsistent or a face
+     *         references a missing vertex
+     */
+    Mesh(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<uint32_t> indices,
+         uint32_t material);
+
+    /**
+     * @brief Adopts arrays and a face BVH built earlier, e.g. mapped from a mesh file
+     *
+     * Vertex data is not read; unless validate is false, indices, face ids
+     * and nodes are checked in one pass, since they may come from a
+     * corrupt file.
+     *
+     * @param arrays Indices in the leaf order of bvh, with their face ids
+     * @param bvh Face BVH whose leaf ranges address arrays.indices
+     * @param validate Check indices, face ids and nodes; skip only for
+     *                 arrays known to be consistent
+     * @throws std::runtime_error if the array lengths are inconsistent, or an
+     *         index, face id, child offset or leaf range is out of bounds
+     */
+    Mesh(MeshArrays arrays, acceleration::WideBVH<4> bvh, uint32_t material, bool validate = true);
+
+    /**
+     * @brief Attaches per-vertex shading normals, interpolated at hits
+     *
+     * @throws std::runtime_error unless there is one normal per vertex
+     */
+    void set_vertex_normals(std::vector<float> x, std::vector<float> y, std::vector<float> z);
+
+    /**
+     * @brief Attaches per-vertex texture coordinates, interpolated at hits
+     *
+     * @throws std::runtime_error unless there is one pair per vertex
+     */
+    void set_texture_coordinates(std::vector<float> u, std::vector<float> v);
 
+    /**
+     * @brief Selects the face test, building its per-face records if it needs them
+     *
+     * Records are stored in BVH leaf order, so each leaf reads one
+     * contiguous range. Use Watertight for closed meshes that rays must
+     * not leak through at shared edges.
+     */
+    void set_triangle_test(TriangleTest test);
+    TriangleTest triangle_test() const { return triangle_test_; }
+
+    /**
+     * @brief Closest hit over all faces
+     *
+     * Fills rec.face_index and rec.barycentric_u/v besides the usual
+     * surface data. Without texture coordinates, rec.u/v are the
+     * barycentrics as for a single Triangle.
+     */
     bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
 
+    /**
+     * @brief Closest face without surface data
+     *
+     * hit.index is the face's position in BVH leaf order and hit.u/v
+     * are its barycentrics.
+     */
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
+
+    size_t vertex_count() const { return arrays_.x.size(); }
+    size_t face_count() const { return arrays_.indices.size() / 3; }
+    bool has_vertex_normals() const { return !arrays_.normal_x.empty(); }
+    bool has_texture_coordinates() const { return !arrays_.u.empty(); }
+
+    const MeshArrays& arrays() const { return arrays_; }
+    const acceleration::WideBVH<4>& bvh() const { return bvh_; }
+
+    /**
+     * @brief Bytes held by vertex attributes, indices and the face BVH
+     */
+    size_t memory_bytes() const;
+
 private:
-    std::vector<Point3> vertices_;
-    std::vector<std::array<int, 3>> faces_;
-    std::shared_ptr<materials::Material> material_;
+    MeshArrays arrays_;
+    acceleration::WideBVH<4> bvh_;
+    acceleration::AABB bounds_;
+    uint32_t material_ = 0;
+    TriangleTest triangle_test_ = TriangleTest::MollerTrumbore;
+    std::vector<TriangleRecord> records_;   // Precomputed test, leaf order
+    std::vector<Point3> corners_;           // Watertight test, three per face in leaf order
+    std::vector<TriangleGroup<kGroupWidth>> groups_;   // Grouped test, consecutive groups per leaf
+    std::vector<uint32_t> leaf_groups_;     // Grouped test: first group of the leaf starting at each face
+
+    void build(std::vector<uint32_t> indices);
+
+    /**
+     * @throws std::runtime_error if an index, face id, child offset or leaf
+     *         range is out of bounds
+     */
+    void validate_arrays() const;
+    Point3 vertex(uint32_t index) const { return Point3(arrays_.x[index], arrays_.y[index], arrays_.z[index]); }
+
+    /**
+     * @brief Closest-hit traversal with a face test (face, t_min, t_max, t&, u&, v&) -> bool
+     *
+     * @param t_max Shrinks to the closest hit
+     */
+    template <typename FaceTest>
+    bool closest_face(const core::Ray& ray, float t_min, float& t_max, FaceTest&& test_face, uint32_t& hit_face,
+                      float& hit_u, float& hit_v) const;
+
+    template <typename FaceTest>
+    bool any_face(const core::Ray& ray, float t_min, float t_max, FaceTest&& test_face) const;
+
+    void build_groups();
 };
 
 } // namespace geometry
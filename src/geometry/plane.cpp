@@ -6,6 +6,10 @@ namespace raytracer {
 namespace geometry {
 
 bool Plane::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool Plane::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
     Vec3 normalized_normal = glm::normalize(normal_);
     float denominator = glm::dot(ray.direction(), normalized_normal);
     
@@ -20,21 +24,41 @@ bool Plane::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec)
     if (t < t_min || t > t_max) {
         return false;
     }
-    
-    rec.t = t;
+    hit.set(t, 0.0f, 0.0f, 0, this);
+    return true;
+}
+
+bool Plane::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    Vec3 normalized_normal = glm::normalize(normal_);
+    rec.t = hit.t;
     rec.point = ray.at(rec.t);
     rec.set_face_normal(ray, normalized_normal);
-    rec.material = material_;
+    rec.material_index = material_;
     
     // Compute UV coordinates for planar mapping
     compute_uv(rec.point, rec.u, rec.v);
     
     // Compute tangent space vectors for normal mapping
     compute_tangent_space(normalized_normal, rec);
-    
     return true;
 }
 
+bool Plane::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    // Same test as hit(); the normal needs no normalization for the distance
+    float denominator = glm::dot(ray.direction(), normal_);
+    if (std::abs(denominator) < 1e-8f * glm::length(normal_)) {
+        return false;
+    }
+    float t = glm::dot(point_ - ray.origin(), normal_) / denominator;
+    return t >= t_min && t <= t_max;
+}
+
+bool Plane::bounding_box(acceleration::AABB& output_box) const {
+    // Infinite planes have no finite bounds and must be tested outside the BVH
+    (void)output_box;
+    return false;
+}
+
 void Plane::compute_uv(const Point3& point, float& u, float& v) const {
     // Create a coordinate system on the plane
     Vec3 normalized_normal = glm::normalize(normal_);
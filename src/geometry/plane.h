@@ -1,7 +1,6 @@
 #pragma once
 
 #include "primitive.h"
-#include "../materials/material.h"
 #include <memory>
 
 namespace raytracer {
@@ -10,15 +9,19 @@ namespace geometry {
 class Plane : public Primitive {
 public:
     Plane() = default;
-    Plane(const Point3& point, const Vec3& normal, std::shared_ptr<materials::Material> material)
+    Plane(const Point3& point, const Vec3& normal, uint32_t material)
         : point_(point), normal_(normal), material_(material) {}
 
     bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
 
 private:
     Point3 point_;
     Vec3 normal_;
-    std::shared_ptr<materials::Material> material_;
+    uint32_t material_ = 0;
     
     /**
      * @brief Computes UV coordinates for planar mapping
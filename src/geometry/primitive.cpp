@@ -1,3 +1,21 @@
 #include "primitive.h"
 
-// Implementation is in header file for performance
+namespace raytracer {
+namespace geometry {
+
+// Everything else is in the header for performance
+
+bool Primitive::repeat_hit(const Primitive& shape, const core::Ray& ray, float t, HitRecord& rec) {
+    if (shape.hit(ray, t, t, rec)) {
+        return true;
+    }
+    for (float epsilon : {1e-6f, 1e-4f, 1e-2f}) {
+        if (shape.hit(ray, t * (1.0f - epsilon), t * (1.0f + epsilon), rec)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace geometry
+} // namespace raytracer
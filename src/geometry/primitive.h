@@ -2,25 +2,38 @@
 
 #include "../common.h"
 #include "../core/ray.h"
+#include "../core/hash.h"
 #include "../materials/material.h"
+#include "../acceleration/aabb.h"
 #include <memory>
 
 namespace raytracer {
 namespace geometry {
 
+/**
+ * @brief Surface data at the closest hit of a ray
+ * 
+ * Plain data without references to count, sized to fit two cache lines.
+ */
 struct HitRecord {
     Point3 point;
     Vec3 normal;
-    std::shared_ptr<materials::Material> material;
     float t;
-    bool front_face;
+    uint32_t material_index;    // Index into the scene's MaterialTable
     
     // UV coordinates for texture mapping
     float u, v;
     
+    // Mesh hits: original face index and barycentric coordinates of the
+    // face's second and third vertex
+    uint32_t face_index;
+    float barycentric_u, barycentric_v;
+    
     // Tangent space vectors for normal mapping
     Vec3 tangent;
     Vec3 bitangent;
+    
+    bool front_face;
 
     inline void set_face_normal(const core::Ray& ray, const Vec3& outward_normal) {
         front_face = glm::dot(ray.direction(), outward_normal) < 0;
@@ -39,11 +52,162 @@ struct HitRecord {
     }
 };
 
+static_assert(sizeof(HitRecord) <= 128, "HitRecord should fit in two cache lines");
+
+class Primitive;
+
+/**
+ * @brief The minimum a closest-hit search keeps per candidate
+ * 
+ * Traversal replaces this small record at every closer hit and only the
+ * final one is expanded into a HitRecord, so points, normals, texture
+ * coordinates and tangent frames are computed once per ray instead of
+ * once per candidate.
+ */
+struct SurfaceHit {
+    float t;
+    float u, v;                             // Parameters of the shape, e.g. barycentrics
+    uint32_t index;                         // Part of the shape, e.g. a mesh face
+    const Primitive* primitive;             // Shape whose complete_hit() expands the hit
+    const Primitive* instance;              // Instance the ray entered to reach it, if any
+
+    inline void set(float hit_t, float hit_u, float hit_v, uint32_t hit_index, const Primitive* hit_primitive) {
+        t = hit_t;
+        u = hit_u;
+        v = hit_v;
+        index = hit_index;
+        primitive = hit_primitive;
+        instance = nullptr;
+    }
+
+    /**
+     * @brief Expands the hit into full surface data
+     * 
+     * @param ray The ray the hit was found with, in the caller's space
+     * @return False if the shape could not recover the hit; callers treat
+     *         the ray as a miss
+     */
+    inline bool complete(const core::Ray& ray, HitRecord& rec) const;
+};
+
 class Primitive {
 public:
     virtual ~Primitive() = default;
     virtual bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const = 0;
+
+    /**
+     * @brief Closest-hit query that defers the surface data
+     * 
+     * Leaves hit untouched on a miss and overwrites all of it on a hit.
+     * The default runs hit() and keeps only the distance; shapes on the
+     * hot path override it together with complete_hit().
+     * 
+     * @return True if the ray hits the primitive in [t_min, t_max]
+     */
+    virtual bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+        HitRecord rec;
+        if (!this->hit(ray, t_min, t_max, rec)) {
+            return false;
+        }
+        hit.set(rec.t, rec.u, rec.v, 0, this);
+        return true;
+    }
+
+    /**
+     * @brief Fills rec for a hit that find_hit() reported on this primitive
+     * 
+     * The default repeats hit() at hit.t; see repeat_hit().
+     * 
+     * @return False if the hit cannot be recovered, leaving rec unusable
+     */
+    virtual bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+        return repeat_hit(*this, ray, hit.t, rec);
+    }
+
+    /**
+     * @brief Any-hit query for shadow rays
+     * 
+     * Returns as soon as some intersection in [t_min, t_max] is found and
+     * computes no surface data. The default falls back to hit(); shapes on
+     * the hot path override it.
+     * 
+     * @return True if the ray hits the primitive anywhere in the interval
+     */
+    virtual bool occluded(const core::Ray& ray, float t_min, float t_max) const {
+        HitRecord rec;
+        return hit(ray, t_min, t_max, rec);
+    }
+
+    /**
+     * @brief Computes the world-space bounding box of the primitive
+     * 
+     * @param output_box Receives the bounding box
+     * @return False if the primitive is unbounded (e.g. an infinite plane)
+     */
+    virtual bool bounding_box(acceleration::AABB& output_box) const = 0;
+
+    /**
+     * @brief Bounds of the part of the primitive inside a box
+     * 
+     * Used by spatial-split BVH builds. The default intersects the full
+     * bounding box with the clip box; shapes that can do better override it.
+     * 
+     * @param clip_box Region to clip against
+     * @return Clipped bounds, empty if the primitive misses the clip box
+     */
+    virtual acceleration::AABB clipped_bounding_box(const acceleration::AABB& clip_box) const {
+        acceleration::AABB box;
+        if (!bounding_box(box)) {
+            return clip_box;
+        }
+        return box.intersection(clip_box);
+    }
+
+    /**
+     * @brief Hash of everything a BVH build reads from the primitive
+     * 
+     * Keys cached acceleration structures. The default hashes the bounding
+     * box, which is all the build sees unless clipped_bounding_box() is
+     * overridden; such shapes must hash their full geometry instead.
+     */
+    virtual uint64_t geometry_hash() const {
+        acceleration::AABB box;
+        if (!bounding_box(box)) {
+            return core::kHashSeed;
+        }
+        uint64_t hash = core::hash_combine(core::kHashSeed, box.min());
+        return core::hash_combine(hash, box.max());
+    }
+
+protected:
+    /**
+     * @brief Recovers the surface data of a hit found earlier at distance t
+     * 
+     * Runs shape.hit() on [t, t], which finds the same intersection again
+     * as long as hit() is deterministic. Shapes that reject an empty
+     * interval, e.g. through a strict AABB test, get slightly wider ones.
+     * 
+     * @return False if even those miss; the hit is then lost rather than
+     *         shaded with a made-up surface
+     */
+    static bool repeat_hit(const Primitive& shape, const core::Ray& ray, float t, HitRecord& rec);
+
+    /**
+     * @brief hit() for shapes that implement find_hit() and complete_hit()
+     */
+    bool deferred_hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
+        SurfaceHit surface;
+        if (!find_hit(ray, t_min, t_max, surface)) {
+            return false;
+        }
+        return surface.complete(ray, rec);
+    }
 };
 
+inline bool SurfaceHit::complete(const core::Ray& ray, HitRecord& rec) const {
+    // Instances move the ray into object space before the shape sees it
+    return (instance ? instance : primitive)->complete_hit(ray, *this, rec);
+}
+
 } // namespace geometry
 } // namespace raytracer
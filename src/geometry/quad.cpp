@@ -0,0 +1,57 @@
+/**
+ * @file quad.cpp
+ * @brief Implementation of the bounded parallelogram primitive
+ */
+
+#include "quad.h"
+#include <glm/glm.hpp>
+
+namespace raytracer {
+namespace geometry {
+
+Quad::Quad(const Point3& corner, const Vec3& u, const Vec3& v, uint32_t material)
+    : corner_(corner), u_(u), v_(v), material_(material) {
+    Vec3 n = glm::cross(u, v);
+    normal_ = glm::normalize(n);
+    plane_offset_ = glm::dot(normal_, corner);
+    w_ = n / glm::dot(n, n);
+}
+
+bool Quad::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool Quad::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    rec.t = hit.t;
+    rec.point = ray.at(rec.t);
+    rec.set_face_normal(ray, normal_);
+    rec.material_index = material_;
+    
+    // Edge coordinates map the texture once across the quad
+    rec.u = hit.u;
+    rec.v = hit.v;
+    
+    Vec3 tangent = glm::normalize(u_);
+    rec.set_tangent_space(tangent, glm::cross(rec.normal, tangent));
+    return true;
+}
+
+bool Quad::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    float t, alpha, beta;
+    return intersect(ray, t_min, t_max, t, alpha, beta);
+}
+
+bool Quad::bounding_box(acceleration::AABB& output_box) const {
+    output_box = acceleration::AABB();
+    output_box.expand(corner_);
+    output_box.expand(corner_ + u_);
+    output_box.expand(corner_ + u_ + v_);
+    output_box.expand(corner_ + v_);
+    
+    // Axis-aligned quads produce flat boxes that the slab test would reject
+    output_box.pad_to_minimum();
+    return true;
+}
+
+} // namespace geometry
+} // namespace raytracer
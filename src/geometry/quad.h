@@ -0,0 +1,88 @@
+/**
+ * @file quad.h
+ * @brief Bounded parallelogram, the finite replacement for wall planes
+ * 
+ * A quad spans corner + a*u + b*v for a, b in [0, 1]. Unlike an infinite
+ * Plane it has a bounding box, so it can live inside the BVH.
+ */
+
+#pragma once
+
+#include "primitive.h"
+#include <cmath>
+#include <memory>
+
+namespace raytracer {
+namespace geometry {
+
+class Quad final : public Primitive {
+public:
+    // Degenerate: its zero normal makes every ray parallel, so it is never hit
+    Quad() = default;
+    
+    /**
+     * @param corner One corner of the parallelogram
+     * @param u First edge from the corner
+     * @param v Second edge from the corner; u and v must not be parallel
+     * @param material Index of the surface material in the scene's MaterialTable
+     */
+    Quad(const Point3& corner, const Vec3& u, const Vec3& v, uint32_t material);
+
+    bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
+    
+    /**
+     * @brief Intersects the quad's plane and checks the edge coordinates
+     * 
+     * Inline, like find_hit(), so that typed BVH leaves inline the test.
+     * 
+     * @param t Receives the hit distance
+     * @param alpha Receives the coordinate along u, in [0, 1]
+     * @param beta Receives the coordinate along v, in [0, 1]
+     * @return False if the ray misses or the hit lies outside [t_min, t_max]
+     */
+    bool intersect(const core::Ray& ray, float t_min, float t_max, float& t, float& alpha, float& beta) const;
+
+private:
+    Point3 corner_{0.0f};
+    Vec3 u_{0.0f}, v_{0.0f};
+    Vec3 normal_{0.0f};            // Unit normal, cross(u, v) normalized
+    float plane_offset_ = 0.0f;    // dot(normal, corner)
+    Vec3 w_{0.0f};                 // cross(u, v) / |cross(u, v)|^2, maps plane offsets to edge coordinates
+    uint32_t material_ = 0;
+};
+
+inline bool Quad::intersect(const core::Ray& ray, float t_min, float t_max, float& t, float& alpha,
+                            float& beta) const {
+    float denominator = glm::dot(normal_, ray.direction());
+    
+    // Ray is parallel to the quad
+    if (std::abs(denominator) < 1e-8f) {
+        return false;
+    }
+    
+    t = (plane_offset_ - glm::dot(normal_, ray.origin())) / denominator;
+    if (!(t >= t_min && t <= t_max)) {
+        return false;
+    }
+    
+    Vec3 planar = ray.at(t) - corner_;
+    alpha = glm::dot(w_, glm::cross(planar, v_));
+    beta = glm::dot(w_, glm::cross(u_, planar));
+    return alpha >= 0.0f && alpha <= 1.0f && beta >= 0.0f && beta <= 1.0f;
+}
+
+inline bool Quad::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    float t, alpha, beta;
+    if (!intersect(ray, t_min, t_max, t, alpha, beta)) {
+        return false;
+    }
+    hit.set(t, alpha, beta, 0, this);
+    return true;
+}
+
+} // namespace geometry
+} // namespace raytracer
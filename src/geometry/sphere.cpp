@@ -7,42 +7,37 @@ namespace raytracer {
 namespace geometry {
 
 bool Sphere::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
-    Vec3 oc = ray.origin() - center_;
-    auto a = glm::dot(ray.direction(), ray.direction());
-    auto half_b = glm::dot(oc, ray.direction());
-    auto c = glm::dot(oc, oc) - radius_ * radius_;
-
-    auto discriminant = half_b * half_b - a * c;
-    if (discriminant < 0) return false;
-
-    // Find the nearest root that lies in the acceptable range
-    auto sqrtd = sqrt(discriminant);
-    auto root = (-half_b - sqrtd) / a;
-    if (root < t_min || t_max < root) {
-        root = (-half_b + sqrtd) / a;
-        if (root < t_min || t_max < root)
-            return false;
-    }
+    return deferred_hit(ray, t_min, t_max, rec);
+}
 
-    rec.t = root;
+bool Sphere::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    rec.t = hit.t;
     rec.point = ray.at(rec.t);
     Vec3 outward_normal = (rec.point - center_) / radius_;
     rec.set_face_normal(ray, outward_normal);
-    rec.material = material_;
+    rec.material_index = material_;
     
     // Compute UV coordinates for spherical mapping
-    compute_uv(rec.point, rec.u, rec.v);
+    sphere_uv(rec.point - center_, rec.u, rec.v);
     
     // Compute tangent space vectors for normal mapping
-    compute_tangent_space(outward_normal, rec);
+    sphere_tangent_space(outward_normal, rec);
+    return true;
+}
+
+bool Sphere::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    float root;
+    return intersect(ray, t_min, t_max, root);
+}
 
+bool Sphere::bounding_box(acceleration::AABB& output_box) const {
+    // Negative radii are used for hollow glass spheres, so take the magnitude
+    Vec3 extent(std::abs(radius_));
+    output_box = acceleration::AABB(center_ - extent, center_ + extent);
     return true;
 }
 
-void Sphere::compute_uv(const Point3& point, float& u, float& v) const {
-    // Convert hit point to local coordinates (relative to sphere center)
-    Vec3 local_point = point - center_;
-    
+void sphere_uv(const Vec3& local_point, float& u, float& v) {
     // Normalize to get unit vector
     Vec3 unit_point = glm::normalize(local_point);
     
@@ -57,7 +52,7 @@ void Sphere::compute_uv(const Point3& point, float& u, float& v) const {
     v = theta / glm::pi<float>();
 }
 
-void Sphere::compute_tangent_space(const Vec3& normal, HitRecord& rec) const {
+void sphere_tangent_space(const Vec3& normal, HitRecord& rec) {
     // For a sphere, we can compute tangent and bitangent from the normal
     // Choose an arbitrary vector perpendicular to the normal
     Vec3 up(0, 1, 0);
@@ -1,42 +1,85 @@
 #pragma once
 
 #include "primitive.h"
-#include "../materials/material.h"
+#include <cmath>
 #include <memory>
 
 namespace raytracer {
 namespace geometry {
 
-class Sphere : public Primitive {
+/**
+ * @brief Computes UV coordinates for spherical mapping
+ * 
+ * @param local_point Hit point relative to the sphere center
+ * @param u Output U coordinate [0, 1]
+ * @param v Output V coordinate [0, 1]
+ */
+void sphere_uv(const Vec3& local_point, float& u, float& v);
+
+/**
+ * @brief Computes tangent space vectors for normal mapping
+ * 
+ * @param normal Outward surface normal at hit point
+ * @param rec Hit record to store tangent and bitangent
+ */
+void sphere_tangent_space(const Vec3& normal, HitRecord& rec);
+
+class Sphere final : public Primitive {
 public:
     Sphere() = default;
-    Sphere(const Point3& center, float radius, std::shared_ptr<materials::Material> material)
+    Sphere(const Point3& center, float radius, uint32_t material)
         : center_(center), radius_(radius), material_(material) {}
 
     bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
 
-private:
-    Point3 center_;
-    float radius_;
-    std::shared_ptr<materials::Material> material_;
-    
     /**
-     * @brief Computes UV coordinates for spherical mapping
+     * @brief Finds the nearest root of the ray-sphere equation in [t_min, t_max]
      * 
-     * @param point Hit point on the sphere
-     * @param u Output U coordinate [0, 1]
-     * @param v Output V coordinate [0, 1]
-     */
-    void compute_uv(const Point3& point, float& u, float& v) const;
-    
-    /**
-     * @brief Computes tangent space vectors for normal mapping
+     * Inline, like find_hit(), so that typed BVH leaves inline the test.
      * 
-     * @param normal Surface normal at hit point
-     * @param rec Hit record to store tangent and bitangent
+     * @param root Receives the hit distance
+     * @return False if neither root lies in the interval
      */
-    void compute_tangent_space(const Vec3& normal, HitRecord& rec) const;
+    bool intersect(const core::Ray& ray, float t_min, float t_max, float& root) const;
+
+private:
+    Point3 center_;
+    float radius_;
+    uint32_t material_ = 0;
 };
 
+inline bool Sphere::intersect(const core::Ray& ray, float t_min, float t_max, float& root) const {
+    Vec3 oc = ray.origin() - center_;
+    auto a = glm::dot(ray.direction(), ray.direction());
+    auto half_b = glm::dot(oc, ray.direction());
+    auto c = glm::dot(oc, oc) - radius_ * radius_;
+
+    auto discriminant = half_b * half_b - a * c;
+    if (discriminant < 0) return false;
+
+    // Find the nearest root that lies in the acceptable range
+    double sqrtd = std::sqrt(static_cast<double>(discriminant));
+    root = static_cast<float>((-half_b - sqrtd) / a);
+    if (root < t_min || t_max < root) {
+        root = static_cast<float>((-half_b + sqrtd) / a);
+        if (root < t_min || t_max < root)
+            return false;
+    }
+    return true;
+}
+
+inline bool Sphere::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    float root;
+    if (!intersect(ray, t_min, t_max, root)) {
+        return false;
+    }
+    hit.set(root, 0.0f, 0.0f, 0, this);
+    return true;
+}
+
 } // namespace geometry
 } // namespace raytracer
@@ -0,0 +1,270 @@
+/**
+ * @file sphere_set.cpp
+ * @brief Sphere set BVH build and grouped sphere intersection
+ */
+
+#include "sphere_set.h"
+#include "sphere.h"
+#include "../acceleration/linear_bvh.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace raytracer {
+namespace geometry {
+
+namespace {
+    /**
+     * @brief Nearest in-range root of every lane, as Sphere::intersect computes it
+     *
+     * @param a Squared length of the ray direction
+     * @param t Receives the root of each lane
+     * @return Bit mask of lanes with a root in [t_min, t_max]
+     */
+#if defined(RAYTRACER_SPHERE_SET_AVX)
+    int intersect_lanes(const float* x, const float* y, const float* z, const float* radius, const core::Ray& ray,
+                        float a, float t_min, float t_max, float* t) {
+        const Point3& o = ray.origin();
+        const Vec3& d = ray.direction();
+        const __m256 ocx = _mm256_sub_ps(_mm256_set1_ps(o.x), _mm256_loadu_ps(x));
+        const __m256 ocy = _mm256_sub_ps(_mm256_set1_ps(o.y), _mm256_loadu_ps(y));
+        const __m256 ocz = _mm256_sub_ps(_mm256_set1_ps(o.z), _mm256_loadu_ps(z));
+        const __m256 r = _mm256_loadu_ps(radius);
+
+        const __m256 half_b = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(ocx, _mm256_set1_ps(d.x)), _mm256_mul_ps(ocy, _mm256_set1_ps(d.y))),
+            _mm256_mul_ps(ocz, _mm256_set1_ps(d.z)));
+        const __m256 c = _mm256_sub_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), _mm256_mul_ps(ocz, ocz)),
+            _mm256_mul_ps(r, r));
+        const __m256 va = _mm256_set1_ps(a);
+        const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(va, c));
+        __m256 valid = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ);
+
+        const __m256 sqrtd = _mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps()));
+        const __m256 neg_half_b = _mm256_xor_ps(half_b, _mm256_set1_ps(-0.0f));
+        const __m256 near_root = _mm256_div_ps(_mm256_sub_ps(neg_half_b, sqrtd), va);
+        const __m256 far_root = _mm256_div_ps(_mm256_add_ps(neg_half_b, sqrtd), va);
+        const __m256 lo = _mm256_set1_ps(t_min);
+        const __m256 hi = _mm256_set1_ps(t_max);
+        const __m256 near_in = _mm256_and_ps(_mm256_cmp_ps(near_root, lo, _CMP_GE_OQ),
+                                             _mm256_cmp_ps(near_root, hi, _CMP_LE_OQ));
+        const __m256 far_in = _mm256_and_ps(_mm256_cmp_ps(far_root, lo, _CMP_GE_OQ),
+                                            _mm256_cmp_ps(far_root, hi, _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_or_ps(near_in, far_in));
+
+        _mm256_storeu_ps(t, _mm256_blendv_ps(far_root, near_root, near_in));
+        return _mm256_movemask_ps(valid);
+    }
+#elif defined(RAYTRACER_SPHERE_SET_SSE)
+    int intersect_lanes(const float* x, const float* y, const float* z, const float* radius, const core::Ray& ray,
+                        float a, float t_min, float t_max, float* t) {
+        const Point3& o = ray.origin();
+        const Vec3& d = ray.direction();
+        const __m128 ocx = _mm_sub_ps(_mm_set1_ps(o.x), _mm_loadu_ps(x));
+        const __m128 ocy = _mm_sub_ps(_mm_set1_ps(o.y), _mm_loadu_ps(y));
+        const __m128 ocz = _mm_sub_ps(_mm_set1_ps(o.z), _mm_loadu_ps(z));
+        const __m128 r = _mm_loadu_ps(radius);
+
+        const __m128 half_b = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(ocx, _mm_set1_ps(d.x)), _mm_mul_ps(ocy, _mm_set1_ps(d.y))),
+            _mm_mul_ps(ocz, _mm_set1_ps(d.z)));
+        const __m128 c = _mm_sub_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+            _mm_mul_ps(r, r));
+        const __m128 va = _mm_set1_ps(a);
+        const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(va, c));
+        __m128 valid = _mm_cmpge_ps(discriminant, _mm_setzero_ps());
+
+        const __m128 sqrtd = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+        const __m128 neg_half_b = _mm_xor_ps(half_b, _mm_set1_ps(-0.0f));
+        const __m128 near_root = _mm_div_ps(_mm_sub_ps(neg_half_b, sqrtd), va);
+        const __m128 far_root = _mm_div_ps(_mm_add_ps(neg_half_b, sqrtd), va);
+        const __m128 lo = _mm_set1_ps(t_min);
+        const __m128 hi = _mm_set1_ps(t_max);
+        const __m128 near_in = _mm_and_ps(_mm_cmpge_ps(near_root, lo), _mm_cmple_ps(near_root, hi));
+        const __m128 far_in = _mm_and_ps(_mm_cmpge_ps(far_root, lo), _mm_cmple_ps(far_root, hi));
+        valid = _mm_and_ps(valid, _mm_or_ps(near_in, far_in));
+
+        // SSE2 has no blend; select with and/andnot
+        _mm_storeu_ps(t, _mm_or_ps(_mm_and_ps(near_in, near_root), _mm_andnot_ps(near_in, far_root)));
+        return _mm_movemask_ps(valid);
+    }
+#else
+    int intersect_lanes(const float* x, const float* y, const float* z, const float* radius, const core::Ray& ray,
+                        float a, float t_min, float t_max, float* t) {
+        int mask = 0;
+        for (int i = 0; i < SphereSet::kGroupWidth; i++) {
+            Vec3 oc = ray.origin() - Point3(x[i], y[i], z[i]);
+            float half_b = glm::dot(oc, ray.direction());
+            float c = glm::dot(oc, oc) - radius[i] * radius[i];
+            float discriminant = half_b * half_b - a * c;
+            if (discriminant < 0) {
+                continue;
+            }
+            float sqrtd = std::sqrt(discriminant);
+            float root = (-half_b - sqrtd) / a;
+            if (root < t_min || t_max < root) {
+                root = (-half_b + sqrtd) / a;
+                if (root < t_min || t_max < root) {
+                    continue;
+                }
+            }
+            t[i] = root;
+            mask |= 1 << i;
+        }
+        return mask;
+    }
+#endif
+}
+
+SphereSet::SphereSet(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<float> radii,
+                     std::vector<uint32_t> material_indices, std::vector<uint32_t> materials)
+    : materials_(std::move(materials)), count_(x.size()) {
+    if (y.size() != count_ || z.size() != count_ || radii.size() != count_) {
+        throw std::runtime_error("SphereSet: center and radius arrays differ in length");
+    }
+    if (material_indices.empty()) {
+        material_indices.assign(count_, 0);
+    } else if (material_indices.size() != count_) {
+        throw std::runtime_error("SphereSet: material index count does not match the sphere count");
+    }
+    for (uint32_t index : material_indices) {
+        if (index >= materials_.size()) {
+            throw std::runtime_error("SphereSet: material index " + std::to_string(index) + " is out of range");
+        }
+    }
+
+    const std::ptrdiff_t count = static_cast<std::ptrdiff_t>(count_);
+    std::vector<acceleration::AABB> bounds(count_);
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        Point3 center(x[i], y[i], z[i]);
+        Vec3 extent(std::abs(radii[i]));
+        bounds[i] = acceleration::AABB(center - extent, center + extent);
+    }
+
+    // Leaves up to a SIMD group wide, costed as one grouped test
+    acceleration::LinearBVH binary(bounds, kGroupWidth);
+    bvh_ = acceleration::WideBVH<4>(binary);
+    bounds_ = binary.bounds();
+
+    const auto& order = binary.primitive_indices();
+    const size_t padded = count_ + kGroupWidth - 1;
+    x_.assign(padded, 0.0f);
+    y_.assign(padded, 0.0f);
+    z_.assign(padded, 0.0f);
+    radius_.assign(padded, 0.0f);
+    material_indices_.resize(count_);
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t i = 0; i < count; ++i) {
+        const uint32_t sphere = order[i];
+        x_[i] = x[sphere];
+        y_[i] = y[sphere];
+        z_[i] = z[sphere];
+        radius_[i] = radii[sphere];
+        material_indices_[i] = material_indices[sphere];
+    }
+}
+
+int SphereSet::intersect_group(uint32_t first, uint32_t count, const core::Ray& ray, float t_min, float t_max,
+                               float& t) const {
+    alignas(32) float lane_t[kGroupWidth];
+    const float a = glm::dot(ray.direction(), ray.direction());
+    int mask = intersect_lanes(x_.data() + first, y_.data() + first, z_.data() + first, radius_.data() + first, ray,
+                               a, t_min, t_max, lane_t);
+    // Lanes past the leaf belong to the next leaf or the padding
+    mask &= (1 << count) - 1;
+
+    int nearest = -1;
+    float nearest_t = std::numeric_limits<float>::infinity();
+    for (int i = 0; i < kGroupWidth; i++) {
+        if ((mask & (1 << i)) && lane_t[i] < nearest_t) {
+            nearest = i;
+            nearest_t = lane_t[i];
+        }
+    }
+    if (nearest < 0) {
+        return -1;
+    }
+    t = nearest_t;
+    return static_cast<int>(first) + nearest;
+}
+
+bool SphereSet::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool SphereSet::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    int hit_sphere = -1;
+    float closest = t_max;
+    auto intersect_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float& closest_so_far) {
+        bool hit_anything = false;
+        for (uint32_t base = 0; base < count; base += kGroupWidth) {
+            const uint32_t lanes = std::min<uint32_t>(count - base, kGroupWidth);
+            float t;
+            int sphere = intersect_group(first + base, lanes, ray, leaf_t_min, closest_so_far, t);
+            if (sphere >= 0) {
+                hit_anything = true;
+                closest_so_far = t;
+                hit_sphere = sphere;
+            }
+        }
+        return hit_anything;
+    };
+    if (!bvh_.intersect(ray, t_min, closest, intersect_leaf)) {
+        return false;
+    }
+    hit.set(closest, 0.0f, 0.0f, static_cast<uint32_t>(hit_sphere), this);
+    return true;
+}
+
+bool SphereSet::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    // Surface data as a single Sphere computes it
+    const uint32_t hit_sphere = hit.index;
+    const Point3 center(x_[hit_sphere], y_[hit_sphere], z_[hit_sphere]);
+    rec.t = hit.t;
+    rec.point = ray.at(rec.t);
+    Vec3 outward_normal = (rec.point - center) / radius_[hit_sphere];
+    rec.set_face_normal(ray, outward_normal);
+    rec.material_index = materials_[material_indices_[hit_sphere]];
+    sphere_uv(rec.point - center, rec.u, rec.v);
+    sphere_tangent_space(outward_normal, rec);
+    return true;
+}
+
+bool SphereSet::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    auto occluded_leaf = [&](uint32_t first, uint32_t count, float leaf_t_min, float leaf_t_max) {
+        for (uint32_t base = 0; base < count; base += kGroupWidth) {
+            const uint32_t lanes = std::min<uint32_t>(count - base, kGroupWidth);
+            float t;
+            if (intersect_group(first + base, lanes, ray, leaf_t_min, leaf_t_max, t) >= 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    return bvh_.occluded(ray, t_min, t_max, occluded_leaf);
+}
+
+bool SphereSet::bounding_box(acceleration::AABB& output_box) const {
+    if (count_ == 0) {
+        return false;
+    }
+    output_box = bounds_;
+    return true;
+}
+
+size_t SphereSet::memory_bytes() const {
+    return (x_.size() + y_.size() + z_.size() + radius_.size()) * sizeof(float) +
+           material_indices_.size() * sizeof(uint32_t) + bvh_.nodes().size() * sizeof(acceleration::WideBVHNode<4>);
+}
+
+} // namespace geometry
+} // namespace raytracer
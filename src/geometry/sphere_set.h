@@ -0,0 +1,91 @@
+/**
+ * @file sphere_set.h
+ * @brief Many spheres as one primitive, stored as SoA arrays with their own BVH
+ *
+ * Meant for particle-scale scenes. Centers, radii and material indices
+ * live in flat arrays in BVH leaf order, with a small palette mapping
+ * the set's material indices to the scene's, so a sphere costs 20 bytes
+ * plus its share of the wide nodes instead of a heap-allocated Sphere
+ * with its own scene BVH entry. Leaves hold up to kGroupWidth spheres, which are
+ * tested with one SSE (4) or AVX (8) instruction stream.
+ */
+
+#pragma once
+
+#include "primitive.h"
+#include "../acceleration/wide_bvh.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define RAYTRACER_SPHERE_SET_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define RAYTRACER_SPHERE_SET_AVX 1
+#endif
+
+namespace raytracer {
+namespace geometry {
+
+class SphereSet : public Primitive {
+public:
+#ifdef RAYTRACER_SPHERE_SET_AVX
+    static constexpr int kGroupWidth = 8;
+#else
+    static constexpr int kGroupWidth = 4;
+#endif
+
+    /**
+     * @brief Builds the set and its BVH, adopting the arrays
+     *
+     * Negative radii flip the normals, as for hollow glass Spheres.
+     *
+     * @param x, y, z Sphere centers
+     * @param radii One radius per sphere
+     * @param material_indices One index into materials per sphere, or empty for all 0
+     * @param materials Palette of indices into the scene's MaterialTable
+     * @throws std::runtime_error if the arrays are inconsistent or an index
+     *         is out of range
+     */
+    SphereSet(std::vector<float> x, std::vector<float> y, std::vector<float> z, std::vector<float> radii,
+              std::vector<uint32_t> material_indices, std::vector<uint32_t> materials);
+
+    bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
+
+    size_t size() const { return count_; }
+
+    /**
+     * @brief Bytes held by the sphere arrays and the BVH
+     */
+    size_t memory_bytes() const;
+
+private:
+    // Leaf order, padded with kGroupWidth - 1 zero entries so a group load
+    // never reads past the end
+    std::vector<float> x_, y_, z_, radius_;
+    std::vector<uint32_t> material_indices_;
+    std::vector<uint32_t> materials_;
+    size_t count_ = 0;
+    acceleration::WideBVH<4> bvh_;
+    acceleration::AABB bounds_;
+
+    /**
+     * @brief Tests the spheres [first, first + count) of one leaf at once
+     *
+     * @param t Receives the distance of the nearest hit
+     * @return Index of the nearest sphere hit in [t_min, t_max], or -1
+     */
+    int intersect_group(uint32_t first, uint32_t count, const core::Ray& ray, float t_min, float t_max,
+                        float& t) const;
+};
+
+} // namespace geometry
+} // namespace raytracer
@@ -0,0 +1,67 @@
+/**
+ * @file transform.cpp
+ * @brief Implementation of the affine instance transform
+ */
+
+#include "transform.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace raytracer {
+namespace geometry {
+
+acceleration::AABB Transform::apply_box(const acceleration::AABB& box) const {
+    acceleration::AABB result;
+    if (box.is_empty()) {
+        return result;
+    }
+
+    for (int corner = 0; corner < 8; corner++) {
+        Point3 point((corner & 1) ? box.max().x : box.min().x,
+                     (corner & 2) ? box.max().y : box.min().y,
+                     (corner & 4) ? box.max().z : box.min().z);
+        result.expand(apply_point(point));
+    }
+    return result;
+}
+
+Transform Transform::inverse() const {
+    if (std::fabs(glm::determinant(linear)) < 1e-12f) {
+        throw std::runtime_error("Transform: cannot invert a singular transform");
+    }
+
+    Transform result;
+    result.linear = glm::inverse(linear);
+    result.translation = -(result.linear * translation);
+    return result;
+}
+
+Transform Transform::translate(const Vec3& offset) {
+    Transform result;
+    result.translation = offset;
+    return result;
+}
+
+Transform Transform::scale(const Vec3& factors) {
+    Transform result;
+    result.linear = glm::mat3(Vec3(factors.x, 0, 0), Vec3(0, factors.y, 0), Vec3(0, 0, factors.z));
+    return result;
+}
+
+Transform Transform::rotate(float degrees, const Vec3& axis) {
+    // Rodrigues' formula, written out column by column
+    Vec3 k = glm::normalize(axis);
+    float c = std::cos(glm::radians(degrees));
+    float s = std::sin(glm::radians(degrees));
+    float one_minus_c = 1.0f - c;
+
+    Transform result;
+    result.linear = glm::mat3(
+        Vec3(c + k.x * k.x * one_minus_c, k.y * k.x * one_minus_c + k.z * s, k.z * k.x * one_minus_c - k.y * s),
+        Vec3(k.x * k.y * one_minus_c - k.z * s, c + k.y * k.y * one_minus_c, k.z * k.y * one_minus_c + k.x * s),
+        Vec3(k.x * k.z * one_minus_c + k.y * s, k.y * k.z * one_minus_c - k.x * s, c + k.z * k.z * one_minus_c));
+    return result;
+}
+
+} // namespace geometry
+} // namespace raytracer
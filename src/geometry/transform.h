@@ -0,0 +1,62 @@
+/**
+ * @file transform.h
+ * @brief Affine transform used to place instanced geometry
+ */
+
+#pragma once
+
+#include "../common.h"
+#include "../acceleration/aabb.h"
+
+namespace raytracer {
+namespace geometry {
+
+/**
+ * @brief Affine transform stored as a 3x3 linear part plus a translation
+ * 
+ * This is 48 bytes instead of the 64 of a full 4x4 matrix, which matters
+ * when every instance in a large scene carries two of them.
+ */
+struct Transform {
+    glm::mat3 linear = glm::mat3(1.0f);
+    Vec3 translation = Vec3(0.0f);
+
+    Point3 apply_point(const Point3& point) const { return linear * point + translation; }
+    Vec3 apply_vector(const Vec3& vector) const { return linear * vector; }
+
+    /**
+     * @brief Transforms a box by transforming its eight corners
+     */
+    acceleration::AABB apply_box(const acceleration::AABB& box) const;
+
+    /**
+     * @brief Inverse transform
+     * 
+     * @throws std::runtime_error if the linear part is singular
+     */
+    Transform inverse() const;
+
+    /**
+     * @brief Composition; (a * b) applies b first, then a
+     */
+    Transform operator*(const Transform& other) const {
+        Transform result;
+        result.linear = linear * other.linear;
+        result.translation = linear * other.translation + translation;
+        return result;
+    }
+
+    static Transform translate(const Vec3& offset);
+    static Transform scale(const Vec3& factors);
+
+    /**
+     * @brief Rotation about an axis through the origin
+     * 
+     * @param degrees Rotation angle, counter-clockwise looking down the axis
+     * @param axis Rotation axis (need not be normalized)
+     */
+    static Transform rotate(float degrees, const Vec3& axis);
+};
+
+} // namespace geometry
+} // namespace raytracer
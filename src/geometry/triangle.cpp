@@ -5,56 +5,129 @@
 namespace raytracer {
 namespace geometry {
 
+Triangle::Triangle(const Point3& v0, const Point3& v1, const Point3& v2,
+                   uint32_t material)
+    : record_(v0, v1, v2), material_(material) {
+    normal_ = glm::normalize(glm::cross(record_.edge1, record_.edge2));
+    tangent_ = glm::normalize(record_.edge1);
+}
+
 bool Triangle::hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const {
-    // Möller-Trumbore algorithm
-    Vec3 edge1 = v1_ - v0_;
-    Vec3 edge2 = v2_ - v0_;
-    Vec3 h = glm::cross(ray.direction(), edge2);
-    float a = glm::dot(edge1, h);
-    
-    // Ray is parallel to triangle
-    if (a > -1e-8f && a < 1e-8f) {
-        return false;
-    }
-    
-    float f = 1.0f / a;
-    Vec3 s = ray.origin() - v0_;
-    float u = f * glm::dot(s, h);
-    
-    if (u < 0.0f || u > 1.0f) {
-        return false;
-    }
-    
-    Vec3 q = glm::cross(s, edge1);
-    float v = f * glm::dot(ray.direction(), q);
-    
-    if (v < 0.0f || u + v > 1.0f) {
-        return false;
-    }
-    
-    float t = f * glm::dot(edge2, q);
-    
-    if (t < t_min || t > t_max) {
+    return deferred_hit(ray, t_min, t_max, rec);
+}
+
+bool Triangle::find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const {
+    float t, u, v;
+    if (!intersect_triangle(record_, ray, t_min, t_max, t, u, v)) {
         return false;
     }
-    
-    rec.t = t;
+    hit.set(t, u, v, 0, this);
+    return true;
+}
+
+bool Triangle::complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const {
+    rec.t = hit.t;
     rec.point = ray.at(rec.t);
-    
-    // Compute normal using cross product
-    Vec3 outward_normal = glm::normalize(glm::cross(edge1, edge2));
-    rec.set_face_normal(ray, outward_normal);
-    rec.material = material_;
+    rec.set_face_normal(ray, normal_);
+    rec.material_index = material_;
     
     // Compute UV coordinates using barycentric coordinates
-    compute_uv(u, v, rec.u, rec.v);
+    compute_uv(hit.u, hit.v, rec.u, rec.v);
     
-    // Compute tangent space vectors for normal mapping
-    compute_tangent_space(outward_normal, rec);
+    // The edge direction lies in the plane, so the frame is orthonormal as is
+    rec.set_tangent_space(tangent_, glm::cross(normal_, tangent_));
+    return true;
+}
+
+bool Triangle::occluded(const core::Ray& ray, float t_min, float t_max) const {
+    float t, u, v;
+    return intersect_triangle(record_, ray, t_min, t_max, t, u, v);
+}
+
+bool Triangle::bounding_box(acceleration::AABB& output_box) const {
+    output_box = acceleration::AABB(record_.v0, record_.v0);
+    output_box.expand(record_.v0 + record_.edge1);
+    output_box.expand(record_.v0 + record_.edge2);
     
+    // Axis-aligned triangles produce flat boxes that the slab test would reject
+    output_box.pad_to_minimum();
     return true;
 }
 
+acceleration::AABB Triangle::clipped_bounding_box(const acceleration::AABB& clip_box) const {
+    // Sutherland-Hodgman against the six box planes; every plane adds at
+    // most one vertex, so the polygon never exceeds nine
+    const Point3 v0 = record_.v0;
+    const Point3 v1 = record_.v0 + record_.edge1;
+    const Point3 v2 = record_.v0 + record_.edge2;
+    Point3 polygon[9] = {v0, v1, v2};
+    Point3 clipped[9];
+    int count = 3;
+
+    for (int axis = 0; axis < 3 && count > 0; axis++) {
+        for (int side = 0; side < 2 && count > 0; side++) {
+            float plane = side == 0 ? clip_box.min()[axis] : clip_box.max()[axis];
+            auto inside = [&](const Point3& p) { return side == 0 ? p[axis] >= plane : p[axis] <= plane; };
+
+            // Most planes leave the polygon untouched or reject it outright
+            int inside_count = 0;
+            for (int i = 0; i < count; i++) {
+                inside_count += inside(polygon[i]) ? 1 : 0;
+            }
+            if (inside_count == count) {
+                continue;
+            }
+            if (inside_count == 0) {
+                return acceleration::AABB();
+            }
+
+            int clipped_count = 0;
+            for (int i = 0; i < count; i++) {
+                const Point3& current = polygon[i];
+                const Point3& next = polygon[(i + 1) % count];
+                bool current_inside = inside(current);
+                if (current_inside) {
+                    clipped[clipped_count++] = current;
+                }
+                if (current_inside != inside(next)) {
+                    float t = (plane - current[axis]) / (next[axis] - current[axis]);
+                    Point3 crossing = current + t * (next - current);
+                    crossing[axis] = plane;
+                    clipped[clipped_count++] = crossing;
+                }
+            }
+
+            count = clipped_count;
+            for (int i = 0; i < count; i++) {
+                polygon[i] = clipped[i];
+            }
+        }
+    }
+
+    acceleration::AABB box;
+    for (int i = 0; i < count; i++) {
+        box.expand(polygon[i]);
+    }
+    if (box.is_empty()) {
+        return box;
+    }
+
+    // Interpolated vertices can land a rounding error inside the true
+    // polygon, so grow the box slightly and then trim it to the clip box
+    Vec3 full_extent = glm::max(glm::max(v0, v1), v2) - glm::min(glm::min(v0, v1), v2);
+    float margin = 1e-5f * glm::length(full_extent);
+    box = acceleration::AABB(box.min() - Vec3(margin), box.max() + Vec3(margin));
+    box.pad_to_minimum();
+    return box.intersection(clip_box);
+}
+
+uint64_t Triangle::geometry_hash() const {
+    // Clipping reads the vertices, so the bounding box alone is not enough
+    uint64_t hash = core::hash_combine(core::kHashSeed, record_.v0);
+    hash = core::hash_combine(hash, record_.edge1);
+    return core::hash_combine(hash, record_.edge2);
+}
+
 void Triangle::compute_uv(float u, float v, float& out_u, float& out_v) const {
     // For now, use barycentric coordinates directly as UV coordinates
     // In a more advanced implementation, you would store UV coordinates per vertex
@@ -63,19 +136,5 @@ void Triangle::compute_uv(float u, float v, float& out_u, float& out_v) const {
     out_v = v;
 }
 
-void Triangle::compute_tangent_space(const Vec3& normal, HitRecord& rec) const {
-    // For triangles, we can compute tangent from the edge vectors
-    Vec3 edge1 = v1_ - v0_;
-    Vec3 edge2 = v2_ - v0_;
-    
-    // Use edge1 as tangent direction
-    Vec3 tangent = glm::normalize(edge1);
-    
-    // Compute bitangent using cross product
-    Vec3 bitangent = glm::normalize(glm::cross(normal, tangent));
-    
-    rec.set_tangent_space(tangent, bitangent);
-}
-
 } // namespace geometry
 } // namespace raytracer
@@ -1,24 +1,34 @@
 #pragma once
 
 #include "primitive.h"
-#include "../materials/material.h"
+#include "triangle_intersection.h"
 #include <memory>
 
 namespace raytracer {
 namespace geometry {
 
-class Triangle : public Primitive {
+class Triangle final : public Primitive {
 public:
     Triangle() = default;
     Triangle(const Point3& v0, const Point3& v1, const Point3& v2, 
-             std::shared_ptr<materials::Material> material)
-        : v0_(v0), v1_(v1), v2_(v2), material_(material) {}
+             uint32_t material);
 
     bool hit(const core::Ray& ray, float t_min, float t_max, HitRecord& rec) const override;
+    bool find_hit(const core::Ray& ray, float t_min, float t_max, SurfaceHit& hit) const override;
+    bool complete_hit(const core::Ray& ray, const SurfaceHit& hit, HitRecord& rec) const override;
+    bool occluded(const core::Ray& ray, float t_min, float t_max) const override;
+    bool bounding_box(acceleration::AABB& output_box) const override;
+    acceleration::AABB clipped_bounding_box(const acceleration::AABB& clip_box) const override;
+    uint64_t geometry_hash() const override;
+
+    const TriangleRecord& record() const { return record_; }
 
 private:
-    Point3 v0_, v1_, v2_;
-    std::shared_ptr<materials::Material> material_;
+    // Edges, normal and tangent are computed once here instead of per ray
+    TriangleRecord record_;
+    Vec3 normal_;
+    Vec3 tangent_;
+    uint32_t material_ = 0;
     
     /**
      * @brief Computes UV coordinates using barycentric coordinates
@@ -29,14 +39,6 @@ private:
      * @param out_v Output V coordinate [0, 1]
      */
     void compute_uv(float u, float v, float& out_u, float& out_v) const;
-    
-    /**
-     * @brief Computes tangent space vectors for normal mapping
-     * 
-     * @param normal Surface normal at hit point
-     * @param rec Hit record to store tangent and bitangent
-     */
-    void compute_tangent_space(const Vec3& normal, HitRecord& rec) const;
 };
 
 } // namespace geometry
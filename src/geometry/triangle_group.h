@@ -0,0 +1,216 @@
+/**
+ * @file triangle_group.h
+ * @brief Möller-Trumbore on N triangles at once, stored as SoA groups
+ *
+ * A group holds the first vertex and both edges of up to N triangles,
+ * one float array per coordinate, so one SSE (N = 4) or AVX (N = 8)
+ * instruction advances the test for every triangle of a BVH leaf.
+ * Unused lanes have zero edges and never report a hit. Results match the
+ * scalar intersect_triangle lane for lane.
+ */
+
+#pragma once
+
+#include "../common.h"
+#include "../core/ray.h"
+#include "triangle_intersection.h"
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define RAYTRACER_TRIANGLE_GROUP_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define RAYTRACER_TRIANGLE_GROUP_AVX 1
+#endif
+
+namespace raytracer {
+namespace geometry {
+
+template <int N>
+struct alignas(N * sizeof(float)) TriangleGroup {
+    float v0[3][N];          // [axis][lane]
+    float edge1[3][N];
+    float edge2[3][N];
+
+    TriangleGroup() {
+        for (int a = 0; a < 3; a++) {
+            for (int i = 0; i < N; i++) {
+                v0[a][i] = edge1[a][i] = edge2[a][i] = 0.0f;
+            }
+        }
+    }
+
+    void set(int lane, const TriangleRecord& triangle) {
+        for (int a = 0; a < 3; a++) {
+            v0[a][lane] = triangle.v0[a];
+            edge1[a][lane] = triangle.edge1[a];
+            edge2[a][lane] = triangle.edge2[a];
+        }
+    }
+};
+
+static_assert(sizeof(TriangleGroup<4>) == 144, "4-wide group must stay 36 bytes per triangle");
+static_assert(sizeof(TriangleGroup<8>) == 288, "8-wide group must stay 36 bytes per triangle");
+
+/**
+ * @brief Tests every lane and returns the nearest hit
+ *
+ * @return Lane of the nearest hit in [t_min, t_max], or -1; t, u and v
+ *         are only written on a hit
+ */
+template <int N>
+int intersect_triangle_group(const TriangleGroup<N>& group, const core::Ray& ray, float t_min, float t_max, float& t,
+                             float& u, float& v);
+
+/**
+ * @brief Reports whether any lane is hit in [t_min, t_max]
+ */
+template <int N>
+bool occluded_triangle_group(const TriangleGroup<N>& group, const core::Ray& ray, float t_min, float t_max);
+
+namespace detail {
+    // Portable path shared by widths without a vector kernel
+    template <int N>
+    int intersect_lanes(const TriangleGroup<N>& group, const core::Ray& ray, float t_min, float t_max, float* t,
+                        float* u, float* v) {
+        int mask = 0;
+        for (int i = 0; i < N; i++) {
+            TriangleRecord triangle;
+            triangle.v0 = Point3(group.v0[0][i], group.v0[1][i], group.v0[2][i]);
+            triangle.edge1 = Vec3(group.edge1[0][i], group.edge1[1][i], group.edge1[2][i]);
+            triangle.edge2 = Vec3(group.edge2[0][i], group.edge2[1][i], group.edge2[2][i]);
+            mask |= intersect_triangle(triangle, ray, t_min, t_max, t[i], u[i], v[i]) ? (1 << i) : 0;
+        }
+        return mask;
+    }
+
+#ifdef RAYTRACER_TRIANGLE_GROUP_SSE
+    inline int intersect_lanes(const TriangleGroup<4>& group, const core::Ray& ray, float t_min, float t_max,
+                               float* t, float* u, float* v) {
+        const Point3& o = ray.origin();
+        const Vec3& d = ray.direction();
+        const __m128 dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+        const __m128 e1x = _mm_load_ps(group.edge1[0]), e1y = _mm_load_ps(group.edge1[1]),
+                     e1z = _mm_load_ps(group.edge1[2]);
+        const __m128 e2x = _mm_load_ps(group.edge2[0]), e2y = _mm_load_ps(group.edge2[1]),
+                     e2z = _mm_load_ps(group.edge2[2]);
+
+        // h = d x edge2, a = edge1 . h
+        const __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        const __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        const __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+        const __m128 abs_a = _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+        __m128 valid = _mm_cmpge_ps(abs_a, _mm_set1_ps(1e-8f));
+        const __m128 f = _mm_div_ps(_mm_set1_ps(1.0f), a);
+
+        const __m128 sx = _mm_sub_ps(_mm_set1_ps(o.x), _mm_load_ps(group.v0[0]));
+        const __m128 sy = _mm_sub_ps(_mm_set1_ps(o.y), _mm_load_ps(group.v0[1]));
+        const __m128 sz = _mm_sub_ps(_mm_set1_ps(o.z), _mm_load_ps(group.v0[2]));
+        const __m128 lane_u =
+            _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(lane_u, _mm_setzero_ps()));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(lane_u, _mm_set1_ps(1.0f)));
+
+        // q = s x edge1
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        const __m128 lane_v =
+            _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(lane_v, _mm_setzero_ps()));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(lane_u, lane_v), _mm_set1_ps(1.0f)));
+
+        const __m128 lane_t =
+            _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(lane_t, _mm_set1_ps(t_min)));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(lane_t, _mm_set1_ps(t_max)));
+
+        _mm_storeu_ps(t, lane_t);
+        _mm_storeu_ps(u, lane_u);
+        _mm_storeu_ps(v, lane_v);
+        return _mm_movemask_ps(valid);
+    }
+#endif
+
+#ifdef RAYTRACER_TRIANGLE_GROUP_AVX
+    inline int intersect_lanes(const TriangleGroup<8>& group, const core::Ray& ray, float t_min, float t_max,
+                               float* t, float* u, float* v) {
+        const Point3& o = ray.origin();
+        const Vec3& d = ray.direction();
+        const __m256 dx = _mm256_set1_ps(d.x), dy = _mm256_set1_ps(d.y), dz = _mm256_set1_ps(d.z);
+        const __m256 e1x = _mm256_load_ps(group.edge1[0]), e1y = _mm256_load_ps(group.edge1[1]),
+                     e1z = _mm256_load_ps(group.edge1[2]);
+        const __m256 e2x = _mm256_load_ps(group.edge2[0]), e2y = _mm256_load_ps(group.edge2[1]),
+                     e2z = _mm256_load_ps(group.edge2[2]);
+
+        const __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        const __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        const __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        const __m256 a =
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+        const __m256 abs_a = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+        __m256 valid = _mm256_cmp_ps(abs_a, _mm256_set1_ps(1e-8f), _CMP_GE_OQ);
+        const __m256 f = _mm256_div_ps(_mm256_set1_ps(1.0f), a);
+
+        const __m256 sx = _mm256_sub_ps(_mm256_set1_ps(o.x), _mm256_load_ps(group.v0[0]));
+        const __m256 sy = _mm256_sub_ps(_mm256_set1_ps(o.y), _mm256_load_ps(group.v0[1]));
+        const __m256 sz = _mm256_sub_ps(_mm256_set1_ps(o.z), _mm256_load_ps(group.v0[2]));
+        const __m256 lane_u = _mm256_mul_ps(
+            f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(lane_u, _mm256_setzero_ps(), _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(lane_u, _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+
+        const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        const __m256 lane_v = _mm256_mul_ps(
+            f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(lane_v, _mm256_setzero_ps(), _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid,
+                              _mm256_cmp_ps(_mm256_add_ps(lane_u, lane_v), _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+
+        const __m256 lane_t = _mm256_mul_ps(
+            f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(lane_t, _mm256_set1_ps(t_min), _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(lane_t, _mm256_set1_ps(t_max), _CMP_LE_OQ));
+
+        _mm256_storeu_ps(t, lane_t);
+        _mm256_storeu_ps(u, lane_u);
+        _mm256_storeu_ps(v, lane_v);
+        return _mm256_movemask_ps(valid);
+    }
+#endif
+}
+
+template <int N>
+inline int intersect_triangle_group(const TriangleGroup<N>& group, const core::Ray& ray, float t_min, float t_max,
+                                    float& t, float& u, float& v) {
+    alignas(32) float lane_t[N], lane_u[N], lane_v[N];
+    int mask = detail::intersect_lanes(group, ray, t_min, t_max, lane_t, lane_u, lane_v);
+    int nearest = -1;
+    float nearest_t = std::numeric_limits<float>::infinity();
+    for (int i = 0; i < N; i++) {
+        if ((mask & (1 << i)) && lane_t[i] < nearest_t) {
+            nearest = i;
+            nearest_t = lane_t[i];
+        }
+    }
+    if (nearest >= 0) {
+        t = lane_t[nearest];
+        u = lane_u[nearest];
+        v = lane_v[nearest];
+    }
+    return nearest;
+}
+
+template <int N>
+inline bool occluded_triangle_group(const TriangleGroup<N>& group, const core::Ray& ray, float t_min, float t_max) {
+    alignas(32) float lane_t[N], lane_u[N], lane_v[N];
+    return detail::intersect_lanes(group, ray, t_min, t_max, lane_t, lane_u, lane_v) != 0;
+}
+
+} // namespace geometry
+} // namespace raytracer
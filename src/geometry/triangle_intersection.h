@@ -0,0 +1,154 @@
+/**
+ * @file triangle_intersection.h
+ * @brief Ray/triangle tests shared by Triangle and Mesh
+ *
+ * Two tests, both reporting the barycentric coordinates u and v of the
+ * second and third vertex:
+ *
+ * - Möller-Trumbore on a precomputed record of the first vertex and the
+ *   two edges, so no per-ray work goes into rebuilding the edges.
+ * - The watertight test of Woop, Benthin and Wald (JCGT 2013), which
+ *   shears the triangle into a ray-aligned space and evaluates the edge
+ *   functions there. Given bit-identical shared vertices it never lets a
+ *   ray slip between adjacent triangles, which Möller-Trumbore can at
+ *   shared edges and vertices.
+ */
+
+#pragma once
+
+#include "../common.h"
+#include "../core/ray.h"
+#include <glm/glm.hpp>
+#include <cmath>
+#include <utility>
+
+namespace raytracer {
+namespace geometry {
+
+/**
+ * @brief First vertex and edges of a triangle, laid out for Möller-Trumbore
+ */
+struct TriangleRecord {
+    Point3 v0;
+    Vec3 edge1;     // v1 - v0
+    Vec3 edge2;     // v2 - v0
+
+    TriangleRecord() = default;
+    TriangleRecord(const Point3& p0, const Point3& p1, const Point3& p2) : v0(p0), edge1(p1 - p0), edge2(p2 - p0) {}
+};
+
+/**
+ * @brief Möller-Trumbore on a precomputed record
+ *
+ * Accepts both windings; rays nearly parallel to the plane miss.
+ *
+ * @return False if the ray misses or the hit lies outside [t_min, t_max]
+ */
+inline bool intersect_triangle(const TriangleRecord& triangle, const core::Ray& ray, float t_min, float t_max,
+                               float& t, float& u, float& v) {
+    Vec3 h = glm::cross(ray.direction(), triangle.edge2);
+    float a = glm::dot(triangle.edge1, h);
+
+    // Ray is parallel to the triangle
+    if (a > -1e-8f && a < 1e-8f) {
+        return false;
+    }
+
+    float f = 1.0f / a;
+    Vec3 s = ray.origin() - triangle.v0;
+    u = f * glm::dot(s, h);
+
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+
+    Vec3 q = glm::cross(s, triangle.edge1);
+    v = f * glm::dot(ray.direction(), q);
+
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+
+    t = f * glm::dot(triangle.edge2, q);
+    return t >= t_min && t <= t_max;
+}
+
+/**
+ * @brief Per-ray setup of the watertight test, computed once per traversal
+ */
+struct WatertightRay {
+    Point3 origin;
+    int kx, ky, kz;         // Axis permutation making kz the dominant direction axis
+    float shear_x, shear_y, shear_z;
+
+    explicit WatertightRay(const core::Ray& ray) : origin(ray.origin()) {
+        const Vec3& d = ray.direction();
+        kz = 0;
+        if (std::abs(d.y) > std::abs(d[kz])) kz = 1;
+        if (std::abs(d.z) > std::abs(d[kz])) kz = 2;
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        // Keep the winding of the sheared triangle independent of the direction sign
+        if (d[kz] < 0.0f) {
+            std::swap(kx, ky);
+        }
+        shear_x = d[kx] / d[kz];
+        shear_y = d[ky] / d[kz];
+        shear_z = 1.0f / d[kz];
+    }
+};
+
+/**
+ * @brief Watertight ray/triangle test
+ *
+ * Accepts both windings. Edge functions that round to exactly zero are
+ * re-evaluated in double precision, so hits on a shared edge are decided
+ * consistently for both triangles.
+ *
+ * @return False if the ray misses or the hit lies outside [t_min, t_max]
+ */
+inline bool intersect_triangle_watertight(const WatertightRay& ray, const Point3& p0, const Point3& p1,
+                                          const Point3& p2, float t_min, float t_max, float& t, float& u, float& v) {
+    const Vec3 a = p0 - ray.origin;
+    const Vec3 b = p1 - ray.origin;
+    const Vec3 c = p2 - ray.origin;
+
+    const float ax = a[ray.kx] - ray.shear_x * a[ray.kz];
+    const float ay = a[ray.ky] - ray.shear_y * a[ray.kz];
+    const float bx = b[ray.kx] - ray.shear_x * b[ray.kz];
+    const float by = b[ray.ky] - ray.shear_y * b[ray.kz];
+    const float cx = c[ray.kx] - ray.shear_x * c[ray.kz];
+    const float cy = c[ray.ky] - ray.shear_y * c[ray.kz];
+
+    // Scaled barycentrics of the first, second and third vertex
+    float e0 = cx * by - cy * bx;
+    float e1 = ax * cy - ay * cx;
+    float e2 = bx * ay - by * ax;
+    if (e0 == 0.0f || e1 == 0.0f || e2 == 0.0f) {
+        e0 = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+        e1 = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+        e2 = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+    }
+
+    if ((e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) && (e0 > 0.0f || e1 > 0.0f || e2 > 0.0f)) {
+        return false;
+    }
+    const float determinant = e0 + e1 + e2;
+    if (determinant == 0.0f) {
+        return false;
+    }
+
+    const float scaled_t = e0 * ray.shear_z * a[ray.kz] + e1 * ray.shear_z * b[ray.kz] +
+                           e2 * ray.shear_z * c[ray.kz];
+    const float inverse_determinant = 1.0f / determinant;
+    t = scaled_t * inverse_determinant;
+    if (!(t >= t_min && t <= t_max)) {
+        return false;
+    }
+    u = e1 * inverse_determinant;
+    v = e2 * inverse_determinant;
+    return true;
+}
+
+} // namespace geometry
+} // namespace raytracer
@@ -1,12 +1,17 @@
 #include <iostream>
 #include <memory>
 #include <chrono>
+#include <fstream>
+#include <random>
 #include <string>
+#include <vector>
 #include <GLFW/glfw3.h>
 
 #include "common.h"
 #include "core/scene_gallery.h"
 #include "core/scene_loader.h"
+#include "core/mesh_file.h"
+#include "acceleration/bvh_stats.h"
 #include "rendering/progressive_renderer.h"
 #include "viewer/window.h"
 #include "viewer/controller.h"
@@ -16,7 +21,14 @@ using namespace raytracer;
 
 void print_usage() {
     std::cout << "=== RayTracer Phase 2 - Interactive Viewer ===" << std::endl;
-    std::cout << "Usage: ./raytracer [scene_index]" << std::endl;
+    std::cout << "Usage: ./raytracer [scene_index] [--max-depth <rays>] [--min-depth <rays>]" << std::endl;
+    std::cout << "                   [--bvh-stats <file.json>] [--stats-rays <count>]" << std::endl;
+    std::cout << "  --max-depth  Longest path traced, in rays (default 50)" << std::endl;
+    std::cout << "  --min-depth  Rays traced before Russian roulette may end a path (default 3)" << std::endl;
+    std::cout << "  --bvh-stats  Write a BVH quality report for the scene and exit" << std::endl;
+    std::cout << "  --stats-rays Random camera rays traced for the report (default 100000)" << std::endl;
+    std::cout << "       ./raytracer --convert-mesh <input.obj|input.ply> <output.rtmesh>" << std::endl;
+    std::cout << "  --convert-mesh Convert a mesh to the native format, face BVH included, and exit" << std::endl;
     std::cout << "Available scenes:" << std::endl;
     
     const auto& scenes = core::SceneGallery::get_scenes();
@@ -35,24 +47,103 @@ void print_usage() {
     std::cout << "  ESC        - Quit" << std::endl;
 }
 
+/**
+ * @brief Writes the BVH quality report of a scene as JSON
+ * 
+ * Traversal statistics come from camera rays through uniformly random
+ * image positions, with a fixed seed so reports of different asset
+ * revisions are comparable.
+ * 
+ * @return Process exit code
+ */
+int write_bvh_report(const core::Scene& scene, const core::Camera& camera, const core::SceneInfo& scene_info,
+                     const std::string& filename, int ray_count) {
+    const acceleration::BVHAccel* bvh = scene.acceleration();
+    if (!bvh) {
+        std::cerr << "Scene has no bounded objects, no BVH to report on" << std::endl;
+        return -1;
+    }
+    
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<core::Ray> rays;
+    rays.reserve(static_cast<size_t>(ray_count));
+    for (int i = 0; i < ray_count; ++i) {
+        float u = distribution(generator);
+        float v = distribution(generator);
+        rays.push_back(camera.get_ray(u, v));
+    }
+    
+    nlohmann::json report = {
+        {"scene", scene_info.name},
+        {"file", scene_info.filename},
+        {"bvh", acceleration::compute_bvh_stats(*bvh)},
+        {"traversal", acceleration::sample_traversal(*bvh, rays)}
+    };
+    
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "Cannot write BVH report: " << filename << std::endl;
+        return -1;
+    }
+    file << report.dump(2) << std::endl;
+    std::cout << "BVH report written to " << filename << std::endl;
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     const int image_width = 800;
     const int image_height = 600;
-    const int max_depth = 50;
     const int target_samples = 100;  // Progressive rendering target
     
     // Parse command line arguments
     int scene_index = 0;
-    if (argc > 1) {
+    int max_depth = 50;
+    int min_depth = rendering::Integrator::kDefaultMinDepth;
+    std::string stats_filename;
+    int stats_rays = 100000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--convert-mesh" && i + 2 < argc) {
+            try {
+                core::convert_mesh(argv[i + 1], argv[i + 2]);
+                return 0;
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Mesh conversion failed: " << e.what() << std::endl;
+                return -1;
+            }
+        }
         try {
-            scene_index = std::stoi(argv[1]);
+            if (arg == "--max-depth" && i + 1 < argc) {
+                max_depth = std::stoi(argv[++i]);
+            } else if (arg == "--min-depth" && i + 1 < argc) {
+                min_depth = std::stoi(argv[++i]);
+            } else if (arg == "--bvh-stats" && i + 1 < argc) {
+                stats_filename = argv[++i];
+            } else if (arg == "--stats-rays" && i + 1 < argc) {
+                stats_rays = std::stoi(argv[++i]);
+            } else {
+                scene_index = std::stoi(arg);
+            }
         } catch (const std::exception& e) {
-            std::cerr << "Invalid scene index: " << argv[1] << std::endl;
+            std::cerr << "Invalid argument: " << argv[i] << std::endl;
             print_usage();
             return -1;
         }
     }
     
+    if (max_depth < 1 || min_depth < 1) {
+        std::cerr << "Path depths must be at least 1" << std::endl;
+        print_usage();
+        return -1;
+    }
+    
+    if (stats_rays < 1) {
+        std::cerr << "Stats ray count must be at least 1" << std::endl;
+        print_usage();
+        return -1;
+    }
+    
     // Validate scene index
     if (scene_index < 0 || scene_index >= static_cast<int>(core::SceneGallery::scene_count())) {
         std::cerr << "Scene index out of range. Available scenes: 0-" 
@@ -65,6 +156,10 @@ int main(int argc, char* argv[]) {
     auto [scene, camera] = core::SceneGallery::load_scene(scene_index);
     const auto& scene_info = core::SceneGallery::get_scenes()[scene_index];
     
+    if (!stats_filename.empty()) {
+        return write_bvh_report(scene, camera, scene_info, stats_filename, stats_rays);
+    }
+    
     // Create window
     std::string window_title = "RayTracer Phase 2 - " + scene_info.name;
     viewer::Window window(image_width, image_height, window_title);
@@ -86,6 +181,7 @@ int main(int argc, char* argv[]) {
     // Create progressive renderer
     rendering::ProgressiveRenderer progressive_renderer(image_width, image_height, max_depth);
     progressive_renderer.set_target_samples(target_samples);
+    progressive_renderer.set_min_depth(min_depth);
     
     // Print startup information
     std::cout << "\n=== RayTracer Phase 2 - Interactive Viewer ===" << std::endl;
@@ -94,6 +190,7 @@ int main(int argc, char* argv[]) {
     std::cout << "Features: " << scene_info.features << std::endl;
     std::cout << "Resolution: " << image_width << "x" << image_height << std::endl;
     std::cout << "Target samples: " << target_samples << std::endl;
+    std::cout << "Path depth: " << min_depth << " rays before Russian roulette, at most " << max_depth << std::endl;
     std::cout << "\nControls:" << std::endl;
     std::cout << "  WASD       - Move camera" << std::endl;
     std::cout << "  Q/E        - Move up/down" << std::endl;
@@ -173,7 +270,9 @@ int main(int argc, char* argv[]) {
             
             std::cout << "FPS: " << static_cast<int>(fps) 
                       << " | Samples: " << progressive_renderer.sample_count() 
-                      << "/" << target_samples << std::endl;
+                      << "/" << target_samples
+                      << " | Average path length: " << progressive_renderer.path_stats().average_length()
+                      << std::endl;
         }
     }
     
@@ -184,6 +283,8 @@ int main(int argc, char* argv[]) {
     std::cout << "\n=== RENDER COMPLETE ===" << std::endl;
     std::cout << "Final render saved: " << final_filename << std::endl;
     std::cout << "Total samples: " << progressive_renderer.sample_count() << std::endl;
+    std::cout << "Average path length: " << progressive_renderer.path_stats().average_length()
+              << " rays per sample" << std::endl;
     
     return 0;
 }
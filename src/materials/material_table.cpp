@@ -0,0 +1,33 @@
+/**
+ * @file material_table.cpp
+ * @brief Implementation of the scene material table
+ */
+
+#include "material_table.h"
+#include <stdexcept>
+
+namespace raytracer {
+namespace materials {
+
+uint32_t MaterialTable::add(std::shared_ptr<Material> material) {
+    if (!material) {
+        throw std::runtime_error("MaterialTable: material must not be null");
+    }
+    auto existing = indices_.find(material.get());
+    if (existing != indices_.end()) {
+        return existing->second;
+    }
+
+    uint32_t index = static_cast<uint32_t>(materials_.size());
+    indices_.emplace(material.get(), index);
+    materials_.push_back(std::move(material));
+    return index;
+}
+
+void MaterialTable::clear() {
+    materials_.clear();
+    indices_.clear();
+}
+
+} // namespace materials
+} // namespace raytracer
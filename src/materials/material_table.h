@@ -0,0 +1,45 @@
+/**
+ * @file material_table.h
+ * @brief Scene-owned list of materials that primitives refer to by index
+ *
+ * Primitives and hit records store a 32-bit index into the table instead
+ * of a shared_ptr, so accepting a hit copies no reference count and the
+ * hit record stays small. The table keeps the materials alive.
+ */
+
+#pragma once
+
+#include "material.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace raytracer {
+namespace materials {
+
+class MaterialTable {
+public:
+    /**
+     * @brief Adds a material, or finds it if it was added before
+     *
+     * @return Index of the material in the table
+     * @throws std::runtime_error if material is null
+     */
+    uint32_t add(std::shared_ptr<Material> material);
+
+    const Material& operator[](uint32_t index) const { return *materials_[index]; }
+    const std::shared_ptr<Material>& get(uint32_t index) const { return materials_[index]; }
+
+    size_t size() const { return materials_.size(); }
+    bool empty() const { return materials_.empty(); }
+    void clear();
+
+private:
+    std::vector<std::shared_ptr<Material>> materials_;
+    std::unordered_map<const Material*, uint32_t> indices_;
+};
+
+} // namespace materials
+} // namespace raytracer
@@ -3,12 +3,34 @@
 #include "../core/utils.h"
 #include "../core/light.h"
 #include <glm/glm.hpp>
+#include <limits>
 
 namespace raytracer {
 namespace rendering {
 
-Color Integrator::trace(const core::Ray& ray, const core::Scene& scene, int depth) const {
-    return ray_color(ray, scene, depth);
+Color Integrator::trace(const core::Ray& ray, const core::Scene& scene, int depth, PathStats* stats) const {
+    if (depth <= 0)
+        return Color(0, 0, 0);
+    
+    geometry::HitRecord rec;
+    bool hit = scene.hit(ray, 0.001f, std::numeric_limits<float>::infinity(), rec);
+    return trace_path(ray, hit, rec, scene, depth, stats);
+}
+
+void Integrator::trace_packet(const core::RayPacket& packet, const core::Scene& scene, int depth,
+                              Color* colors, PathStats* stats) const {
+    if (depth <= 0) {
+        for (int i = 0; i < packet.size; i++) {
+            colors[i] = Color(0, 0, 0);
+        }
+        return;
+    }
+    
+    geometry::HitRecord records[core::RayPacket::kMaxSize];
+    uint32_t hit_mask = scene.hit_packet(packet, 0.001f, std::numeric_limits<float>::infinity(), records);
+    for (int i = 0; i < packet.size; i++) {
+        colors[i] = trace_path(packet.rays[i], (hit_mask >> i) & 1u, records[i], scene, depth, stats);
+    }
 }
 
 Color Integrator::direct_lighting(const geometry::HitRecord& rec, const core::Scene& scene) const {
@@ -20,8 +42,7 @@ Color Integrator::direct_lighting(const geometry::HitRecord& rec, const core::Sc
         
         // Check if light is visible (shadow ray)
         core::Ray shadow_ray(rec.point, sample.direction);
-        geometry::HitRecord shadow_rec;
-        bool in_shadow = scene.hit(shadow_ray, 0.001f, sample.distance - 0.001f, shadow_rec);
+        bool in_shadow = scene.occluded(shadow_ray, 0.001f, sample.distance - 0.001f);
         
         if (!in_shadow) {
             // Lambertian BRDF: albedo / pi * cos(theta)
@@ -33,30 +54,56 @@ Color Integrator::direct_lighting(const geometry::HitRecord& rec, const core::Sc
     return direct;
 }
 
-Color Integrator::ray_color(const core::Ray& ray, const core::Scene& scene, int depth) const {
-    if (depth <= 0)
-        return Color(0, 0, 0);
+Color Integrator::trace_path(core::Ray ray, bool hit, geometry::HitRecord rec, const core::Scene& scene,
+                             int depth, PathStats* stats) const {
+    Color radiance(0, 0, 0);
+    Color throughput(1, 1, 1);
+    int length = 1;
     
-    geometry::HitRecord rec;
-    if (scene.hit(ray, 0.001f, std::numeric_limits<float>::infinity(), rec)) {
+    while (true) {
+        if (!hit) {
+            radiance += throughput * background(ray);
+            break;
+        }
+        
         core::Ray scattered;
         Color attenuation;
-        Color emitted = rec.material->emit();
+        const materials::Material& material = scene.materials()[rec.material_index];
+        radiance += throughput * material.emit();
         
-        // If material doesn't scatter (emissive), return emission only
-        if (!rec.material->scatter(ray, rec, attenuation, scattered))
-            return emitted;
+        // Emissive materials end the path
+        if (!material.scatter(ray, rec, attenuation, scattered))
+            break;
         
         // Direct lighting (Next Event Estimation)
-        Color direct = direct_lighting(rec, scene);
+        throughput *= attenuation;
+        radiance += throughput * direct_lighting(rec, scene);
+        if (length >= depth)
+            break;
         
-        // Indirect lighting (recursive path tracing)
-        Color indirect = attenuation * ray_color(scattered, scene, depth - 1);
+        // Russian roulette: continue with probability equal to the
+        // throughput's largest channel, weighting survivors by its inverse
+        if (length >= min_depth_) {
+            float survival = glm::min(glm::max(throughput.x, glm::max(throughput.y, throughput.z)), 1.0f);
+            if (core::random_float() >= survival)
+                break;
+            throughput /= survival;
+        }
         
-        return emitted + attenuation * direct + indirect;
+        ray = scattered;
+        hit = scene.hit(ray, 0.001f, std::numeric_limits<float>::infinity(), rec);
+        length++;
     }
     
-    // Background (sky) for debugging
+    if (stats) {
+        stats->paths++;
+        stats->segments += static_cast<uint64_t>(length);
+    }
+    return radiance;
+}
+
+Color Integrator::background(const core::Ray& ray) const {
+    // Sky gradient
     Vec3 unit_direction = glm::normalize(ray.direction());
     auto t = 0.5f * (unit_direction.y + 1.0f);
     return (1.0f - t) * Color(1.0, 1.0, 1.0) + t * Color(0.5, 0.7, 1.0);
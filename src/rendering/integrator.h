@@ -2,20 +2,78 @@
 
 #include "../common.h"
 #include "../core/ray.h"
+#include "../core/ray_packet.h"
 #include "../core/scene.h"
+#include <cstdint>
 #include <random>
 
 namespace raytracer {
 namespace rendering {
 
+/**
+ * @brief Path counts gathered while tracing, for reporting path length
+ */
+struct PathStats {
+    uint64_t paths = 0;       // Camera rays traced
+    uint64_t segments = 0;    // Rays traced along those paths, camera rays included
+
+    void clear() { *this = PathStats(); }
+    double average_length() const { return paths ? static_cast<double>(segments) / paths : 0.0; }
+};
+
 class Integrator {
 public:
+    // Rays always traced along a path before Russian roulette may end it
+    static constexpr int kDefaultMinDepth = 3;
+    
     Integrator() = default;
     
-    Color trace(const core::Ray& ray, const core::Scene& scene, int depth) const;
-
+    /**
+     * @brief Traces one path from a camera ray
+     * 
+     * @param depth Maximum number of rays along the path
+     * @param stats If given, receives the path and its length
+     */
+    Color trace(const core::Ray& ray, const core::Scene& scene, int depth, PathStats* stats = nullptr) const;
+    
+    /**
+     * @brief Traces a packet of camera rays
+     * 
+     * The first intersections are found with one packet query; shading
+     * and all secondary rays then proceed ray by ray as in trace().
+     * 
+     * @param packet Primary rays
+     * @param scene Scene to trace against
+     * @param depth Maximum path depth
+     * @param colors Receives one radiance estimate per ray
+     * @param stats If given, receives the paths and their lengths
+     */
+    void trace_packet(const core::RayPacket& packet, const core::Scene& scene, int depth, Color* colors,
+                      PathStats* stats = nullptr) const;
+    
+    /**
+     * @brief Sets how many rays a path has before Russian roulette applies
+     * 
+     * Beyond it, a path continues with probability equal to the largest
+     * channel of its throughput, and survivors are weighted up to stay
+     * unbiased. A minimum depth at or above the maximum turns roulette off;
+     * 1, the smallest, lets roulette end a path after its camera ray.
+     */
+    void set_min_depth(int depth) { min_depth_ = depth; }
+    int min_depth() const { return min_depth_; }
+    
 private:
-    Color ray_color(const core::Ray& ray, const core::Scene& scene, int depth) const;
+    int min_depth_ = kDefaultMinDepth;
+    
+    /**
+     * @brief Radiance along a path whose first hit is already found
+     * 
+     * Bounces iteratively, carrying the product of attenuations so far
+     * as the path's throughput.
+     */
+    Color trace_path(core::Ray ray, bool hit, geometry::HitRecord rec, const core::Scene& scene, int depth,
+                     PathStats* stats) const;
+    Color background(const core::Ray& ray) const;
     Color direct_lighting(const geometry::HitRecord& rec, const core::Scene& scene) const;
 };
 
@@ -6,6 +6,7 @@
 #include "progressive_renderer.h"
 #include "../common.h"
 #include "../core/utils.h"
+#include <algorithm>
 #include <iostream>
 
 namespace raytracer {
@@ -34,22 +35,45 @@ bool ProgressiveRenderer::render_sample(const core::Camera& camera, const core::
 void ProgressiveRenderer::reset() {
     sample_count_ = 0;
     framebuffer_.clear();
+    path_stats_.clear();
 }
 
 void ProgressiveRenderer::render_single_sample(const core::Camera& camera, const core::Scene& scene) {
-    // Render one sample per pixel
-    for (int y = 0; y < framebuffer_.height(); ++y) {
-        for (int x = 0; x < framebuffer_.width(); ++x) {
+    // Render one sample per pixel, tile by tile; pinhole cameras give each
+    // tile's rays a common origin, so they can be traced as one packet
+    const bool use_packets = camera.is_pinhole();
+    const int width = framebuffer_.width();
+    const int height = framebuffer_.height();
+    
+    for (int tile_y = 0; tile_y < height; tile_y += kTileSize) {
+        for (int tile_x = 0; tile_x < width; tile_x += kTileSize) {
+            const int tile_width = std::min(kTileSize, width - tile_x);
+            const int tile_height = std::min(kTileSize, height - tile_y);
+            
             // Generate random UV coordinates for this sample
-            auto u = (x + core::random_float()) / (framebuffer_.width() - 1);
-            auto v = (y + core::random_float()) / (framebuffer_.height() - 1);
+            core::RayPacket packet;
+            for (int y = tile_y; y < tile_y + tile_height; ++y) {
+                for (int x = tile_x; x < tile_x + tile_width; ++x) {
+                    auto u = (x + core::random_float()) / (width - 1);
+                    auto v = (y + core::random_float()) / (height - 1);
+                    packet.add(camera.get_ray(u, v));
+                }
+            }
             
-            // Cast ray and trace
-            core::Ray ray = camera.get_ray(u, v);
-            Color color = integrator_.trace(ray, scene, max_depth_);
+            // Cast rays and trace
+            Color colors[core::RayPacket::kMaxSize];
+            if (use_packets) {
+                integrator_.trace_packet(packet, scene, max_depth_, colors, &path_stats_);
+            } else {
+                for (int i = 0; i < packet.size; ++i) {
+                    colors[i] = integrator_.trace(packet.rays[i], scene, max_depth_, &path_stats_);
+                }
+            }
             
-            // Add sample to accumulation buffer
-            framebuffer_.add_sample(x, y, color);
+            // Add samples to accumulation buffer
+            for (int i = 0; i < packet.size; ++i) {
+                framebuffer_.add_sample(tile_x + i % tile_width, tile_y + i / tile_width, colors[i]);
+            }
         }
     }
 }
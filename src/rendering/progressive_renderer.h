@@ -62,13 +62,33 @@ public:
      * @param samples Target samples per pixel
      */
     void set_target_samples(int samples) { target_samples_ = samples; }
+    
+    /**
+     * @brief Sets how many rays a path has before Russian roulette may end it
+     * 
+     * @param depth Minimum path depth; at or above the maximum depth, paths
+     *              only end at the maximum depth or on a miss
+     */
+    void set_min_depth(int depth) { integrator_.set_min_depth(depth); }
+    
+    /**
+     * @brief Gets the path counts of the samples rendered since the last reset
+     * 
+     * @return Paths traced and their total length
+     */
+    const PathStats& path_stats() const { return path_stats_; }
 
 private:
+    // Pixels are rendered in square tiles whose primary rays form one packet
+    static constexpr int kTileSize = 4;
+    static_assert(kTileSize * kTileSize <= core::RayPacket::kMaxSize, "A tile must fit in one ray packet");
+
     Framebuffer framebuffer_;
     Integrator integrator_;
     int sample_count_;
     int target_samples_;
     int max_depth_;
+    PathStats path_stats_;
     
     /**
      * @brief Renders a single sample for all pixels
@@ -1,6 +1,7 @@
 #include "renderer.h"
 #include "../common.h"
 #include "../core/utils.h"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 
@@ -18,32 +19,62 @@ void Renderer::render(const core::Camera& camera, const core::Scene& scene) {
               << " with " << samples_per_pixel_ << " samples per pixel..." << std::endl;
     
     framebuffer_.clear();
+    path_stats_.clear();
     
-    for (int y = 0; y < framebuffer_.height(); ++y) {
-        for (int x = 0; x < framebuffer_.width(); ++x) {
-            Color pixel_color(0, 0, 0);
+    // Pinhole cameras give each tile's rays a common origin, so they can
+    // be traced as one packet; with depth of field they go one by one
+    const bool use_packets = camera.is_pinhole();
+    const int width = framebuffer_.width();
+    const int height = framebuffer_.height();
+    int reported_progress = -1;
+    
+    for (int tile_y = 0; tile_y < height; tile_y += kTileSize) {
+        for (int tile_x = 0; tile_x < width; tile_x += kTileSize) {
+            const int tile_width = std::min(kTileSize, width - tile_x);
+            const int tile_height = std::min(kTileSize, height - tile_y);
+            Color pixel_colors[core::RayPacket::kMaxSize] = {};
             
             for (int s = 0; s < samples_per_pixel_; ++s) {
-                auto u = (x + core::random_float()) / (framebuffer_.width() - 1);
-                auto v = (y + core::random_float()) / (framebuffer_.height() - 1);
+                core::RayPacket packet;
+                for (int y = tile_y; y < tile_y + tile_height; ++y) {
+                    for (int x = tile_x; x < tile_x + tile_width; ++x) {
+                        auto u = (x + core::random_float()) / (width - 1);
+                        auto v = (y + core::random_float()) / (height - 1);
+                        packet.add(camera.get_ray(u, v));
+                    }
+                }
                 
-                core::Ray ray = camera.get_ray(u, v);
-                pixel_color += integrator_.trace(ray, scene, max_depth_);
+                Color colors[core::RayPacket::kMaxSize];
+                if (use_packets) {
+                    integrator_.trace_packet(packet, scene, max_depth_, colors, &path_stats_);
+                } else {
+                    for (int i = 0; i < packet.size; ++i) {
+                        colors[i] = integrator_.trace(packet.rays[i], scene, max_depth_, &path_stats_);
+                    }
+                }
+                for (int i = 0; i < packet.size; ++i) {
+                    pixel_colors[i] += colors[i];
+                }
             }
             
-            pixel_color /= static_cast<float>(samples_per_pixel_);
-            framebuffer_.set_pixel(x, y, pixel_color);
+            for (int i = 0; i < tile_width * tile_height; ++i) {
+                framebuffer_.set_pixel(tile_x + i % tile_width, tile_y + i / tile_width,
+                                       pixel_colors[i] / static_cast<float>(samples_per_pixel_));
+            }
         }
         
-        // Progress indicator
-        if (y % (framebuffer_.height() / 10) == 0) {
-            std::cout << "Progress: " << (y * 100 / framebuffer_.height()) << "%" << std::endl;
+        // Progress indicator, every 10%
+        int progress = (tile_y * 10) / height;
+        if (progress != reported_progress) {
+            std::cout << "Progress: " << progress * 10 << "%" << std::endl;
+            reported_progress = progress;
         }
     }
     
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time);
     std::cout << "Rendering completed in " << duration.count() << " seconds" << std::endl;
+    std::cout << "Average path length: " << path_stats_.average_length() << " rays per sample" << std::endl;
 }
 
 } // namespace rendering
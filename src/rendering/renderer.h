@@ -17,12 +17,23 @@ public:
     
     void set_samples_per_pixel(int samples) { samples_per_pixel_ = samples; }
     void set_max_depth(int depth) { max_depth_ = depth; }
+    void set_min_depth(int depth) { integrator_.set_min_depth(depth); }
+    
+    /**
+     * @brief Path counts of the last render
+     */
+    const PathStats& path_stats() const { return path_stats_; }
 
 private:
+    // Pixels are rendered in square tiles whose primary rays form one packet
+    static constexpr int kTileSize = 4;
+    static_assert(kTileSize * kTileSize <= core::RayPacket::kMaxSize, "A tile must fit in one ray packet");
+
     Framebuffer framebuffer_;
     Integrator integrator_;
     int samples_per_pixel_;
     int max_depth_;
+    PathStats path_stats_;
 };
 
 } // namespace rendering
@@ -0,0 +1,105 @@
+/**
+ * @file ply_import_test.cpp
+ * @brief Regression checks for binary PLY face decoding
+ *
+ * Face blocks with only an index list take a parallel fast path that
+ * assumes triangles. Quad and mixed files must fall back to the
+ * sequential parser instead of failing on indices read at the wrong
+ * stride.
+ */
+
+#include "core/mesh_importer.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace raytracer;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const std::string& what) {
+        if (!condition) {
+            std::cerr << "FAILED: " << what << std::endl;
+            failures++;
+        }
+    }
+
+    template <typename T>
+    void append(std::string& data, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        data.append(bytes, sizeof(T));
+    }
+
+    /**
+     * @brief Little-endian PLY of a size x size grid of quads, with every
+     *        quad split into two triangles where split(cell) is true
+     */
+    template <typename Split>
+    std::string grid_ply(int size, Split split, size_t& faces) {
+        const int side = size + 1;
+        std::vector<std::vector<int32_t>> polygons;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                int32_t a = y * side + x, b = a + 1, c = a + side + 1, d = a + side;
+                if (split(y * size + x)) {
+                    polygons.push_back({a, b, c});
+                    polygons.push_back({a, c, d});
+                } else {
+                    polygons.push_back({a, b, c, d});
+                }
+            }
+        }
+        faces = polygons.size();
+
+        std::string data = "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(side * side) +
+                           "\nproperty float x\nproperty float y\nproperty float z\nelement face " +
+                           std::to_string(polygons.size()) + "\nproperty list uchar int vertex_indices\nend_header\n";
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++) {
+                append(data, static_cast<float>(x));
+                append(data, static_cast<float>(y));
+                append(data, 0.0f);
+            }
+        }
+        for (const auto& polygon : polygons) {
+            append(data, static_cast<uint8_t>(polygon.size()));
+            for (int32_t index : polygon) {
+                append(data, index);
+            }
+        }
+        return data;
+    }
+
+    void check_grid(const std::string& name, int size, bool (*split)(int)) {
+        size_t faces = 0;
+        std::string data = grid_ply(size, split, faces);
+        try {
+            core::MeshData mesh = core::parse_ply(data.data(), data.size());
+            check(mesh.triangle_count() == static_cast<size_t>(2 * size * size), name + ": triangle count");
+            bool in_range = true;
+            for (uint32_t index : mesh.indices) {
+                in_range = in_range && index < mesh.vertex_count();
+            }
+            check(in_range, name + ": indices in range");
+        } catch (const std::runtime_error& e) {
+            check(false, name + ": " + e.what());
+        }
+    }
+}
+
+int main() {
+    check_grid("triangle grid", 300, [](int) { return true; });
+    check_grid("quad grid", 300, [](int) { return false; });
+    check_grid("mixed grid", 300, [](int cell) { return cell % 3 == 0; });
+
+    if (failures) {
+        return 1;
+    }
+    std::cout << "PLY import checks passed" << std::endl;
+    return 0;
+}